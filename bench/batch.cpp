@@ -0,0 +1,50 @@
+//
+// Batch scaling benchmark
+//    Runs the same set of independent machines with 1, 2, 4... up to
+//    the given number of threads (all hardware threads by default) and
+//    reports aggregate emulated MHz, speedup and parallel efficiency.
+//    Machines run a memory-heavy loop on their own copy-on-write fork
+//    of a common image.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <Batch.hpp>
+
+using namespace Z80CPP;
+
+// 16-bit loads, stack and memory exchange (as in bench/tstates)
+const uint8_t g_code[] = {
+     0x31, 0x00, 0x08, 0x21, 0x22, 0x11, 0x01, 0xCC, 0xBB, 0xE5
+   , 0xC5, 0xE3, 0xD1, 0xC1, 0x22, 0x00, 0x09, 0x2A, 0x00, 0x09
+   , 0x23, 0x1B, 0x18, 0xF1
+};
+
+int main(int argc, char* argv[]) {
+   const unsigned hw       = std::thread::hardware_concurrency();
+   const unsigned maxth    = (argc > 1) ? std::stoul(argv[1]) : (hw ? hw : 1);
+   const uint32_t machines = (argc > 2) ? std::stoul(argv[2]) : 256;
+   const uint64_t ticks    = (argc > 3) ? std::stoull(argv[3]) : 2000000;
+
+   Memory image;
+   image.load(0, g_code, sizeof(g_code));
+
+   std::cout << "Machines: " << machines << " x " << ticks << " ticks. Hardware threads: " << hw << "\n";
+   std::cout << std::setw(8) << "threads" << std::setw(10) << "seconds" << std::setw(10) << "MHz"
+             << std::setw(10) << "speedup" << std::setw(8) << "eff" << std::setw(8) << "steals\n";
+
+   double base = 0;
+   for (unsigned th = 1; th <= maxth; th = (th < maxth && th * 2 > maxth) ? maxth : th * 2) {
+      Batch batch(th);
+      for (uint32_t i = 0; i < machines; ++i) batch.add(image);
+      Batch::Stats s = batch.run(ticks);
+      if ( th == 1 ) base = s.mhz();
+
+      std::cout << std::setw(8) << th << std::fixed << std::setprecision(3)
+                << std::setw(10) << s.seconds << std::setprecision(2)
+                << std::setw(10) << s.mhz() << std::setw(10) << s.mhz() / base
+                << std::setw(8)  << s.mhz() / base / th << std::setw(7) << s.steals << "\n";
+   }
+   return 0;
+}
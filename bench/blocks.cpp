@@ -0,0 +1,92 @@
+//
+// Basic-block translation cache microbenchmark
+//    Runs small looping programs with the Instruction engine, decoding
+//    every instruction (execute) and through the BlockCache, and reports
+//    MHz plus cache statistics, and again compiling hot blocks with the
+//    Jit (when available on this host). The "smc" program patches the operand
+//    of an instruction in its own loop, invalidating it every iteration.
+//    The "alias" one does it through page 3, mapping the same RAM bank.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <BlockCache.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct BenchProgram {
+   const char*          name;
+   std::vector<uint8_t> code;
+   bool                 alias;   // Page 3 maps bank 0 too
+};
+
+const BenchProgram g_programs[] = {
+   // LD r,n / LD r,r / LD (HL),r and back to start (as in bench/tstates)
+   { "load8", { 0x26, 0x0A, 0x2E, 0x10, 0x06, 0x3E, 0x0E, 0x11, 0x16, 0x06
+              , 0x70, 0x69, 0x71, 0x2E, 0x12, 0x72, 0x7A, 0x47, 0xC3, 0x00, 0x00 }, false },
+   // 16-bit loads, stack and memory exchange (as in bench/tstates)
+   { "stack", { 0x31, 0x00, 0x08, 0x21, 0x22, 0x11, 0x01, 0xCC, 0xBB, 0xE5
+              , 0xC5, 0xE3, 0xD1, 0xC1, 0x22, 0x00, 0x09, 0x2A, 0x00, 0x09
+              , 0x23, 0x1B, 0x18, 0xF1 }, false },
+   // LD A,n / INC BC / LD (0001),A: rewrites the operand of LD A,n
+   { "smc",   { 0x3E, 0x00, 0x03, 0x03, 0x03, 0x32, 0x01, 0x00, 0x41, 0x18, 0xF5 }, false },
+   // LD A,5 / LD HL,C001 / INC (HL) / JP 0000: increments the operand of
+   // LD A,n through page 3
+   { "alias", { 0x3E, 0x05, 0x21, 0x01, 0xC0, 0x34, 0xC3, 0x00, 0x00 }, true }
+};
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 200000000;
+
+   std::cout << std::setw(8) << "program" << std::setw(12) << "decode MHz" << std::setw(12) << "blocks MHz"
+             << std::setw(10) << "speedup" << std::setw(10) << "hit rate" << std::setw(12) << "invalidated"
+             << std::setw(10) << "jit MHz" << std::setw(10) << "speedup\n";
+   for (const auto& p : g_programs) {
+      Memory m1, m2, m3;
+      if ( p.alias ) { m1.map(3, 0); m2.map(3, 0); m3.map(3, 0); }
+      m1.load(0, p.code.data(), p.code.size());
+      m2.load(0, p.code.data(), p.code.size());
+      m3.load(0, p.code.data(), p.code.size());
+
+      Z80 a(Engine::Instruction);
+      Timer<uint64_t> td;
+      do { a.execute(m1); } while ( a.ticks() < ticks );
+      uint64_t nsd = td.ns();
+
+      Z80        b(Engine::Instruction);
+      BlockCache cache;
+      Timer<uint64_t> tb;
+      cache.run(b, m2, ticks);
+      uint64_t nsb = tb.ns();
+
+      Z80        c(Engine::Instruction);
+      BlockCache jit;
+      const bool hasJit = jit.setJit(true);
+      Timer<uint64_t> tj;
+      jit.run(c, m3, ticks);
+      uint64_t nsj = tj.ns();
+
+      const Registers ra = a.registers(), rb = b.registers(), rc = c.registers();
+      if ( ra.PC != rb.PC || ra.main.A != rb.main.A || a.ticks() != b.ticks()
+        || ra.PC != rc.PC || ra.main.A != rc.main.A || a.ticks() != c.ticks() )
+         std::cout << "ERROR: engines differ\n";
+
+      const auto& s = cache.stats();
+      std::cout << std::setw(8) << p.name << std::fixed << std::setprecision(2)
+                << std::setw(12) << (double)a.ticks() * 1000 / nsd
+                << std::setw(12) << (double)b.ticks() * 1000 / nsb
+                << std::setw(10) << (double)nsd / nsb
+                << std::setw(9)  << s.hitRate() * 100 << "%"
+                << std::setw(11) << s.invalidated;
+      if ( hasJit )
+         std::cout << std::setw(10) << (double)c.ticks() * 1000 / nsj
+                   << std::setw(10) << (double)nsd / nsj << "\n";
+      else
+         std::cout << std::setw(10) << "-" << std::setw(10) << "-" << "\n";
+   }
+   return 0;
+}
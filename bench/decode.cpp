@@ -0,0 +1,85 @@
+//
+// Decode microbenchmark
+//    Measures the cost per instruction of every prefix class (none, CB,
+//    ED, DD, FD, DDCB) on both engines. Every program loops over eight
+//    register or (IX/IY+d) instructions of its class, whose opcodes are
+//    decoded through the (space, opcode) tables, and a JP back.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct BenchProgram {
+   const char*          name;
+   std::vector<uint8_t> body;    // Looping part, 8 instructions
+};
+
+const BenchProgram g_programs[] = {
+   // LD A,B / ADD A,C / INC D / XOR E / LD H,L / DEC L / OR A / CP H
+   { "none", { 0x78, 0x81, 0x14, 0xAB, 0x65, 0x2D, 0xB7, 0xBC } },
+   // RLC B / SRL C / BIT 3,D / SET 1,E / RES 2,H / RL L / SLA A / RR B
+   { "CB",   { 0xCB, 0x00, 0xCB, 0x39, 0xCB, 0x5A, 0xCB, 0xCB
+             , 0xCB, 0x94, 0xCB, 0x15, 0xCB, 0x27, 0xCB, 0x18 } },
+   // NEG / ADC HL,BC / SBC HL,DE / LD A,I / LD I,A / ADC HL,DE / SBC HL,HL / NEG
+   { "ED",   { 0xED, 0x44, 0xED, 0x4A, 0xED, 0x52, 0xED, 0x57
+             , 0xED, 0x47, 0xED, 0x5A, 0xED, 0x62, 0xED, 0x44 } },
+   // LD B,IXH / ADD A,IXL / LD A,(IX+2) / XOR (IX+0) / INC (IX+3)
+   // LD IXL,A / LD (IX+4),B / CP (IX+1)
+   { "DD",   { 0xDD, 0x44, 0xDD, 0x85, 0xDD, 0x7E, 0x02, 0xDD, 0xAE, 0x00
+             , 0xDD, 0x34, 0x03, 0xDD, 0x6F, 0xDD, 0x70, 0x04, 0xDD, 0xBE, 0x01 } },
+   // The same with IY
+   { "FD",   { 0xFD, 0x44, 0xFD, 0x85, 0xFD, 0x7E, 0x02, 0xFD, 0xAE, 0x00
+             , 0xFD, 0x34, 0x03, 0xFD, 0x6F, 0xFD, 0x70, 0x04, 0xFD, 0xBE, 0x01 } },
+   // RLC (IX+1) / BIT 0,(IX+2) / SET 0,(IX+3) / RES 1,(IX+4) / RL (IX+5)
+   // RLC (IX+6),B / SRL (IX+7) / BIT 7,(IX+0)
+   { "DDCB", { 0xDD, 0xCB, 0x01, 0x06, 0xDD, 0xCB, 0x02, 0x46, 0xDD, 0xCB, 0x03, 0xC6
+             , 0xDD, 0xCB, 0x04, 0x8E, 0xDD, 0xCB, 0x05, 0x16, 0xDD, 0xCB, 0x06, 0x00
+             , 0xDD, 0xCB, 0x07, 0x3E, 0xDD, 0xCB, 0x00, 0x7E } }
+};
+
+// LD IX,0x8000 / LD IY,0x8100 / body / JP 0x0008
+void
+load(Memory& mem, const BenchProgram& p) {
+   std::vector<uint8_t> code = { 0xDD, 0x21, 0x00, 0x80, 0xFD, 0x21, 0x00, 0x81 };
+   code.insert(code.end(), p.body.begin(), p.body.end());
+   code.insert(code.end(), { 0xC3, 0x08, 0x00 });
+   mem.load(0, code.data(), code.size());
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t insns = (argc > 1) ? std::stoull(argv[1]) : 20000000;
+
+   std::cout << std::setw(8) << "prefix" << std::setw(14) << "instr ns/op"
+             << std::setw(14) << "tstate ns/op" << "\n";
+   for (const auto& p : g_programs) {
+      Memory m1, m2;
+      load(m1, p);
+      load(m2, p);
+
+      Z80 a(Engine::Instruction);
+      Timer<uint64_t> ti;
+      for (uint64_t i=0; i < insns; ++i) a.execute(m1);
+      uint64_t nsi = ti.ns();
+
+      MemoryBus<NoContention> bus(m2);
+      Z80 b;
+      Timer<uint64_t> tt;
+      b.runInstructions(bus, insns);
+      uint64_t nst = tt.ns();
+
+      if ( a.ticks() != b.ticks() || a.registers().PC != b.registers().PC )
+         std::cout << "ERROR: engines differ\n";
+
+      std::cout << std::setw(8) << p.name << std::fixed << std::setprecision(2)
+                << std::setw(14) << (double)nsi / insns
+                << std::setw(14) << (double)nst / insns << "\n";
+   }
+   return 0;
+}
@@ -0,0 +1,84 @@
+//
+// Event scheduler microbenchmark
+//    Measures ticks per second of the T-state engine running a tight
+//    INC A / JR loop with a device that needs to act every period ticks. 
+//    The device is either polled on every tick (poll) or called by 
+//    the Scheduler only when due (event). Both call the device through
+//    the same Scheduler::Callback interface. The loop is not a plain
+//    JR $, which run() would fast-forward (see bench/idle).
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <Scheduler.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+// Device acting every period ticks
+struct Device {
+   uint64_t period;
+   uint64_t calls = 0;
+   void act() { ++calls; }
+};
+
+uint64_t
+runPolled(uint64_t ticks, uint64_t period) {
+   Memory      mem;
+   MemoryBus<> bus(mem);
+   Z80         cpu;
+   Device      dev { period };
+   mem.write(0, 0x3C); mem.write(1, 0x18); mem.write(2, 0xFD);   // INC A / JR $-1
+
+   Scheduler::Callback poll = [d = &dev](uint64_t tick) {
+      if ( tick % d->period == 0 ) d->act();
+   };
+   for (uint64_t t=0; t < ticks; ++t) {
+      cpu.tick(bus);
+      poll(cpu.ticks());
+   }
+   return dev.calls;
+}
+
+uint64_t
+runEvents(uint64_t ticks, uint64_t period) {
+   Memory      mem;
+   MemoryBus<> bus(mem);
+   Z80         cpu;
+   Scheduler   sched;
+   Device      dev { period };
+   mem.write(0, 0x3C); mem.write(1, 0x18); mem.write(2, 0xFD);   // INC A / JR $-1
+
+   struct Event {
+      Device* d; Scheduler* s;
+      void operator()(uint64_t tick) const {
+         d->act();
+         s->schedule(tick + d->period, *this);
+      }
+   };
+   sched.schedule(period, Event{ &dev, &sched });
+   sched.run(cpu, bus, ticks);
+   return dev.calls;
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 50000000;
+
+   std::cout << std::setw(8) << "period" << std::setw(8) << "device" << std::setw(10) << "calls"
+             << std::setw(14) << "ticks/s" << std::setw(10) << "MHz" << "\n";
+   for (uint64_t period : { 4, 64, 1024, 20000, 80000 }) {
+      for (bool polled : { true, false }) {
+         Timer<uint64_t> t;
+         uint64_t calls = polled ? runPolled(ticks, period) : runEvents(ticks, period);
+         uint64_t ns = t.ns();
+         std::cout << std::setw(8) << period << std::setw(8) << (polled ? "poll" : "event")
+                   << std::setw(10) << calls
+                   << std::setw(14) << ticks*1000000000/ns 
+                   << std::setw(10) << std::fixed << std::setprecision(2) << (double)ticks*1000/ns << "\n";
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,69 @@
+//
+// Lazy flags microbenchmark
+//    Runs ALU-heavy loops with the Instruction engine twice: leaving flags
+//    lazy (F computed only when PUSH AF, DAA... read it) and computing F
+//    after every instruction, as an eager ALU would. The "mixed" program
+//    reads flags back often, so it gains the least.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct BenchProgram {
+   const char*          name;
+   std::vector<uint8_t> code;
+};
+
+const BenchProgram g_programs[] = {
+   // ADD/ADC/SUB/XOR/AND/OR/CP with registers and immediates, and back
+   { "alu",    { 0x80, 0x89, 0x92, 0xAB, 0xA4, 0xB5, 0xBF, 0xC6, 0x11, 0xCE, 0x22
+               , 0xD6, 0x05, 0xEE, 0x5A, 0xC3, 0x00, 0x00 } },
+   // INC/DEC of registers and (HL), a counter loop
+   { "incdec", { 0x21, 0x00, 0x01, 0x04, 0x0C, 0x15, 0x1D, 0x24, 0x2D, 0x3C, 0x34
+               , 0x35, 0x05, 0xC3, 0x03, 0x00 } },
+   // Arithmetic followed by DAA, rotates and PUSH AF: flags read back
+   { "mixed",  { 0x31, 0x00, 0x02, 0xC6, 0x19, 0x27, 0x17, 0x0F, 0xF5, 0xF1, 0x3F
+               , 0x90, 0x2F, 0xC3, 0x03, 0x00 } }
+};
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 200000000;
+
+   std::cout << std::setw(8) << "program" << std::setw(12) << "eager MHz"
+             << std::setw(12) << "lazy MHz" << std::setw(10) << "speedup\n";
+   for (const auto& p : g_programs) {
+      Memory m1, m2;
+      m1.load(0, p.code.data(), p.code.size());
+      m2.load(0, p.code.data(), p.code.size());
+
+      // registers() brings F up to date after every instruction
+      Z80 a(Engine::Instruction);
+      volatile uint8_t f;
+      Timer<uint64_t> te;
+      do { a.execute(m1); f = a.registers().main.F; } while ( a.ticks() < ticks );
+      uint64_t nse = te.ns();
+      (void)f;
+
+      Z80 b(Engine::Instruction);
+      Timer<uint64_t> tl;
+      do { b.execute(m2); } while ( b.ticks() < ticks );
+      uint64_t nsl = tl.ns();
+
+      const Registers& ra = a.registers();
+      const Registers& rb = b.registers();
+      if ( ra.main.AF != rb.main.AF || ra.PC != rb.PC || a.ticks() != b.ticks() )
+         std::cout << "ERROR: results differ\n";
+
+      std::cout << std::setw(8) << p.name << std::fixed << std::setprecision(2)
+                << std::setw(12) << (double)a.ticks() * 1000 / nse
+                << std::setw(12) << (double)b.ticks() * 1000 / nsl
+                << std::setw(10) << (double)nse / nsl << "\n";
+   }
+   return 0;
+}
@@ -0,0 +1,67 @@
+//
+// Memory forking microbenchmark
+//    Forks N copies of a 128K Memory (8 banks of 16K) and measures the
+//    cost per fork against a deep copy of its RAM. Then every fork 
+//    writes to some of its pages, and copy-on-write counters show how
+//    many banks remain shared and how many had to be copied.
+//
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Memory.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+int main(int argc, char* argv[]) {
+   const uint32_t forks = (argc > 1) ? std::stoul(argv[1]) : 10000;
+   const uint32_t banks = 8;
+
+   Memory base(banks);
+   base.fill(0xAA);
+
+   // Deep copy of all RAM banks (what copying Memory cost before)
+   std::vector<std::vector<uint8_t>> deep;
+   deep.reserve(forks);
+   Timer<uint64_t> td;
+   for (uint32_t i = 0; i < forks; ++i) {
+      deep.emplace_back(banks * Memory::PAGE_SIZE);
+      for (uint32_t b = 0; b < banks; ++b)
+         std::memcpy(deep.back().data() + b * Memory::PAGE_SIZE, 
+                     static_cast<const Memory&>(base).bank(b), Memory::PAGE_SIZE);
+   }
+   uint64_t nsdeep = td.ns();
+   deep.clear();
+
+   // Copy-on-write forks
+   std::vector<Memory> mems;
+   mems.reserve(forks);
+   Timer<uint64_t> tf;
+   for (uint32_t i = 0; i < forks; ++i)
+      mems.push_back(base);
+   uint64_t nsfork = tf.ns();
+
+   std::cout << "Forks: " << forks << " of " << banks * Memory::PAGE_SIZE / 1024 << "K\n";
+   std::cout << std::setw(12) << "deep copy" << std::setw(10) << (double)nsdeep / forks << " ns/fork\n";
+   std::cout << std::setw(12) << "cow fork"  << std::setw(10) << (double)nsfork / forks << " ns/fork\n\n";
+
+   // Every fork writes to the first 'pages' pages of its address space
+   std::cout << std::setw(8) << "written" << std::setw(12) << "shared" << std::setw(12) << "copied"
+             << std::setw(12) << "KB used" << std::setw(12) << "ns/write\n";
+   for (uint16_t pages = 0; pages <= Memory::PAGES; ++pages) {
+      Timer<uint64_t> tw;
+      for (auto& m : mems)
+         for (uint16_t p = 0; p < pages; ++p) 
+            m.write(p * Memory::PAGE_SIZE + 3, 0x55);
+      uint64_t nswrite = tw.ns();
+
+      uint64_t shared = 0, copied = 0;
+      for (const auto& m : mems) { shared += m.sharedBanks(); copied += m.copiedBanks(); }
+      std::cout << std::setw(8) << pages << std::setw(12) << shared << std::setw(12) << copied
+                << std::setw(12) << (banks + copied) * Memory::PAGE_SIZE / 1024
+                << std::setw(12) << (pages ? (double)nswrite / (forks * pages) : 0.0) << "\n";
+   }
+   return 0;
+}
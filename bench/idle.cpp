@@ -0,0 +1,122 @@
+//
+// Idle loop fast-forward microbenchmark
+//    Runs programs that end up idle (HALT, JR $, JP $) with a 300 Hz
+//    device event, as a CPC interrupt would be, on both engines. Every
+//    T-state is either ticked (tstate: tick(), instr: execute() one by
+//    one) or run in batches, which skip the iterations of idle loops
+//    (run() through the Scheduler, execute(mem, ticks)). The ula rows
+//    run JR $ in contended Spectrum memory, with 50 Hz events.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <Scheduler.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct BenchProgram {
+   const char*          name;
+   uint16_t             org;
+   std::vector<uint8_t> code;
+};
+
+const BenchProgram g_programs[] = {
+   // NOPs and HALT
+   { "halt", 0x0000, { 0x00, 0x00, 0x00, 0x76 } },
+   // INC A / JR $
+   { "jr",   0x0000, { 0x3C, 0x18, 0xFE } },
+   // INC A / JP $
+   { "jp",   0x0000, { 0x3C, 0xC3, 0x01, 0x00 } },
+   // INC A / JR $, in contended memory
+   { "ula",  0x6000, { 0x3C, 0x18, 0xFE } }
+};
+
+// Device called every period ticks
+struct Device {
+   uint64_t period;
+   uint64_t calls = 0;
+};
+
+template <class CONTENTION>
+uint64_t
+runTStates(const BenchProgram& p, uint64_t ticks, uint64_t period, bool batch) {
+   Memory                mem;
+   MemoryBus<CONTENTION> bus(mem);
+   Z80                   cpu;
+   Scheduler             sched;
+   Device                dev { period };
+   mem.load(p.org, p.code.data(), p.code.size());
+   cpu.setPC(p.org);
+
+   struct Event {
+      Device* d; Scheduler* s;
+      void operator()(uint64_t tick) const {
+         ++d->calls;
+         s->schedule(tick + d->period, *this);
+      }
+   };
+   sched.schedule(period, Event{ &dev, &sched });
+   if ( batch ) {
+      sched.run(cpu, bus, ticks);
+   } else {
+      for (uint64_t t=0; t < ticks; ++t) {
+         cpu.tick(bus);
+         sched.dispatch(cpu.ticks());
+      }
+   }
+   return cpu.registers().R + dev.calls;
+}
+
+uint64_t
+runInstructions(const BenchProgram& p, uint64_t ticks, uint64_t period, bool batch) {
+   Memory mem;
+   Z80    cpu(Engine::Instruction);
+   Device dev { period };
+   mem.load(p.org, p.code.data(), p.code.size());
+   cpu.setPC(p.org);
+
+   for (uint64_t next = period; cpu.ticks() < ticks; next += period) {
+      if ( batch ) {
+         cpu.execute(mem, next - cpu.ticks());
+      } else {
+         do { cpu.execute(mem); } while ( cpu.ticks() < next );
+      }
+      ++dev.calls;
+   }
+   return cpu.registers().R + dev.calls;
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 40000000;
+
+   std::cout << std::setw(8) << "program" << std::setw(8) << "engine" << std::setw(14) << "ticked MHz"
+             << std::setw(14) << "batch MHz" << std::setw(12) << "speedup\n";
+   for (const auto& p : g_programs) {
+      const bool     ula    = p.org == 0x6000;
+      const uint64_t period = ula ? ULAContention::FRAME : 4000000 / 300;
+      for (bool tstates : { true, false }) {
+         uint64_t ns[2], res[2];
+         for (bool batch : { false, true }) {
+            Timer<uint64_t> t;
+            if      ( !tstates ) res[batch] = runInstructions(p, ticks, period, batch);
+            else if ( ula )      res[batch] = runTStates<ULAContention>(p, ticks, period, batch);
+            else                 res[batch] = runTStates<CPCContention>(p, ticks, period, batch);
+            ns[batch] = t.ns();
+         }
+         if ( res[0] != res[1] )
+            std::cout << "ERROR: results differ\n";
+
+         std::cout << std::setw(8) << p.name << std::setw(8) << (tstates ? "tstate" : "instr")
+                   << std::fixed << std::setprecision(2)
+                   << std::setw(14) << (double)ticks * 1000 / ns[0]
+                   << std::setw(14) << (double)ticks * 1000 / ns[1]
+                   << std::setw(12) << (double)ns[0] / ns[1] << "\n";
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,118 @@
+//
+// Interrupt microbenchmark
+//    The CPC's Gate Array interrupt as reference workload: INT raised
+//    at 300 Hz (every 52 lines of 64 us), serviced in IM 1 by a handler
+//    at 0038h counting interrupts, while the main program runs a busy
+//    loop or waits in HALT. Polling runs every T-state (tstate: tick()
+//    and a device checking the tick count) or every instruction (instr:
+//    execute() one by one). Events raise INT from the Scheduler instead
+//    (tstate: run(), instr: execute(mem, ticks) up to the next one), and
+//    the CPU only checks for it at instruction boundaries.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <Scheduler.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+constexpr uint64_t PERIOD  = 52 * 64 * 4;    // 300 Hz at 4 MHz
+constexpr uint16_t COUNTER = 0x9000;         // Interrupts serviced
+
+struct BenchProgram {
+   const char*          name;
+   std::vector<uint8_t> loop;     // Main loop, at 0x0007
+};
+
+const BenchProgram g_programs[] = {
+   // INC A / LD B,A / ADD A,C / DEC D / JR loop
+   { "busy", { 0x3C, 0x47, 0x81, 0x15, 0x18, 0xFA } },
+   // HALT / JR loop
+   { "halt", { 0x76, 0x18, 0xFD } }
+};
+
+// DI / LD SP,0x8000 / IM 1 / EI / loop. Handler at 0x0038:
+// PUSH AF / PUSH HL / LD HL,(COUNTER) / INC HL / LD (COUNTER),HL / POP HL /
+// POP AF / EI / RET
+void
+load(Memory& mem, const BenchProgram& p) {
+   std::vector<uint8_t> code = { 0xF3, 0x31, 0x00, 0x80, 0xED, 0x56, 0xFB };
+   code.insert(code.end(), p.loop.begin(), p.loop.end());
+   const uint8_t handler[] = { 0xF5, 0xE5, 0x2A, COUNTER & 0xFF, COUNTER >> 8, 0x23
+                             , 0x22, COUNTER & 0xFF, COUNTER >> 8, 0xE1, 0xF1, 0xFB, 0xC9 };
+   mem.load(0, code.data(), code.size());
+   mem.load(0x38, handler, sizeof(handler));
+}
+
+uint64_t
+runTStates(const BenchProgram& p, uint64_t ticks, bool events) {
+   Memory                   mem;
+   MemoryBus<CPCContention> bus(mem);
+   Z80                      cpu;
+   load(mem, p);
+
+   if ( events ) {
+      Scheduler sched;
+      struct Raise {
+         Z80* cpu; Scheduler* s;
+         void operator()(uint64_t tick) const {
+            cpu->setSignal(Signal::INT);
+            s->schedule(tick + PERIOD, *this);
+         }
+      };
+      sched.schedule(PERIOD, Raise{ &cpu, &sched });
+      sched.run(cpu, bus, ticks);
+   } else {
+      for (uint64_t next = PERIOD; cpu.ticks() < ticks; ) {
+         cpu.tick(bus);
+         if ( cpu.ticks() == next ) { cpu.setSignal(Signal::INT); next += PERIOD; }
+      }
+   }
+   return mem.read(COUNTER) | mem.read(COUNTER + 1) << 8;
+}
+
+uint64_t
+runInstructions(const BenchProgram& p, uint64_t ticks, bool events) {
+   Memory mem;
+   Z80    cpu(Engine::Instruction);
+   load(mem, p);
+
+   for (uint64_t next = PERIOD; cpu.ticks() < ticks; next += PERIOD) {
+      if ( events ) cpu.execute(mem, next - cpu.ticks());
+      else          do { cpu.execute(mem); } while ( cpu.ticks() < next );
+      cpu.setSignal(Signal::INT);
+   }
+   return mem.read(COUNTER) | mem.read(COUNTER + 1) << 8;
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 40000000;
+
+   std::cout << std::setw(8) << "program" << std::setw(8) << "engine" << std::setw(14) << "polled MHz"
+             << std::setw(14) << "events MHz" << std::setw(10) << "speedup" << std::setw(12) << "interrupts\n";
+   for (const auto& p : g_programs) {
+      for (bool tstates : { true, false }) {
+         uint64_t ns[2], res[2];
+         for (bool events : { false, true }) {
+            Timer<uint64_t> t;
+            res[events] = tstates ? runTStates(p, ticks, events) : runInstructions(p, ticks, events);
+            ns[events]  = t.ns();
+         }
+         if ( res[0] != res[1] )
+            std::cout << "ERROR: results differ\n";
+
+         std::cout << std::setw(8) << p.name << std::setw(8) << (tstates ? "tstate" : "instr")
+                   << std::fixed << std::setprecision(2)
+                   << std::setw(14) << (double)ticks * 1000 / ns[0]
+                   << std::setw(14) << (double)ticks * 1000 / ns[1]
+                   << std::setw(10) << (double)ns[0] / ns[1]
+                   << std::setw(11) << res[1] << "\n";
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,152 @@
+//
+// Program loader microbenchmark
+//    A 48K program is written as a raw binary, as Intel HEX (32 bytes per
+//    record, as sdcc emits it) and as a 64K CPC snapshot. Loading it costs
+//    reading the binary through std::ifstream into a buffer and writing
+//    it byte by byte (ifstream), or the Loader functions over the mapped
+//    file (bin, ihx, sna). Intel HEX used to need hex2bin first: the
+//    ihx column is the whole cost of loading it now. Malformed disk
+//    images (more tracks than the header describes, tracks smaller than
+//    their Track-Info block) must be rejected, not read past their end,
+//    and so must Intel HEX records past FFFFh.
+//
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Loader.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+constexpr uint32_t SIZE = 48 * 1024;
+const char* const  BIN  = "loaders.bin";
+const char* const  IHX  = "loaders.ihx";
+const char* const  SNA  = "loaders.sna";
+const char* const  DSK  = "loaders.dsk";
+
+// Intel HEX record of type, with its checksum
+void
+record(std::ostream& out, uint16_t addr, uint8_t type, const uint8_t* data, uint8_t size) {
+   static const char HEX[] = "0123456789ABCDEF";
+   std::vector<uint8_t> bytes = { size, uint8_t(addr >> 8), uint8_t(addr), type };
+   bytes.insert(bytes.end(), data, data + size);
+   uint8_t sum = 0;
+   for (uint8_t b : bytes) sum += b;
+   bytes.push_back(-sum);
+   out << ':';
+   for (uint8_t b : bytes) out << HEX[b >> 4] << HEX[b & 15];
+   out << "\r\n";
+}
+
+// Whether Loader::dsk rejects a disk image header (no track sizes in
+// extended images) followed by a track of trackSize bytes, which is where
+// the file ends
+bool
+rejected(const char* magic, uint8_t tracks, uint8_t sides, uint16_t trackSize) {
+   std::vector<uint8_t> dsk(0x100 + trackSize);
+   std::copy(magic, magic + std::strlen(magic), dsk.begin());
+   dsk[0x30] = tracks;
+   dsk[0x31] = sides;
+   if ( trackSize ) {
+      dsk[0x32] = trackSize;
+      dsk[0x33] = trackSize >> 8;
+      const char info[] = "Track-Info\r\n";
+      std::copy(info, info + std::min<std::size_t>(trackSize, 12), dsk.begin() + 0x100);
+   }
+   std::ofstream(DSK, std::ios::binary).write(reinterpret_cast<const char*>(dsk.data()), dsk.size());
+   Z80    cpu;
+   Memory mem;
+   try { Loader::dsk(DSK, cpu, mem); } catch (const std::runtime_error&) { return true; }
+   return false;
+}
+
+// Whether Loader::ihx rejects a data record of 32 bytes at FFF0h, which
+// would wrap around to 0000h
+bool
+rejectedWrap(const uint8_t* data) {
+   {
+      std::ofstream ihx(IHX, std::ios::binary);
+      record(ihx, 0xFFF0, 0x00, data, 32);
+      record(ihx, 0, 0x01, nullptr, 0);
+   }
+   Memory mem;
+   try { Loader::ihx(IHX, mem); } catch (const std::runtime_error&) { return true; }
+   return false;
+}
+
+// Raw binary as the interactive loader used to read it
+void
+ifstreamLoad(const char* file, Memory& mem) {
+   std::ifstream        f(file, std::ios::binary);
+   std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+   for (std::size_t i = 0; i < bytes.size(); ++i) mem.write(i, bytes[i]);
+}
+
+int main(int argc, char* argv[]) {
+   const unsigned reps = (argc > 1) ? std::stoul(argv[1]) : 200;
+
+   std::vector<uint8_t> program(SIZE);
+   for (uint32_t i = 0; i < SIZE; ++i) program[i] = i * 7 + (i >> 8);
+   bool ok = rejected("EXTENDED CPC DSK File\r\nDisk-Info\r\n", 255, 255, 0)
+          && rejected("MV - CPCEMU Disk-File\r\nDisk-Info\r\n", 1, 1, 0x10)
+          && rejectedWrap(program.data());
+   std::remove(DSK);
+   if ( !ok )
+      std::cout << "ERROR: malformed image not rejected\n";
+
+   {
+      std::ofstream bin(BIN, std::ios::binary);
+      bin.write(reinterpret_cast<const char*>(program.data()), SIZE);
+      std::ofstream ihx(IHX, std::ios::binary);
+      for (uint32_t a = 0; a < SIZE; a += 32) record(ihx, a, 0x00, &program[a], 32);
+      record(ihx, 0, 0x01, nullptr, 0);
+      std::vector<uint8_t> sna(0x100 + 64 * 1024);
+      std::copy(program.begin(), program.end(), sna.begin() + 0x100);
+      const char magic[] = "MV - SNA";
+      std::copy(magic, magic + 8, sna.begin());
+      sna[0x10] = 1;
+      sna[0x6C] = 64 >> 8;
+      sna[0x6B] = 64 & 0xFF;
+      std::ofstream(SNA, std::ios::binary).write(reinterpret_cast<const char*>(sna.data()), sna.size());
+   }
+
+   uint64_t ns[4] = {};
+   for (unsigned r = 0; r < reps; ++r) {
+      for (int mode = 0; mode < 4; ++mode) {
+         Z80    cpu;
+         Memory mem;
+         Timer<uint64_t> t;
+         switch ( mode ) {
+            case 0: ifstreamLoad(BIN, mem);     break;
+            case 1: Loader::bin(BIN, mem);      break;
+            case 2: Loader::ihx(IHX, mem);      break;
+            case 3: Loader::sna(SNA, cpu, mem); break;
+         }
+         ns[mode] += t.ns();
+         for (uint32_t i = 0; i < SIZE; i += 97) ok = ok && mem.read(i) == program[i];
+      }
+   }
+   std::remove(BIN);
+   std::remove(IHX);
+   std::remove(SNA);
+   if ( !ok )
+      std::cout << "ERROR: loaded program differs\n";
+
+   std::cout << std::setw(14) << "ifstream us" << std::setw(12) << "bin us" << std::setw(12) << "ihx us"
+             << std::setw(12) << "sna us" << std::setw(12) << "speedup\n";
+   std::cout << std::fixed << std::setprecision(2)
+             << std::setw(14) << ns[0] / 1000.0 / reps
+             << std::setw(12) << ns[1] / 1000.0 / reps
+             << std::setw(12) << ns[2] / 1000.0 / reps
+             << std::setw(12) << ns[3] / 1000.0 / reps
+             << std::setw(11) << (double)ns[0] / ns[1] << "\n";
+   return 0;
+}
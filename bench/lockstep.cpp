@@ -0,0 +1,69 @@
+//
+// Lockstep engine microbenchmark
+//    Runs the same program on 8, 16 and 32 CPUs, each one with its own
+//    registers and Memory, first one by one with the scalar Instruction
+//    engine and then in lockstep. Reports lane instructions per second.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Lockstep.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct BenchProgram {
+   const char*          name;
+   std::vector<uint8_t> code;
+};
+
+const BenchProgram g_programs[] = {
+   // INC/DEC rr, LD r,r', EX AF,AF', EXX, EX DE,HL and back to start
+   { "regs",  { 0x03, 0x13, 0x23, 0x0B, 0x41, 0x5A, 0x6B, 0x7C, 0x08, 0xD9
+              , 0xEB, 0x33, 0x3B, 0x78, 0x4F, 0x18, 0xF0 } },
+   // LD r,n / LD r,r / LD (HL),r and back to start (as in bench/tstates)
+   { "load8", { 0x26, 0x0A, 0x2E, 0x10, 0x06, 0x3E, 0x0E, 0x11, 0x16, 0x06
+              , 0x70, 0x69, 0x71, 0x2E, 0x12, 0x72, 0x7A, 0x47, 0xC3, 0x00, 0x00 } }
+};
+
+template <unsigned LANES>
+void
+bench(const BenchProgram& p, uint64_t steps) {
+   Memory image;
+   image.load(0, p.code.data(), p.code.size());
+
+   // Scalar: Every CPU runs its own loop
+   std::vector<Z80>    cpus(LANES, Z80(Engine::Instruction));
+   std::vector<Memory> mems(LANES, image);
+   Timer<uint64_t> ts;
+   for (unsigned l = 0; l < LANES; ++l)
+      for (uint64_t s = 0; s < steps; ++s) cpus[l].execute(mems[l]);
+   uint64_t nss = ts.ns();
+
+   // Lockstep
+   Lockstep<LANES> ls(image);
+   Timer<uint64_t> tl;
+   ls.run(steps);
+   uint64_t nsl = tl.ns();
+
+   const uint64_t instr = steps * LANES;
+   std::cout << std::setw(8) << p.name << std::setw(8) << LANES
+             << std::setw(14) << instr * 1000 / nss << std::setw(14) << instr * 1000 / nsl
+             << std::setw(10) << std::fixed << std::setprecision(2) << (double)nss / nsl << "\n";
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t steps = (argc > 1) ? std::stoull(argv[1]) : 5000000;
+
+   std::cout << std::setw(8) << "program" << std::setw(8) << "lanes"
+             << std::setw(14) << "scalar MI/s" << std::setw(14) << "lockstep MI/s" << std::setw(10) << "speedup\n";
+   for (const auto& p : g_programs) {
+      bench<8> (p, steps);
+      bench<16>(p, steps / 2);
+      bench<32>(p, steps / 4);
+   }
+   return 0;
+}
@@ -0,0 +1,146 @@
+//
+// IO port dispatch microbenchmark
+//    The CPC's devices as reference workload: Gate Array, CRTC, ROM
+//    select, printer, PPI and FDC, all partially decoded. Ports found
+//    with a linear scan of the (port & mask) == value decoders (scan)
+//    against the 64K table of IOPorts (table), on a stream of the ports
+//    CPC software uses. Then an IO-heavy loop (OUT to the Gate Array and
+//    CRTC, IN from the PPI) runs on both engines with the devices attached.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <IOPorts.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct Decoder {
+   const char* name;
+   uint16_t    mask, value;
+};
+
+const Decoder g_devices[] = {
+   { "gate array", 0xC000, 0x4000 },   // &7Fxx
+   { "crtc",       0x4000, 0x0000 },   // &BCxx-&BFxx
+   { "rom select", 0x2000, 0x0000 },   // &DFxx
+   { "printer",    0x1000, 0x0000 },   // &EFxx
+   { "ppi",        0x0800, 0x0000 },   // &F4xx-&F7xx
+   { "fdc",        0x0480, 0x0000 }    // &FB7E-&FB7F
+};
+
+const uint16_t g_ports[] = { 0x7F00, 0xBC00, 0xBD00, 0xDF00, 0xEF00, 0xF400, 0xF500, 0xF600, 0xF700, 0xFB7E, 0xFB7F };
+
+// Devices: a latch per device, and a value read
+struct Devices {
+   uint8_t latch[8] = {};
+   IOPorts::In  in(uint8_t i)  { return [this, i](uint16_t) { return uint8_t(latch[i] | 0x80); }; }
+   IOPorts::Out out(uint8_t i) { return [this, i](uint16_t, uint8_t v) { latch[i] = v; }; }
+   void attach(IOPorts& io) {
+      for (uint8_t i = 0; i < std::size(g_devices); ++i)
+         io.attach(g_devices[i].mask, g_devices[i].value, in(i), out(i));
+   }
+};
+
+// Port accesses: every port is written, then read, calling the handlers
+// of every device whose decoder matches
+uint64_t
+dispatchScan(const std::vector<uint16_t>& ports, unsigned reps) {
+   struct Handler { uint16_t mask, value; IOPorts::In in; IOPorts::Out out; };
+   Devices              dev;
+   std::vector<Handler> handlers;
+   for (uint8_t i = 0; i < std::size(g_devices); ++i)
+      handlers.push_back(Handler{ g_devices[i].mask, g_devices[i].value, dev.in(i), dev.out(i) });
+
+   uint64_t sum = 0;
+   for (unsigned r = 0; r < reps; ++r) {
+      for (uint16_t p : ports) {
+         for (const auto& h : handlers)
+            if ( (p & h.mask) == h.value ) h.out(p, uint8_t(p));
+         uint8_t data = 0xFF;
+         for (const auto& h : handlers)
+            if ( (p & h.mask) == h.value ) data &= h.in(p);
+         sum += data;
+      }
+   }
+   return sum;
+}
+
+uint64_t
+dispatchTable(const std::vector<uint16_t>& ports, unsigned reps) {
+   Devices dev;
+   IOPorts io;
+   dev.attach(io);
+   uint64_t sum = 0;
+   for (unsigned r = 0; r < reps; ++r) {
+      for (uint16_t p : ports) {
+         io.out(p, uint8_t(p));
+         sum += io.in(p);
+      }
+   }
+   return sum;
+}
+
+// LD BC,0x7F10 / loop: OUT (C),C / LD B,0xBC / OUT (C),A / LD B,0xF5 /
+// IN A,(C) / LD B,0x7F / INC C / JR loop
+const uint8_t g_loop[] = { 0x01, 0x10, 0x7F, 0xED, 0x49, 0x06, 0xBC, 0xED, 0x79, 0x06, 0xF5
+                         , 0xED, 0x78, 0x06, 0x7F, 0x0C, 0x18, 0xF0 };
+
+void
+runLoop(bool tstates, uint64_t ticks) {
+   Memory  mem;
+   IOPorts io;
+   Devices dev;
+   dev.attach(io);
+   mem.load(0, g_loop, sizeof(g_loop));
+
+   if ( tstates ) {
+      MemoryBus<CPCContention> bus(mem, &io);
+      Z80                      cpu;
+      cpu.run(bus, ticks);
+      return;
+   }
+   Z80 cpu(Engine::Instruction);
+   cpu.setPorts(&io);
+   cpu.execute(mem, ticks);
+}
+
+int main(int argc, char* argv[]) {
+   const unsigned reps  = (argc > 1) ? std::stoul(argv[1]) : 2000;
+   const uint64_t ticks = (argc > 2) ? std::stoull(argv[2]) : 40000000;
+
+   std::mt19937          rng(1);
+   std::vector<uint16_t> ports(16384);
+   for (auto& p : ports) p = g_ports[rng() % std::size(g_ports)] | (rng() & 0xFF) * (rng() & 1);
+
+   const uint64_t accesses = uint64_t(reps) * ports.size();
+   uint64_t ns[2], res[2];
+   for (bool table : { false, true }) {
+      Timer<uint64_t> t;
+      res[table] = table ? dispatchTable(ports, reps) : dispatchScan(ports, reps);
+      ns[table]  = t.ns();
+   }
+   if ( res[0] != res[1] )
+      std::cout << "ERROR: results differ\n";
+
+   std::cout << std::setw(8) << "devices" << std::setw(14) << "scan ns/io" << std::setw(14) << "table ns/io"
+             << std::setw(10) << "speedup\n";
+   std::cout << std::setw(8) << std::size(g_devices) << std::fixed << std::setprecision(2)
+             << std::setw(14) << (double)ns[0] / accesses
+             << std::setw(14) << (double)ns[1] / accesses
+             << std::setw(10) << (double)ns[0] / ns[1] << "\n\n";
+
+   std::cout << std::setw(8) << "engine" << std::setw(14) << "IO loop MHz\n";
+   for (bool tstates : { true, false }) {
+      Timer<uint64_t> t;
+      runLoop(tstates, ticks);
+      std::cout << std::setw(8) << (tstates ? "tstate" : "instr")
+                << std::setw(13) << (double)ticks * 1000 / t.ns() << "\n";
+   }
+   return 0;
+}
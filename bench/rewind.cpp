@@ -0,0 +1,96 @@
+//
+// Rewind microbenchmark
+//    A program drawing into CPC screen memory (&C000-&FFFF, one byte out
+//    of every 40 T-states or so) runs for a number of emulated seconds,
+//    with checkpoints every frame (50 Hz) or every 10 frames. Columns:
+//    speed with no checkpoints (plain) and with them (rewind), memory
+//    kept per emulated second, and the time to go back to a random tick
+//    before the current one by rewindTo(), against running from the
+//    start again (rerun).
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <Rewind.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+constexpr uint64_t HZ     = 4000000;
+constexpr uint64_t FRAME  = HZ / 50;
+constexpr size_t   BUDGET = 64 << 20;
+
+// LD HL,0xC000 / LD DE,0x0051 / loop: LD (HL),A / ADD HL,DE / SET 7,H /
+// SET 6,H / ADD A,L / JR loop
+const uint8_t g_draw[] = { 0x21, 0x00, 0xC0, 0x11, 0x51, 0x00, 0x77, 0x19, 0xCB, 0xFC
+                         , 0xCB, 0xF4, 0x85, 0x18, 0xF6 };
+
+struct Machine {
+   Memory                   mem;
+   MemoryBus<CPCContention> bus { mem };
+   Z80                      cpu;
+   explicit Machine(Engine e) : cpu(e) { mem.load(0, g_draw, sizeof(g_draw)); }
+   void run(uint64_t ticks) {
+      if ( cpu.engine() == Engine::TState ) cpu.run(bus, ticks);
+      else                                  cpu.execute(mem, ticks);
+   }
+};
+
+int main(int argc, char* argv[]) {
+   const uint64_t seconds = (argc > 1) ? std::stoull(argv[1]) : 5;
+   const unsigned jumps   = (argc > 2) ? std::stoul(argv[2]) : 20;
+   const uint64_t ticks   = seconds * HZ;
+
+   std::cout << std::setw(8) << "engine" << std::setw(8) << "period" << std::setw(12) << "plain MHz"
+             << std::setw(12) << "rewind MHz" << std::setw(12) << "KB/sec" << std::setw(14) << "rewind ms"
+             << std::setw(12) << "rerun ms\n";
+   for (Engine e : { Engine::TState, Engine::Instruction }) {
+      for (uint64_t period : { FRAME, FRAME * 10 }) {
+         Timer<uint64_t> t;
+         Machine plain(e);
+         plain.run(ticks);
+         const uint64_t nsPlain = t.ns();
+
+         Machine m(e);
+         t.reset();
+         Rewind rw(m.cpu, m.mem, period, BUDGET);
+         if ( e == Engine::TState ) rw.run(m.bus, ticks);
+         else                       rw.run(ticks);
+         const uint64_t nsRewind = t.ns();
+         const double   kbs      = rw.bytesPerSecond(HZ) / 1024;
+
+         // Random steps back, each one compared to running from the start
+         std::mt19937 rng(1);
+         uint64_t nsJumps = 0, nsRerun = 0;
+         bool     ok      = true;
+         for (unsigned j = 0; j < jumps; ++j) {
+            const uint64_t tick = m.cpu.ticks() - rng() % ((m.cpu.ticks() - rw.oldest()) / (jumps - j) + 1);
+            t.reset();
+            if ( e == Engine::TState ) rw.rewindTo(m.bus, tick);
+            else                       rw.rewindTo(tick);
+            nsJumps += t.ns();
+
+            Machine again(e);
+            t.reset();
+            again.run(tick);
+            nsRerun += t.ns();
+            ok = ok && again.cpu.ticks() == m.cpu.ticks() && again.cpu.registers().main.AF == m.cpu.registers().main.AF;
+         }
+         if ( !ok )
+            std::cout << "ERROR: rewound state differs\n";
+
+         std::cout << std::setw(8) << (e == Engine::TState ? "tstate" : "instr")
+                   << std::setw(8) << period / FRAME << std::fixed << std::setprecision(2)
+                   << std::setw(12) << (double)ticks * 1000 / nsPlain
+                   << std::setw(12) << (double)ticks * 1000 / nsRewind
+                   << std::setw(12) << kbs
+                   << std::setw(14) << nsJumps / 1e6 / jumps
+                   << std::setw(11) << nsRerun / 1e6 / jumps << "\n";
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,116 @@
+//
+// Save state restore microbenchmark
+//    A CPC 6128 (8 RAM banks) boots for a number of T-states, running a
+//    program that clears and fills all of its RAM through bank switching,
+//    as firmware initialisation does. Getting to that state again costs
+//    booting (boot), reading a RAM dump through std::ifstream into Memory
+//    (read), or restoring the save state (restore), which maps it. The
+//    touch column also reads every byte of RAM after restoring, paying
+//    for the pages mapped on demand.
+//
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <SaveState.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+constexpr uint32_t BANKS = 8;
+const char* const  STATE = "savestate.sav";
+const char* const  DUMP  = "savestate.ram";
+volatile uint64_t  g_touched;   // Keeps the touch loop
+
+// loop: LD HL,0x4000 / LD (HL),C / LD DE,0x4001 / LD BC,0x3FFF / LDIR /
+// LD C,A / INC A / OUT (C),A (bank select, ignored) / JR loop
+const uint8_t g_boot[] = { 0x21, 0x00, 0x40, 0x71, 0x11, 0x01, 0x40, 0x01, 0xFF, 0x3F
+                         , 0xED, 0xB0, 0x4F, 0x3C, 0xED, 0x79, 0x18, 0xEE };
+
+// Boot the machine, banking RAM bank (A % 8) at page 1 every iteration
+void
+boot(Z80& cpu, Memory& mem, uint64_t ticks) {
+   MemoryBus<CPCContention> bus(mem);
+   mem.load(0, g_boot, sizeof(g_boot));
+   while ( cpu.ticks() < ticks ) {
+      cpu.run(bus, 100000);
+      mem.map(1, cpu.registers().main.A % BANKS);
+   }
+}
+
+uint64_t
+checksum(const Z80& cpu, const Memory& mem) {
+   uint64_t sum = cpu.ticks() + cpu.registers().PC;
+   for (uint32_t b = 0; b < mem.banks(); ++b)
+      for (uint32_t i = 0; i < Memory::PAGE_SIZE; i += 64) sum = sum * 31 + mem.bank(b)[i];
+   return sum;
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 8000000;
+   const unsigned reps  = (argc > 2) ? std::stoul(argv[2]) : 100;
+
+   // Boot once, and save it both ways
+   Timer<uint64_t> t;
+   Z80    booted;
+   Memory mem(BANKS);
+   boot(booted, mem, ticks);
+   const uint64_t nsBoot = t.ns();
+   SaveState::save(STATE, booted, mem);
+   {
+      std::ofstream f(DUMP, std::ios::binary);
+      for (uint32_t b = 0; b < BANKS; ++b) f.write(reinterpret_cast<const char*>(mem.bank(b)), Memory::PAGE_SIZE);
+   }
+   const uint64_t sum = checksum(booted, mem);
+
+   // Read the dump, restore the state and restore+touch, reps times each
+   uint64_t ns[3] = {};
+   bool     ok    = true;
+   for (unsigned r = 0; r < reps; ++r) {
+      for (int mode = 0; mode < 3; ++mode) {
+         Z80    cpu;
+         Memory m(BANKS);
+         t.reset();
+         if ( mode == 0 ) {
+            std::ifstream f(DUMP, std::ios::binary);
+            std::vector<uint8_t> data(Memory::PAGE_SIZE);
+            for (uint32_t b = 0; b < BANKS; ++b) {
+               f.read(reinterpret_cast<char*>(data.data()), data.size());
+               std::memcpy(m.bank(b), data.data(), data.size());
+            }
+            cpu.setRegisters(booted.registers());
+         } else {
+            SaveState::restore(STATE, cpu, m);
+            if ( mode == 2 ) {
+               const Memory& ram   = m;
+               uint64_t      touch = 0;
+               for (uint32_t b = 0; b < BANKS; ++b)
+                  for (uint32_t i = 0; i < Memory::PAGE_SIZE; ++i) touch += ram.bank(b)[i];
+               g_touched = touch;
+            }
+         }
+         ns[mode] += t.ns();
+         if ( mode && checksum(cpu, m) != sum ) ok = false;
+      }
+   }
+   std::remove(STATE);
+   std::remove(DUMP);
+   if ( !ok )
+      std::cout << "ERROR: restored state differs\n";
+
+   std::cout << std::setw(14) << "boot us" << std::setw(14) << "read us" << std::setw(14) << "restore us"
+             << std::setw(14) << "+touch us" << std::setw(12) << "speedup\n";
+   std::cout << std::fixed << std::setprecision(2)
+             << std::setw(14) << nsBoot / 1000.0
+             << std::setw(14) << ns[0] / 1000.0 / reps
+             << std::setw(14) << ns[1] / 1000.0 / reps
+             << std::setw(14) << ns[2] / 1000.0 / reps
+             << std::setw(11) << (double)nsBoot * reps / ns[1] << "\n";
+   return 0;
+}
@@ -0,0 +1,91 @@
+//
+// Bus trace microbenchmark
+//    A program drawing into CPC screen memory runs on the T-state engine
+//    (CPC contention) for a number of ticks: untraced by run() (run) and
+//    tick() by tick() (tick), traced into a BusTrace file (trace), and
+//    printing every T-state with Printer::printCPUStatus into a string
+//    (text, on a hundredth of the ticks). Columns are MHz, the slowdown
+//    of tracing against run(), bytes of trace per T-state and records
+//    that had to wait for room in the ring.
+//
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <BusTrace.hpp>
+#include <Printer.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+const char* const TRACE = "trace.trc";
+
+// LD HL,0xC000 / LD DE,0x0051 / loop: LD (HL),A / ADD HL,DE / SET 7,H /
+// SET 6,H / ADD A,L / JR loop
+const uint8_t g_draw[] = { 0x21, 0x00, 0xC0, 0x11, 0x51, 0x00, 0x77, 0x19, 0xCB, 0xFC
+                         , 0xCB, 0xF4, 0x85, 0x18, 0xF6 };
+
+struct Machine {
+   Memory                   mem;
+   MemoryBus<CPCContention> bus { mem };
+   Z80                      cpu;
+   Machine() { mem.load(0, g_draw, sizeof(g_draw)); }
+};
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 100000000;
+
+   Timer<uint64_t> t;
+   Machine run;
+   run.cpu.run(run.bus, ticks);
+   const uint64_t nsRun = t.ns();
+
+   Machine tick;
+   t.reset();
+   for (uint64_t i = 0; i < ticks; ++i) tick.cpu.tick(tick.bus);
+   const uint64_t nsTick = t.ns();
+
+   Machine  traced;
+   uint64_t stalls, bytes;
+   t.reset();
+   {
+      BusTrace trace(TRACE);
+      trace.run(traced.cpu, traced.bus, ticks);
+      trace.close();
+      stalls = trace.stalls();
+      bytes  = trace.bytes();
+   }
+   const uint64_t nsTrace = t.ns();
+   std::remove(TRACE);
+
+   Machine            text;
+   std::ostringstream out;
+   Printer            printer(out);
+   t.reset();
+   for (uint64_t i = 0; i < ticks / 100; ++i) {
+      text.cpu.tick(text.bus);
+      printer.printCPUStatus(text.cpu);
+      if ( out.tellp() > (1 << 24) ) out.str("");
+   }
+   const uint64_t nsText = t.ns() * 100;
+
+   if ( traced.cpu.ticks() != run.cpu.ticks() || traced.cpu.registers().PC != run.cpu.registers().PC )
+      std::cout << "ERROR: traced run differs\n";
+
+   std::cout << std::setw(10) << "run MHz" << std::setw(10) << "tick MHz" << std::setw(11) << "trace MHz"
+             << std::setw(10) << "text MHz" << std::setw(10) << "slowdown" << std::setw(10) << "B/tick"
+             << std::setw(9) << "stalls\n";
+   std::cout << std::fixed << std::setprecision(2)
+             << std::setw(10) << (double)ticks * 1000 / nsRun
+             << std::setw(10) << (double)ticks * 1000 / nsTick
+             << std::setw(11) << (double)ticks * 1000 / nsTrace
+             << std::setw(10) << (double)ticks * 1000 / nsText
+             << std::setw(10) << (double)nsTrace / nsRun
+             << std::setw(10) << (double)bytes / ticks
+             << std::setw(8)  << stalls << "\n";
+   return 0;
+}
@@ -0,0 +1,87 @@
+//
+// Trace diff microbenchmark
+//    Two bus traces of a program drawing into CPC screen memory, a number
+//    of T-states long, where the second one gets A changed at 90% of the
+//    way: their pins differ from the next screen write on. The first
+//    different T-state is found by TraceDiff (diff), and by decoding both
+//    traces record by record until they differ (decode). Columns are the
+//    size of each trace, times, the throughput of diff over the bytes
+//    compared, and the tick found.
+//
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <BusTrace.hpp>
+#include <TraceDiff.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+const char* const TRACE_A = "tracediff_a.trc";
+const char* const TRACE_B = "tracediff_b.trc";
+
+// LD HL,0xC000 / LD DE,0x0051 / loop: LD (HL),A / ADD HL,DE / SET 7,H /
+// SET 6,H / ADD A,L / JR loop
+const uint8_t g_draw[] = { 0x21, 0x00, 0xC0, 0x11, 0x51, 0x00, 0x77, 0x19, 0xCB, 0xFC
+                         , 0xCB, 0xF4, 0x85, 0x18, 0xF6 };
+
+// Trace ticks T-states, changing A at tick change (if any)
+uint64_t
+trace(const char* file, uint64_t ticks, uint64_t change) {
+   Memory                   mem;
+   MemoryBus<CPCContention> bus(mem);
+   Z80                      cpu;
+   mem.load(0, g_draw, sizeof(g_draw));
+   BusTrace t(file);
+   t.run(cpu, bus, change);
+   Registers r = cpu.registers();
+   r.main.A ^= 0x01;
+   cpu.setRegisters(r);
+   t.run(cpu, bus, ticks - change);
+   t.close();
+   return t.bytes();
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 50000000;
+
+   const uint64_t bytes = trace(TRACE_A, ticks, ticks);
+   trace(TRACE_B, ticks, ticks / 10 * 9);
+
+   // Both files get mapped and read once before timing
+   TraceDiff::diff(TRACE_A, TRACE_B, 0);
+   Timer<uint64_t> t;
+   const TraceDiff::Result r = TraceDiff::diff(TRACE_A, TRACE_B);
+   const uint64_t nsDiff = t.ns();
+
+   t.reset();
+   uint64_t tick = 0;
+   {
+      BusTrace::Reader a(TRACE_A), b(TRACE_B);
+      BusTrace::Record x, y;
+      while ( a.next(x) && b.next(y) ) {
+         if ( x != y ) { tick = std::min(x.tick, y.tick); break; }
+      }
+   }
+   const uint64_t nsDecode = t.ns();
+   std::remove(TRACE_A);
+   std::remove(TRACE_B);
+
+   if ( r.equal || r.tick != tick )
+      std::cout << "ERROR: first difference not found\n";
+
+   std::cout << std::setw(10) << "MB" << std::setw(12) << "diff ms" << std::setw(12) << "decode ms"
+             << std::setw(10) << "GB/s" << std::setw(10) << "speedup" << std::setw(14) << "tick\n";
+   std::cout << std::fixed << std::setprecision(2)
+             << std::setw(10) << bytes / 1e6
+             << std::setw(12) << nsDiff / 1e6
+             << std::setw(12) << nsDecode / 1e6
+             << std::setw(10) << 2.0 * r.offset / nsDiff
+             << std::setw(10) << (double)nsDecode / nsDiff
+             << std::setw(13) << r.tick << "\n";
+   return 0;
+}
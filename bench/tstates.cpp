@@ -0,0 +1,101 @@
+//
+// T-state engine microbenchmark
+//    Measures ticks per second of the T-state engine on small looping
+//    programs, with and without the Amstrad CPC Gate-Array WAIT pattern.
+//    Memory is driven either from outside through the pins (pin) or by 
+//    an inlined Bus policy (bus).
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Bus.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct BenchProgram {
+   const char*          name;
+   std::vector<uint8_t> code;
+};
+
+const BenchProgram g_programs[] = {
+   // LD r,n / LD r,r / LD (HL),r and back to start
+   { "load8", { 0x26, 0x0A, 0x2E, 0x10, 0x06, 0x3E, 0x0E, 0x11, 0x16, 0x06
+              , 0x70, 0x69, 0x71, 0x2E, 0x12, 0x72, 0x7A, 0x47, 0xC3, 0x00, 0x00 } },
+   // 16-bit loads, stack and memory exchange
+   { "stack", { 0x31, 0x00, 0x08, 0x21, 0x22, 0x11, 0x01, 0xCC, 0xBB, 0xE5
+              , 0xC5, 0xE3, 0xD1, 0xC1, 0x22, 0x00, 0x09, 0x2A, 0x00, 0x09
+              , 0x23, 0x1B, 0x18, 0xF1 } },
+   // INC A / JR back (Tight loop. JR $ alone would be fast-forwarded)
+   { "jr",    { 0x3C, 0x18, 0xFD } }
+};
+
+uint64_t
+runPins(const BenchProgram& p, uint64_t ticks, bool wait) {
+   Memory mem;
+   Z80    cpu;
+   mem.load(0, p.code.data(), p.code.size());
+
+   uint8_t w = 2;
+   for (uint64_t t=0; t < ticks; ++t) {
+      if (wait) {
+         w = (w+1) & 0x3;
+         if (w) cpu.setSignal(Signal::WAIT);
+         else   cpu.rstSignal(Signal::WAIT);
+      }
+      cpu.tick();
+      if ( cpu.signal(Signal::MREQ) ) {
+         uint16_t addr = cpu.address();
+         if      ( cpu.signal(Signal::RD) ) cpu.setData(mem.read(addr));
+         else if ( cpu.signal(Signal::WR) ) mem.write(addr, cpu.data());
+      }
+   }
+   return cpu.registers().PC;
+}
+
+template <class CONTENTION>
+uint64_t
+runBus(const BenchProgram& p, uint64_t ticks) {
+   Memory                mem;
+   MemoryBus<CONTENTION> bus(mem);
+   Z80                   cpu;
+   mem.load(0, p.code.data(), p.code.size());
+
+   cpu.run(bus, ticks);
+   return cpu.registers().PC;
+}
+
+uint64_t
+run(const BenchProgram& p, uint64_t ticks, bool wait, bool pins) {
+   if (pins) return runPins(p, ticks, wait);
+   if (wait) return runBus<CPCContention>(p, ticks);
+   return runBus<NoContention>(p, ticks);
+}
+
+int main(int argc, char* argv[]) {
+   const uint64_t ticks = (argc > 1) ? std::stoull(argv[1]) : 50000000;
+
+   std::cout << "sizeof(TState): " << sizeof(TState) << " bytes. ";
+   std::cout << "Programs: " << g_tprograms.used << " T-states ("
+             << g_tprograms.used * sizeof(TState) << " bytes)\n";
+   std::cout << std::setw(8) << "program" << std::setw(8) << "wait" << std::setw(8) << "drive"
+             << std::setw(14) << "ticks/s" << std::setw(10) << "MHz" << "\n";
+   for (const auto& p : g_programs) {
+      for (bool wait : { false, true }) {
+         for (bool pins : { true, false }) {
+            Timer<uint64_t> t;
+            volatile uint64_t res = run(p, ticks, wait, pins);
+            (void)res;
+            uint64_t ns = t.ns();
+            std::cout << std::setw(8) << p.name << std::setw(8) << (wait ? "cpc" : "none")
+                      << std::setw(8) << (pins ? "pin" : "bus")
+                      << std::setw(14) << ticks*1000000000/ns 
+                      << std::setw(10) << std::fixed << std::setprecision(2) << (double)ticks*1000/ns << "\n";
+         }
+      }
+   }
+   return 0;
+}
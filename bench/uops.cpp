@@ -0,0 +1,52 @@
+//
+// Micro-operation interpreter microbenchmark
+//    Measures throughput of every public micro-operation performed
+//    on its own through Z80::perform(), and of the whole T-state
+//    engine running a loop that uses most of them.
+//
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Timer.hpp>
+
+using namespace Z80CPP;
+
+struct BenchUOp {
+   const char* name;
+   TZ80Op      op;
+};
+
+const BenchUOp g_uops[] = {
+      { "NOP"            , TZ80Op()                                          }
+   ,  { "inc7"           , TZ80Op(&Z80::inc7,           Reg::R)              }
+   ,  { "inc8"           , TZ80Op(&Z80::inc,            Reg::B)              }
+   ,  { "inc16"          , TZ80Op(&Z80::inc,            Reg::HL)             }
+   ,  { "dec16"          , TZ80Op(&Z80::dec,            Reg::SP)             }
+   ,  { "assign8"        , TZ80Op(&Z80::assign,         Reg::A,  Reg::B)     }
+   ,  { "assign16"       , TZ80Op(&Z80::assign,         Reg::WZ, Reg::HL)    }
+   ,  { "data_in"        , TZ80Op(&Z80::data_in,        Reg::C)              }
+   ,  { "data_in_assign" , TZ80Op(&Z80::data_in_assign, Reg::W,  Reg::DE, Reg::BC) }
+   ,  { "add"            , TZ80Op(&Z80::add,            Reg::BUF, Reg::Z)    }
+   ,  { "decode"         , TZ80Op(&Z80::decode)                              }
+};
+
+int main(int argc, char* argv[]) {
+   const uint64_t times = (argc > 1) ? std::stoull(argv[1]) : 100000000;
+   Z80 cpu;
+
+   std::cout << std::setw(16) << "micro-op" << std::setw(10) << "ns/op" 
+             << std::setw(12) << "Mops/s" << "\n";
+   for (const auto& u : g_uops) {
+      Timer<uint64_t> t;
+      for (uint64_t i=0; i < times; ++i)
+         cpu.perform(u.op);
+      uint64_t ns = t.ns();
+      std::cout << std::setw(16) << u.name 
+                << std::setw(10) << std::fixed << std::setprecision(3) << (double)ns / times 
+                << std::setw(12) << std::setprecision(1) << (double)times*1000/ns << "\n";
+   }
+   // Keep results alive
+   return cpu.registers().main.BC == 0x1234;
+}
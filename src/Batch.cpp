@@ -0,0 +1,157 @@
+#include <Batch.hpp>
+#include <Bus.hpp>
+#include <Timer.hpp>
+
+namespace Z80CPP {
+
+Batch::Batch(unsigned threads) {
+   if ( !threads ) threads = std::thread::hardware_concurrency();
+   m_nworkers = threads ? threads : 1;
+   m_workers  = std::vector<Worker>(m_nworkers);
+   for (unsigned w = 1; w < m_nworkers; ++w)
+      m_threads.emplace_back(&Batch::pool, this, w);
+}
+
+Batch::~Batch() {
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+   }
+   m_start.notify_all();
+   for (auto& t : m_threads) t.join();
+}
+
+//
+// Add a machine with a copy of mem. It returns its index
+//
+std::size_t
+Batch::add(const Memory& mem, Engine e) {
+   m_machines.push_back(Machine{ Z80(e), mem });
+   return m_machines.size() - 1;
+}
+
+//
+// Run every machine ticks more T-states (at least, with the Instruction
+// engine, which always completes its last instruction). The caller
+// thread works as worker 0 until all machines are done
+//
+Batch::Stats
+Batch::run(uint64_t ticks) {
+   const uint32_t n = m_machines.size();
+   for (unsigned w = 0; w < m_nworkers; ++w) {
+      uint32_t lo = (uint64_t)n *  w      / m_nworkers;
+      uint32_t hi = (uint64_t)n * (w + 1) / m_nworkers;
+      m_workers[w].range.store(pack(lo, hi), std::memory_order_relaxed);
+      m_workers[w].ticks = m_workers[w].steals = 0;
+   }
+
+   Timer<double> timer;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_slice   = ticks;
+      m_running = m_nworkers - 1;
+      ++m_round;
+   }
+   m_start.notify_all();
+   work(0);
+   {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_done.wait(lock, [this]{ return m_running == 0; });
+   }
+
+   Stats s;
+   s.seconds = timer.passed();
+   for (const auto& wk : m_workers) { s.ticks += wk.ticks; s.steals += wk.steals; }
+   return s;
+}
+
+//
+// Pool thread: works once per round until the Batch is destroyed
+//
+void
+Batch::pool(unsigned w) {
+   uint64_t round = 0;
+   for (;;) {
+      {
+         std::unique_lock<std::mutex> lock(m_mutex);
+         m_start.wait(lock, [&]{ return m_quit || m_round != round; });
+         if ( m_quit ) return;
+         round = m_round;
+      }
+      work(w);
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         if ( --m_running == 0 ) m_done.notify_one();
+      }
+   }
+}
+
+//
+// Run own machines, then steal from others until no machine is left
+//
+void
+Batch::work(unsigned w) {
+   Worker& wk = m_workers[w];
+   uint32_t m;
+   do {
+      while ( take(wk, m) ) {
+         Machine& mc = m_machines[m];
+         if ( mc.cpu.engine() == Engine::Instruction ) {
+            const uint64_t start = mc.cpu.ticks();
+            while ( mc.cpu.ticks() - start < m_slice ) mc.cpu.execute(mc.mem);
+            wk.ticks += mc.cpu.ticks() - start;
+         } else {
+            MemoryBus<> bus(mc.mem);
+            wk.ticks += mc.cpu.run(bus, m_slice);
+         }
+      }
+   } while ( steal(w) );
+}
+
+//
+// Take the first machine of the worker's own range
+//
+bool
+Batch::take(Worker& wk, uint32_t& m) {
+   uint64_t r = wk.range.load(std::memory_order_relaxed);
+   for (;;) {
+      uint32_t lo = r, hi = r >> 32;
+      if ( lo >= hi ) return false;
+      if ( wk.range.compare_exchange_weak(r, pack(lo + 1, hi), std::memory_order_acquire) ) {
+         m = lo;
+         return true;
+      }
+   }
+}
+
+//
+// Steal the upper half of the largest range left to other workers and
+// make it own. Ranges never grow back once taken, so a CAS on an old
+// value cannot succeed by mistake
+//
+bool
+Batch::steal(unsigned w) {
+   for (;;) {
+      unsigned victim = w;
+      uint32_t most   = 0;
+      for (unsigned v = 0; v < m_nworkers; ++v) {
+         uint64_t r = m_workers[v].range.load(std::memory_order_relaxed);
+         uint32_t lo = r, hi = r >> 32;
+         if ( v != w && hi > lo && hi - lo > most ) { most = hi - lo; victim = v; }
+      }
+      if ( victim == w ) return false;
+
+      auto&    range = m_workers[victim].range;
+      uint64_t r  = range.load(std::memory_order_relaxed);
+      uint32_t lo = r, hi = r >> 32;
+      if ( lo >= hi ) continue;
+      uint32_t mid = hi - (hi - lo + 1) / 2;
+      if ( range.compare_exchange_strong(r, pack(lo, mid), std::memory_order_acquire) ) {
+         m_workers[w].range.store(pack(mid, hi), std::memory_order_release);
+         ++m_workers[w].steals;
+         return true;
+      }
+   }
+}
+
+} // Namespace Z80CPP
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+
+namespace Z80CPP {
+
+//
+// Batch: Runs many independent machines (CPU + Memory) in-process,
+// spread over a pool of worker threads. Machines are split evenly among
+// workers, and a worker running out of machines steals half of the ones
+// left to another worker. Every machine runs on a single worker at a
+// time and never shares state with others, so no locking is needed.
+// Memories added from a common image share its banks copy-on-write.
+//
+class Batch {
+public:
+   struct alignas(64) Machine {
+      Z80    cpu;
+      Memory mem;
+   };
+   struct Stats {
+      uint64_t ticks   = 0;  // Emulated T-states (all machines)
+      double   seconds = 0;  // Wall clock time
+      uint64_t steals  = 0;  // Ranges of machines stolen by workers
+      double   mhz() const { return seconds > 0 ? ticks / seconds / 1e6 : 0; }
+   };
+
+   explicit Batch(unsigned threads = 0);  // 0 = One per hardware thread
+   ~Batch();
+   Batch(const Batch&)            = delete;
+   Batch& operator=(const Batch&) = delete;
+
+   std::size_t add(const Memory& mem, Engine e = Engine::TState);
+   Machine&    operator[](std::size_t i)       { return m_machines[i]; }
+   std::size_t size() const                    { return m_machines.size(); }
+   unsigned    threads() const                 { return m_nworkers; }
+   Stats       run(uint64_t ticks);
+
+private:
+   // Range of machines [lo, hi) left to a worker, packed in one word
+   // so that its owner and thieves can update it with a single CAS
+   struct alignas(64) Worker {
+      std::atomic<uint64_t> range { 0 };
+      uint64_t              ticks  = 0;
+      uint64_t              steals = 0;
+   };
+   static uint64_t pack(uint32_t lo, uint32_t hi) { return (uint64_t)hi << 32 | lo; }
+
+   void     pool(unsigned w);
+   void     work(unsigned w);
+   bool     take(Worker& wk, uint32_t& m);
+   bool     steal(unsigned w);
+
+   std::vector<Machine>     m_machines;
+   std::vector<Worker>      m_workers;
+   std::vector<std::thread> m_threads;       // Workers 1..N-1 (0 is the caller)
+   unsigned                 m_nworkers = 1;
+   std::mutex               m_mutex;
+   std::condition_variable  m_start, m_done;
+   uint64_t                 m_round   = 0;   // Number of run() calls
+   unsigned                 m_running = 0;   // Pool workers still busy this round
+   uint64_t                 m_slice   = 0;   // Ticks every machine runs this round
+   bool                     m_quit    = false;
+};
+
+} // Namespace Z80CPP
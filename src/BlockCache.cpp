@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <BlockCache.hpp>
+
+namespace Z80CPP {
+
+BlockCache::BlockCache()
+   : m_index(0x10000, 0)
+{}
+
+void
+BlockCache::clear() {
+   std::fill(m_index.begin(), m_index.end(), 0);
+   m_blocks.clear();
+   if ( m_jit ) m_jit->reset();
+}
+
+bool
+BlockCache::setJit(bool on) {
+   if ( !on ) { m_jit.reset(); }
+   else if ( !m_jit ) {
+      m_jit.reset(new Jit);
+      if ( !m_jit->available() ) m_jit.reset();
+   }
+   for (auto& b : m_blocks) { b.code = nullptr; b.jitted = 0; b.heat = 0; }
+   if ( m_jit ) m_jit->reset();
+   return m_jit != nullptr;
+}
+
+//
+// Run complete instructions for at least max_ticks T-states (surpassing
+// them by up to one instruction, as the Instruction engine does)
+//
+uint64_t
+BlockCache::run(Z80& cpu, Memory& mem, uint64_t max_ticks) {
+   const uint64_t start = cpu.ticks();
+   while ( cpu.ticks() - start < max_ticks ) {
+      // HALT NOPs, instructions an interrupt may be accepted before, 
+      // and the one after EI (which ends its block) run one by one
+      if ( cpu.halted() || cpu.afterEI() || cpu.interruptPending() ) { 
+         cpu.execute(mem);
+         if ( cpu.halted() ) cpu.skipIdle(mem, start + max_ticks);
+         continue; 
+      }
+
+      Block&         b   = lookup(cpu.pc(), mem);
+      const uint64_t inv = mem.invalidations();
+      uint8_t        i   = 0;
+      if ( m_jit && !b.code && ++b.heat == HOT ) compile(b, mem);
+      // Compiled code runs only when the whole of it fits in the T-states
+      // left, so it never needs to check them
+      if ( b.code && b.ticks[b.jitted - 1] < max_ticks - (cpu.ticks() - start) ) {
+         ++m_stats.jitRuns;
+         i = m_jit->run(b.code, b.ticks.data(), cpu, mem);
+         if ( mem.invalidations() != inv ) { ++m_stats.aborted; continue; }
+         if ( cpu.ticks() - start >= max_ticks ) continue;
+      }
+      for (; i < b.count; ++i) {
+         const Insn& in = b.insns[i];
+         in.run(cpu, mem, in.operands);
+         if ( in.writes && mem.invalidations() != inv ) { ++m_stats.aborted; break; }
+         if ( cpu.ticks() - start >= max_ticks ) break;
+      }
+      // A lone jump back to itself (JR $, JP $...) is an idle loop
+      if ( b.count == 1 && cpu.pc() == b.first ) cpu.skipIdle(mem, start + max_ticks);
+   }
+   return cpu.ticks() - start;
+}
+
+//
+// Valid block starting at pc, translating it when needed
+//
+BlockCache::Block&
+BlockCache::lookup(uint16_t pc, Memory& mem) {
+   ++m_stats.lookups;
+   uint32_t& idx = m_index[pc];
+   if ( !idx ) {
+      m_blocks.emplace_back();
+      idx = m_blocks.size();
+      translate(m_blocks.back(), pc, mem);
+      return m_blocks.back();
+   }
+
+   Block& b = m_blocks[idx - 1];
+   if ( mem.generation(b.first) != b.gfirst || mem.generation(b.last) != b.glast ) {
+      ++m_stats.invalidated;
+      translate(b, pc, mem);
+   } else {
+      ++m_stats.hits;
+   }
+   return b;
+}
+
+//
+// Decode the basic block at pc and watch its code pages
+//
+void
+BlockCache::translate(Block& b, uint16_t pc, Memory& mem) {
+   ++m_stats.translations;
+   uint16_t addr = pc;
+   b.count  = 0;
+   b.ticks[0] = 0;
+   b.heat   = 0;
+   b.jitted = 0;
+   b.code   = nullptr;
+   for (;;) {
+      const uint8_t       op = mem.read(addr);
+      const Z80::Decoded& d  = Z80::decoded(op);
+      Insn& in = b.insns[b.count++];
+      in.run    = d.run;
+      in.op     = op;
+      in.writes = d.writes;
+      for (uint8_t k = 0; k < d.operands; ++k)
+         in.operands[k] = mem.read(addr + 1 + k);
+      b.ticks[b.count] = b.ticks[b.count - 1] + d.ticks;
+      addr += 1 + d.operands;
+      if ( d.ends || b.count == MAX_INSNS ) break;
+   }
+   b.first  = pc;
+   b.last   = addr - 1;
+   b.gfirst = mem.watch(b.first);
+   b.glast  = mem.watch(b.last);
+}
+
+//
+// Compile block b with the Jit. When its buffer is full, everything 
+// compiled so far is dropped and compiling starts over
+//
+void
+BlockCache::compile(Block& b, const Memory& mem) {
+   std::array<Jit::Insn, MAX_INSNS> insns;
+   for (uint8_t i = 0; i < b.count; ++i)
+      insns[i] = { b.insns[i].op, { b.insns[i].operands[0], b.insns[i].operands[1] } };
+
+   for (int attempt = 0; attempt < 2; ++attempt) {
+      uint8_t n = b.count;
+      b.code    = m_jit->compile(b.first, insns.data(), n, mem);
+      b.jitted  = n;
+      if ( b.code || !n ) break;
+      for (auto& o : m_blocks) { o.code = nullptr; o.jitted = 0; o.heat = 0; }
+      m_jit->reset();
+   }
+   if ( b.code ) ++m_stats.compiled;
+}
+
+} // Namespace Z80CPP
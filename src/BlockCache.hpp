@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <Jit.hpp>
+
+namespace Z80CPP {
+
+//
+// BlockCache: Translation cache for the Instruction engine. Straight-line
+// basic blocks (up to a jump, a HALT or MAX_INSNS instructions) are
+// decoded once into threaded code: the handler of every opcode plus its
+// operand bytes. Later visits to the same PC run the handlers directly,
+// without fetching and decoding again. Results are identical to calling
+// Z80::execute() for every instruction.
+//
+// Translated code pages are watched in Memory (see Memory::watch). A
+// block is valid while the generations of the code pages it spans do
+// not change. A block writing to watched code ends right after that
+// instruction, so self-modifying code takes effect immediately, even
+// when written through another page mapping the same RAM bank.
+// A BlockCache serves a single Memory.
+//
+// With the Jit on (setJit), blocks run HOT times are also compiled to
+// host code, used whenever the whole block fits in the T-states left.
+//
+class BlockCache {
+public:
+   static constexpr uint8_t  MAX_INSNS = 16;
+   static constexpr uint32_t HOT       = 16;   // Runs before compiling a block
+
+   struct Stats {
+      uint64_t lookups      = 0;  // Blocks started
+      uint64_t hits         = 0;  // Blocks found already translated and valid
+      uint64_t translations = 0;  // Blocks decoded (first time or invalidated)
+      uint64_t invalidated  = 0;  // Blocks found stale and decoded again
+      uint64_t aborted      = 0;  // Blocks ended early by writes to watched code
+      uint64_t compiled     = 0;  // Blocks compiled by the Jit
+      uint64_t jitRuns      = 0;  // Blocks run as compiled code
+      double   hitRate() const    { return lookups ? (double)hits / lookups : 0; }
+   };
+
+   BlockCache();
+   uint64_t     run(Z80& cpu, Memory& mem, uint64_t max_ticks);
+   const Stats& stats() const     { return m_stats; }
+   std::size_t  blocks() const    { return m_blocks.size(); }
+   void         clear();
+   bool         setJit(bool on);  // Returns whether the Jit is available
+
+private:
+   struct Insn {
+      Z80::Threaded run;
+      uint8_t       op;
+      uint8_t       operands[2];
+      bool          writes;
+   };
+   struct Block {
+      uint16_t                        first, last;   // Addresses of first and last bytes
+      uint32_t                        gfirst, glast; // Generations of their code pages
+      uint8_t                         count;         // Instructions
+      std::array<Insn, MAX_INSNS>     insns;
+      std::array<uint16_t, MAX_INSNS + 1> ticks;     // T-states of the first i instructions
+      uint32_t                        heat;          // Runs since translated
+      uint8_t                         jitted;        // Instructions compiled (0 = none)
+      Jit::Fn                         code;
+   };
+
+   Block&       lookup(uint16_t pc, Memory& mem);
+   void         translate(Block& b, uint16_t pc, Memory& mem);
+   void         compile(Block& b, const Memory& mem);
+
+   std::vector<uint32_t> m_index;   // Block of every PC (+1, 0 = none)
+   std::vector<Block>    m_blocks;
+   Stats                 m_stats;
+   std::unique_ptr<Jit>  m_jit;     // nullptr: Jit off
+};
+
+} // Namespace Z80CPP
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <Memory.hpp>
+#include <IOPorts.hpp>
+
+namespace Z80CPP {
+
+//
+// Bus policies: What a Z80 is connected to, as seen by Z80::tick(BUS&).
+// A Bus is any type providing these hooks (all of them get inlined 
+// into the T-state loop):
+//    uint32_t waitStates(uint64_t tick, uint16_t addr)
+//                                              Wait states inserted when
+//                                              WAIT is sampled (WSAMP)
+//    static constexpr uint64_t WAIT_PERIOD     waitStates() repeats every
+//                                              WAIT_PERIOD ticks
+//    void read (uint16_t addr, uint8_t& data)  MREQ+RD: Drive data bus
+//    void write(uint16_t addr, uint8_t  data)  MREQ+WR: Latch data bus
+//    void in   (uint16_t port, uint8_t& data)  IORQ+RD: Drive data bus
+//    void out  (uint16_t port, uint8_t  data)  IORQ+WR: Latch data bus
+//                                              (once per IO cycle, when
+//                                              WAIT is released)
+//    void ack  (uint8_t& data)                 M1+IORQ: Interrupt 
+//                                              acknowledge, drive data
+//                                              bus (IM 0 opcode, IM 2
+//                                              vector)
+//
+
+//
+// PinBus: Nothing connected. The outside world drives the Z80 through
+// its pins (setSignal(), setData()) reading signals(), address() and 
+// data() after every tick. This is what Z80::tick() uses.
+//
+struct PinBus {
+   static constexpr uint64_t WAIT_PERIOD = 1;
+
+   uint32_t waitStates(uint64_t, uint16_t) const { return 0; }
+   void     read (uint16_t, uint8_t&)      const {}
+   void     write(uint16_t, uint8_t)       const {}
+   void     in   (uint16_t, uint8_t&)      const {}
+   void     out  (uint16_t, uint8_t)       const {}
+   void     ack  (uint8_t&)                const {}
+};
+
+//
+// Contention models: Number of wait states for an access whose WAIT
+// sample (T2) happens at a given tick, computed in O(1). They return
+// the distance to the next tick where the access may go on, so that
+// asking again once those ticks have passed returns 0. They repeat 
+// every PERIOD ticks.
+//   NoContention:  Accesses are never delayed
+//   CPCContention: Amstrad CPC's Gate-Array WAIT cycle (3-1). WAIT is 
+//                  released one tick out of every 4 (ticks 1, 5, 9...), 
+//                  stretching every access to a 4 T-state boundary
+//   ULAContention: ZX Spectrum 48K ULA. Accesses to 0x4000-0x7FFF whose
+//                  T1 falls within the 128 screen fetching T-states of 
+//                  one of the 192 display lines get 6,5,4,3,2,1,0,0 
+//                  delays (69888 T-state frames, first at 14335)
+//
+struct NoContention {
+   static constexpr uint64_t PERIOD = 1;
+   uint32_t operator()(uint64_t, uint16_t)    const { return 0; }
+};
+struct CPCContention {
+   static constexpr uint64_t PERIOD = 4;
+   uint32_t operator()(uint64_t tick, uint16_t) const { return (1 - tick) & 3; }
+};
+struct ULAContention {
+   static constexpr uint32_t FRAME  = 69888;  // T-states per frame
+   static constexpr uint32_t FIRST  = 14335;  // First contended T-state
+   static constexpr uint32_t LINE   = 224;    // T-states per line
+   static constexpr uint32_t LINES  = 192;    // Display lines
+   static constexpr uint32_t SCREEN = 128;    // Contended T-states per line
+   static constexpr uint8_t  delay[8] = { 6, 5, 4, 3, 2, 1, 0, 0 };
+   static constexpr uint64_t PERIOD = FRAME;
+
+   uint32_t operator()(uint64_t tick, uint16_t addr) const {
+      if ( (addr & 0xC000) != 0x4000 ) return 0;
+      uint32_t t = (tick + FRAME - 1) % FRAME; // T1 of the access
+      if ( t < FIRST ) return 0;
+      t -= FIRST;
+      if ( t >= LINE * LINES || t % LINE >= SCREEN ) return 0;
+      return delay[t & 7];
+   }
+};
+
+//
+// MemoryBus: Memory connected to MREQ accesses, wait states given by a 
+// contention model and IO ports (if any) to IORQ accesses. The data bus
+// is pulled up, as on the CPC: ports with no device read FFh and so
+// does the interrupt acknowledge
+//
+template <class CONTENTION = NoContention>
+struct MemoryBus {
+   static constexpr uint64_t WAIT_PERIOD = CONTENTION::PERIOD;
+
+   explicit MemoryBus(Memory& mem, IOPorts* ports = nullptr) : m_mem(mem), m_ports(ports) {}
+
+   uint32_t waitStates(uint64_t tick, uint16_t addr) { return m_contention(tick, addr); }
+   void     read (uint16_t addr, uint8_t& data)      { data = m_mem.read(addr); }
+   void     write(uint16_t addr, uint8_t  data)      { m_mem.write(addr, data); }
+   void     in   (uint16_t port, uint8_t& data)      { data = m_ports ? m_ports->in(port) : 0xFF; }
+   void     out  (uint16_t port, uint8_t  data)      { if ( m_ports ) m_ports->out(port, data); }
+   void     ack  (uint8_t& data)                     { data = 0xFF; }
+
+   Memory&  memory()                                 { return m_mem; }
+   IOPorts* ports()                                  { return m_ports; }
+private:
+   Memory&    m_mem;          // Memory connected to the bus
+   IOPorts*   m_ports;        // IO devices (nullptr: none)
+   CONTENTION m_contention;   // Contention model giving wait states
+};
+
+} // Namespace Z80CPP
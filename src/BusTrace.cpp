@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <BusTrace.hpp>
+#include <MappedFile.hpp>
+
+namespace Z80CPP {
+
+static const char MAGIC[8] = { 'Z', '8', '0', 'C', 'P', 'P', 'B', 'T' };
+
+static void
+put(std::vector<uint8_t>& out, uint64_t v, unsigned bytes) {
+   for (unsigned i = 0; i < bytes; ++i) out.push_back(v >> (8 * i));
+}
+
+static uint64_t
+get(const uint8_t* p, unsigned bytes) {
+   uint64_t v = 0;
+   for (unsigned i = 0; i < bytes; ++i) v |= (uint64_t)p[i] << (8 * i);
+   return v;
+}
+
+// LEB128: 7 bits per byte, lowest first, top bit set but in the last one
+static uint8_t*
+putVarint(uint8_t* p, uint64_t v) {
+   while ( v >= 0x80 ) { *p++ = v | 0x80; v >>= 7; }
+   *p++ = v;
+   return p;
+}
+
+static uint64_t
+getVarint(const uint8_t*& p, const uint8_t* end) {
+   uint64_t v = 0;
+   for (unsigned shift = 0; shift < 64; shift += 7) {
+      if ( p == end ) break;
+      const uint8_t b = *p++;
+      v |= (uint64_t)(b & 0x7F) << shift;
+      if ( !(b & 0x80) ) return v;
+   }
+   throw std::runtime_error("BusTrace: Corrupt record");
+}
+
+BusTrace::BusTrace(const std::string& file, std::size_t capacity)
+   : m_out(file, std::ios::binary | std::ios::trunc) {
+   if ( !m_out ) throw std::runtime_error("BusTrace: Could not create " + file);
+   std::size_t size = 1;
+   while ( size < capacity ) size <<= 1;
+   m_ring.resize(size);
+   m_mask = size - 1;
+
+   std::vector<uint8_t> header(MAGIC, MAGIC + sizeof(MAGIC));
+   put(header, VERSION, 4);
+   put(header, CHUNK, 4);
+   m_out.write(reinterpret_cast<const char*>(header.data()), header.size());
+   m_bytes  = header.size();
+   m_writer = std::thread(&BusTrace::writer, this);
+}
+
+BusTrace::~BusTrace() {
+   try { close(); } catch (const std::exception&) {}
+}
+
+//
+// Hand every record to the writer, wait for it to finish and close the
+// file. Throws if it could not be written
+//
+void
+BusTrace::close() {
+   if ( !m_writer.joinable() ) return;
+   publish();
+   m_closing.store(true, std::memory_order_release);
+   m_writer.join();
+   m_out.close();
+   if ( m_out.fail() ) throw std::runtime_error("BusTrace: Error writing the trace file");
+}
+
+//
+// Wait for the writer to make room in the ring
+//
+void
+BusTrace::wait() {
+   publish();
+   bool stalled = false;
+   for (;;) {
+      m_free = m_ring.size() - (m_head - m_tail.load(std::memory_order_acquire));
+      if ( m_free ) return;
+      if ( !stalled ) { ++m_stalls; stalled = true; }
+      std::this_thread::yield();
+   }
+}
+
+//
+// Writer thread: Takes published records, skips those where no pin
+// changed, and encodes the rest into chunks, written as they fill up
+//
+void
+BusTrace::writer() {
+   static constexpr std::size_t MAX_RECORD = 1 + 10 + 2 + 3 + 1;   // Bytes of an encoded record, at most
+   std::vector<uint8_t> chunk(CHUNK_HEADER + CHUNK * MAX_RECORD);
+   uint8_t* const payload = chunk.data() + CHUNK_HEADER;
+   uint8_t* p       = payload;   // End of the current chunk
+   uint32_t records = 0;         // Records in the current chunk
+   uint64_t first = 0, seen = 0; // First tick of the chunk, last tick taken
+   Record   prev {};             // Previous record in the chunk
+   bool     any = false;         // Any record taken
+
+   auto flush = [&]() {
+      std::vector<uint8_t> header;
+      put(header, p - payload, 4);
+      put(header, records, 4);
+      put(header, first, 8);
+      put(header, seen, 8);
+      std::copy(header.begin(), header.end(), chunk.begin());
+      m_out.write(reinterpret_cast<const char*>(chunk.data()), p - chunk.data());
+      m_bytes += p - chunk.data();
+      p       = payload;
+      records = 0;
+      prev    = Record{};
+   };
+   auto encode = [&](const Record& r) {
+      if ( any && r.signals == prev.signals && r.address == prev.address && r.data == prev.data ) {
+         seen = r.tick;
+         return;
+      }
+      if ( records == CHUNK ) flush();
+      if ( !records ) first = r.tick;
+      uint8_t& flags = *p++;
+      flags = 0;
+      if ( r.tick - prev.tick != 1 ) { flags |= TICK; p = putVarint(p, r.tick - prev.tick); }
+      if ( r.signals != prev.signals ) { flags |= SIG; p[0] = r.signals; p[1] = r.signals >> 8; p += 2; }
+      if ( r.address != prev.address ) {
+         const int16_t d = r.address - prev.address;
+         flags |= ADDR;
+         p = putVarint(p, (uint16_t)(d * 2) ^ (uint16_t)(d >> 15));
+      }
+      if ( r.data != prev.data ) { flags |= DATA; *p++ = r.data; }
+      prev = r;
+      seen = r.tick;
+      any  = true;
+      ++records;
+   };
+
+   uint64_t tail = 0;
+   for (;;) {
+      const bool     closing = m_closing.load(std::memory_order_acquire);
+      const uint64_t head    = m_published.load(std::memory_order_acquire);
+      if ( tail == head ) {
+         if ( closing ) break;
+         std::this_thread::sleep_for(std::chrono::microseconds(100));
+         continue;
+      }
+      while ( tail != head ) {
+         const uint64_t batch = std::min<uint64_t>(head, (tail | (CHUNK - 1)) + 1);
+         for (; tail != batch; ++tail) encode(m_ring[tail & m_mask]);
+         m_tail.store(tail, std::memory_order_release);
+      }
+   }
+   if ( records ) flush();
+}
+
+BusTrace::Reader::Reader(const std::string& file) : m_file(new MappedFile(file)) {
+   const MappedFile& f = *m_file;
+   if ( f.size() < HEADER || std::memcmp(f.data(), MAGIC, sizeof(MAGIC)) )
+      throw std::runtime_error("BusTrace: Not a trace file: " + file);
+   if ( get(f.data() + 8, 4) != VERSION )
+      throw std::runtime_error("BusTrace: Unsupported version " + std::to_string(get(f.data() + 8, 4)));
+   seek(HEADER);
+}
+
+BusTrace::Reader::~Reader() = default;
+
+//
+// Chunk after chunk, checking it is all there
+//
+const uint8_t*
+BusTrace::Reader::skip(const uint8_t* chunk) const {
+   const MappedFile& f = *m_file;
+   if ( f.end() - chunk < CHUNK_HEADER || (std::size_t)(f.end() - chunk - CHUNK_HEADER) < get(chunk, 4) )
+      throw std::runtime_error("BusTrace: Truncated trace file");
+   return chunk + CHUNK_HEADER + get(chunk, 4);
+}
+
+//
+// Last tick traced (walks every chunk header)
+//
+uint64_t
+BusTrace::Reader::end() const {
+   uint64_t end = 0;
+   for (const uint8_t* c = m_file->begin() + HEADER; c != m_file->end(); c = skip(c))
+      end = get(c + 16, 8);
+   return end;
+}
+
+//
+// Offset of the chunk holding the byte at offset (HEADER when it is in
+// the file header, the file size when past the end)
+//
+std::size_t
+BusTrace::Reader::chunkOf(std::size_t offset) const {
+   const uint8_t* const start = m_file->begin();
+   const uint8_t*       c     = start + HEADER;
+   if ( offset < HEADER ) return HEADER;
+   while ( c != m_file->end() ) {
+      const uint8_t* next = skip(c);
+      if ( offset < (std::size_t)(next - start) ) break;
+      c = next;
+   }
+   return c - start;
+}
+
+//
+// Read from the chunk at offset chunk on
+//
+void
+BusTrace::Reader::seek(std::size_t chunk) {
+   m_p = m_chend = m_next = m_file->begin() + std::min(chunk, m_file->size());
+}
+
+//
+// Go to the next chunk (false when there is none)
+//
+bool
+BusTrace::Reader::chunk() {
+   if ( m_next == m_file->end() ) return false;
+   m_p     = m_next + CHUNK_HEADER;
+   m_next  = skip(m_next);
+   m_chend = m_next;
+   m_prev  = Record{};
+   return true;
+}
+
+bool
+BusTrace::Reader::next(Record& r) {
+   while ( m_p == m_chend )
+      if ( !chunk() ) return false;
+
+   const uint8_t flags = *m_p++;
+   r = m_prev;
+   r.tick += ( flags & TICK ) ? getVarint(m_p, m_chend) : 1;
+   if ( flags & SIG ) {
+      if ( m_chend - m_p < 2 ) throw std::runtime_error("BusTrace: Corrupt record");
+      r.signals = get(m_p, 2);
+      m_p      += 2;
+   }
+   if ( flags & ADDR ) {
+      const uint16_t z = getVarint(m_p, m_chend);
+      r.address += (z >> 1) ^ -(z & 1);
+   }
+   if ( flags & DATA ) {
+      if ( m_p == m_chend ) throw std::runtime_error("BusTrace: Corrupt record");
+      r.data = *m_p++;
+   }
+   m_prev = r;
+   return true;
+}
+
+} // Namespace Z80CPP
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Z80.hpp>
+
+namespace Z80CPP {
+
+class MappedFile;
+
+//
+// BusTrace: Pin-level history of a Z80 (signals(), address() and data()
+// after every T-state), streamed into a file. record() appends a
+// fixed-size record to a single-producer single-consumer ring, and a
+// background thread drains it, compressing records into the file, so
+// the emulation thread never waits for IO. It only waits when the ring
+// is full (counted by stalls()). record() must always be called from
+// the same thread.
+//   The file holds only the records where a pin changed: pins hold
+// their values up to the next record. Records are delta encoded, in
+// chunks of up to CHUNK records that decode on their own:
+//    Header: "Z80CPPBT", version (uint32), CHUNK (uint32)
+//    Chunk:  payload bytes (uint32), records (uint32), first and last
+//            tick covered (uint64 each), payload
+//    Record: flags byte, then the fields it has (previous record as
+//            zeros at the start of every chunk):
+//               TICK: tick - previous (varint), when not 1
+//               SIG:  signals (2 bytes)
+//               ADDR: address - previous (zigzag varint)
+//               DATA: data (1 byte)
+// Integers are little endian. Chunks split at the same records in every
+// file, so equal traces are equal byte for byte. Reader streams them
+// back from the mapped file. Errors throw std::runtime_error
+//
+class BusTrace {
+public:
+   struct Record {
+      uint64_t tick;
+      uint16_t signals;
+      uint16_t address;
+      uint8_t  data;
+      bool operator==(const Record& r) const {
+         return signals == r.signals && address == r.address && data == r.data && tick == r.tick;
+      }
+      bool operator!=(const Record& r) const { return !(*this == r); }
+   };
+   enum Flags : uint8_t { TICK = 0x01, SIG = 0x02, ADDR = 0x04, DATA = 0x08 };
+   static constexpr uint32_t VERSION = 1;
+   static constexpr uint32_t CHUNK   = 4096;      // Records per chunk
+   static constexpr uint32_t HEADER  = 16;        // Bytes of the file header
+   static constexpr uint32_t CHUNK_HEADER = 24;   // Bytes of a chunk header
+
+   explicit BusTrace(const std::string& file, std::size_t capacity = 1 << 20);
+   ~BusTrace();
+   BusTrace(const BusTrace&)            = delete;
+   BusTrace& operator=(const BusTrace&) = delete;
+
+   void     record(const Z80& cpu);
+   template <class BUS>
+   uint64_t run(Z80& cpu, BUS& bus, uint64_t ticks);
+   void     close();
+
+   uint64_t records() const             { return m_head; }    // Recorded so far
+   uint64_t stalls() const              { return m_stalls; }  // Records that waited for room
+   uint64_t bytes() const               { return m_bytes; }   // File size (after close)
+
+   class Reader;
+
+private:
+   static constexpr uint64_t PUBLISH = 256;   // Records handed to the writer at once
+
+   void     publish()                   { m_published.store(m_head, std::memory_order_release); }
+   void     wait();
+   void     writer();
+
+   std::vector<Record>   m_ring;               // Records not written yet
+   uint64_t              m_mask;               // Ring size - 1
+   uint64_t              m_head   = 0;         // Records recorded (producer)
+   uint64_t              m_free   = 0;         // Records that fit until the writer must be checked
+   uint64_t              m_stalls = 0;
+   uint64_t              m_bytes  = 0;
+   std::ofstream         m_out;
+   std::thread           m_writer;
+   alignas(64) std::atomic<uint64_t> m_published { 0 };  // Records the writer may take
+   alignas(64) std::atomic<uint64_t> m_tail      { 0 };  // Records taken by the writer
+   std::atomic<bool>     m_closing { false };
+};
+
+//
+// Reader: Records of a trace file, in order. next() returns false after
+// the last one; end() is the last tick traced. Reading may also start
+// at any chunk (seek), given the offset in the file where it starts
+//
+class BusTrace::Reader {
+public:
+   explicit Reader(const std::string& file);
+   ~Reader();
+
+   bool              next(Record& r);
+   uint64_t          end() const;
+   std::size_t       chunkOf(std::size_t offset) const;
+   void              seek(std::size_t chunk);
+   const MappedFile& file() const       { return *m_file; }
+
+private:
+   bool     chunk();
+   const uint8_t* skip(const uint8_t* chunk) const;
+
+   std::unique_ptr<MappedFile> m_file;
+   const uint8_t* m_p     = nullptr;   // Next record
+   const uint8_t* m_chend = nullptr;   // End of the current chunk
+   const uint8_t* m_next  = nullptr;   // Next chunk
+   Record         m_prev  {};
+};
+
+//
+// Record the pins of cpu, after its last T-state
+//
+inline void
+BusTrace::record(const Z80& cpu) {
+   if ( !m_free ) wait();
+   Record& r = m_ring[m_head & m_mask];
+   r.tick    = cpu.ticks();
+   r.signals = cpu.signals();
+   r.address = cpu.address();
+   r.data    = cpu.data();
+   --m_free;
+   if ( !(++m_head & (PUBLISH - 1)) ) publish();
+}
+
+//
+// Run ticks T-states one by one (no idle fast-forward, wait states
+// held tick by tick), recording every one of them. Returns ticks run
+//
+template <class BUS>
+inline uint64_t
+BusTrace::run(Z80& cpu, BUS& bus, uint64_t ticks) {
+   const uint64_t start = cpu.ticks();
+   while ( cpu.ticks() - start < ticks ) {
+      cpu.tick(bus);
+      record(cpu);
+   }
+   publish();
+   return cpu.ticks() - start;
+}
+
+} // Namespace Z80CPP
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Z80CPP {
+
+//
+// Bits of the F register (X3/X5: undocumented copies of result bits)
+//
+namespace Flag {
+   constexpr uint8_t C  = 0x01;  // Carry
+   constexpr uint8_t N  = 0x02;  // Add/Subtract
+   constexpr uint8_t PV = 0x04;  // Parity/Overflow
+   constexpr uint8_t X3 = 0x08;
+   constexpr uint8_t H  = 0x10;  // Half carry
+   constexpr uint8_t X5 = 0x20;
+   constexpr uint8_t Z  = 0x40;  // Zero
+   constexpr uint8_t S  = 0x80;  // Sign
+}
+
+//
+// ALU: 8-bit operations setting all flags. ADD to CP are in opcode order
+// (bits 5-3 of 0x80-0xBF and 0xC6-0xFE). SHIFT stands for the rotations
+// and shifts of CB opcodes. NONE means F is up to date
+//
+enum class ALU : uint8_t { ADD, ADC, SUB, SBC, AND, XOR, OR, CP, INC, DEC, SHIFT, NONE };
+
+//
+// FlagTables: S, Z, 5 and 3 of every 8-bit result (sz53), plus its
+// parity in PV (sz53p). H and V of additions and subtractions come from
+// bits 3 and 7 of both operands and the result, packed into an index
+// (0-7: bits 3, 8-15: bits 7 >> 4)
+//
+struct FlagTables {
+   std::array<uint8_t, 256> sz53  {};
+   std::array<uint8_t, 256> sz53p {};
+   uint8_t hAdd[8] = { 0, Flag::H, Flag::H, Flag::H, 0, 0, 0, Flag::H };
+   uint8_t hSub[8] = { 0, 0, Flag::H, 0, Flag::H, 0, Flag::H, Flag::H };
+   uint8_t vAdd[8] = { 0, 0, 0, Flag::PV, Flag::PV, 0, 0, 0 };
+   uint8_t vSub[8] = { 0, Flag::PV, 0, 0, 0, 0, Flag::PV, 0 };
+
+   constexpr FlagTables() {
+      for (unsigned v = 0; v < 256; ++v) {
+         uint8_t p = 1;
+         for (unsigned b = v; b; b >>= 1) p ^= b & 1;
+         sz53[v]  = (v & (Flag::S | Flag::X5 | Flag::X3)) | (v ? 0 : Flag::Z);
+         sz53p[v] = sz53[v] | (p ? Flag::PV : 0);
+      }
+   }
+};
+inline constexpr FlagTables g_flagtables;
+
+//
+// LazyFlags: Last flag-setting ALU operation, its operands and its
+// result. It is kept instead of F, which is computed from it (flags())
+// only when read: most flags are overwritten before anyone reads them.
+// Carry is cheap to get on its own, for ADC/SBC/INC/DEC to go on lazily
+//
+struct LazyFlags {
+   ALU      op  = ALU::NONE;
+   uint8_t  a   = 0;          // First operand (INC/DEC: value before)
+   uint8_t  b   = 0;          // Second operand
+   uint8_t  c   = 0;          // INC/DEC: carry kept from before
+   uint16_t res = 0;          // Result, with carry or borrow in bit 8
+
+   // Operation a op b (with carry in cin for ADC/SBC)
+   static constexpr LazyFlags of(ALU op, uint8_t a, uint8_t b, uint8_t cin = 0) {
+      uint16_t r = 0;
+      switch( op ) {
+         case ALU::ADD: r = a + b;        break;
+         case ALU::ADC: r = a + b + cin;  break;
+         case ALU::SUB:
+         case ALU::CP:  r = a - b;        break;
+         case ALU::SBC: r = a - b - cin;  break;
+         case ALU::AND: r = a & b;        break;
+         case ALU::XOR: r = a ^ b;        break;
+         case ALU::OR:  r = a | b;        break;
+         case ALU::INC: r = uint8_t(a + 1); break;
+         case ALU::DEC: r = uint8_t(a - 1); break;
+         case ALU::SHIFT:
+         case ALU::NONE:                  break;
+      }
+      return { op, a, b, cin, r };
+   }
+
+   // Rotation or shift y of CB opcodes (RLC, RRC, RL, RR, SLA, SRA, SLL,
+   // SRL) of a, with carry in cin for RL/RR
+   static constexpr LazyFlags shift(uint8_t y, uint8_t a, uint8_t cin) {
+      uint16_t r = 0;
+      switch( y & 7 ) {
+         case 0: r = a << 1 | a >> 7;                          break;
+         case 1: r = uint8_t(a >> 1 | a << 7) | (a & 1) << 8;  break;
+         case 2: r = a << 1 | cin;                             break;
+         case 3: r = a >> 1 | cin << 7 | (a & 1) << 8;         break;
+         case 4: r = a << 1;                                   break;
+         case 5: r = a >> 1 | (a & 0x80) | (a & 1) << 8;       break;
+         case 6: r = a << 1 | 1;                               break;
+         case 7: r = a >> 1 | (a & 1) << 8;                    break;
+      }
+      return { ALU::SHIFT, a, 0, cin, r };
+   }
+
+   // Value of A after the operation (CP leaves it unchanged)
+   constexpr uint8_t result() const { return op == ALU::CP ? a : uint8_t(res); }
+
+   // Carry flag, f being F as last computed
+   constexpr uint8_t carry(uint8_t f) const {
+      switch( op ) {
+         case ALU::AND: case ALU::XOR: case ALU::OR:  return 0;
+         case ALU::INC: case ALU::DEC:                return c;
+         case ALU::NONE:                              return f & Flag::C;
+         default:                                     return (res >> 8) & Flag::C;
+      }
+   }
+
+   // F after the operation, f being F as last computed
+   constexpr uint8_t flags(uint8_t f) const {
+      const FlagTables& t  = g_flagtables;
+      const uint8_t     r  = res;
+      const uint8_t     hv = ((a & 0x88) >> 3) | ((b & 0x88) >> 2) | ((r & 0x88) >> 1);
+      switch( op ) {
+         case ALU::ADD: case ALU::ADC:
+            return carry(f) | t.hAdd[hv & 7] | t.vAdd[hv >> 4] | t.sz53[r];
+         case ALU::SUB: case ALU::SBC:
+            return carry(f) | Flag::N | t.hSub[hv & 7] | t.vSub[hv >> 4] | t.sz53[r];
+         case ALU::CP:
+            // 5 and 3 come from the operand, not the result
+            return carry(f) | Flag::N | t.hSub[hv & 7] | t.vSub[hv >> 4]
+                 | (t.sz53[r] & (Flag::S | Flag::Z)) | (b & (Flag::X5 | Flag::X3));
+         case ALU::AND:
+            return Flag::H | t.sz53p[r];
+         case ALU::XOR: case ALU::OR:
+            return t.sz53p[r];
+         case ALU::SHIFT:
+            return carry(f) | t.sz53p[r];
+         case ALU::INC:
+            return c | t.sz53[r] | ((r & 0x0F) ? 0 : Flag::H) | (r == 0x80 ? Flag::PV : 0);
+         case ALU::DEC:
+            return c | Flag::N | t.sz53[r] | ((a & 0x0F) ? 0 : Flag::H) | (r == 0x7F ? Flag::PV : 0);
+         case ALU::NONE:
+            break;
+      }
+      return f;
+   }
+};
+
+//
+// Accumulator operations reading flags (RLCA, RRCA, RLA, RRA, DAA, CPL,
+// SCF, CCF). They take and return AF, with F up to date
+//
+namespace AccOps {
+   constexpr uint8_t KEEP = Flag::S | Flag::Z | Flag::PV;   // Flags not changed by most of them
+
+   constexpr uint16_t make(uint8_t a, uint8_t f) { return uint16_t(a << 8 | f); }
+
+   constexpr uint16_t rlca(uint16_t af) {
+      const uint8_t a = af >> 8, f = af;
+      const uint8_t r = a << 1 | a >> 7;
+      return make(r, (f & KEEP) | (r & (Flag::X5 | Flag::X3 | Flag::C)));
+   }
+   constexpr uint16_t rrca(uint16_t af) {
+      const uint8_t a = af >> 8, f = af;
+      const uint8_t r = a >> 1 | a << 7;
+      return make(r, (f & KEEP) | (r & (Flag::X5 | Flag::X3)) | (a & Flag::C));
+   }
+   constexpr uint16_t rla(uint16_t af) {
+      const uint8_t a = af >> 8, f = af;
+      const uint8_t r = a << 1 | (f & Flag::C);
+      return make(r, (f & KEEP) | (r & (Flag::X5 | Flag::X3)) | a >> 7);
+   }
+   constexpr uint16_t rra(uint16_t af) {
+      const uint8_t a = af >> 8, f = af;
+      const uint8_t r = a >> 1 | f << 7;
+      return make(r, (f & KEEP) | (r & (Flag::X5 | Flag::X3)) | (a & Flag::C));
+   }
+   constexpr uint16_t daa(uint16_t af) {
+      const uint8_t a = af >> 8, f = af;
+      uint8_t adjust = 0, carry = f & Flag::C;
+      if ( (f & Flag::H) || (a & 0x0F) > 9 ) adjust  = 0x06;
+      if ( carry || a > 0x99 )               adjust |= 0x60;
+      if ( a > 0x99 )                        carry   = Flag::C;
+      const LazyFlags l = LazyFlags::of((f & Flag::N) ? ALU::SUB : ALU::ADD, a, adjust);
+      const uint8_t   r = l.result();
+      return make(r, (l.flags(f) & ~(Flag::C | Flag::PV)) | carry | (g_flagtables.sz53p[r] & Flag::PV));
+   }
+   constexpr uint16_t cpl(uint16_t af) {
+      const uint8_t r = ~(af >> 8), f = af;
+      return make(r, (f & (KEEP | Flag::C)) | (r & (Flag::X5 | Flag::X3)) | Flag::H | Flag::N);
+   }
+   constexpr uint16_t scf(uint16_t af) {
+      const uint8_t a = af >> 8, f = af;
+      return make(a, (f & KEEP) | (a & (Flag::X5 | Flag::X3)) | Flag::C);
+   }
+   constexpr uint16_t ccf(uint16_t af) {
+      const uint8_t a = af >> 8, f = af;
+      return make(a, (f & KEEP) | (a & (Flag::X5 | Flag::X3)) | ((f & Flag::C) ? Flag::H : Flag::C));
+   }
+}
+
+} // Namespace Z80CPP
@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <stdexcept>
+#include <IOPorts.hpp>
+
+namespace Z80CPP {
+
+//
+// Attach a device decoding ports (port & mask) == value, and add it to
+// the table of every port selecting it. Returns its number (its bit in
+// selected()). Throws when there are already MAX_DEVICES
+//
+std::size_t
+IOPorts::attach(uint16_t mask, uint16_t value, In in, Out out) {
+   if ( m_devices.size() == MAX_DEVICES )
+      throw std::length_error("IOPorts: Too many devices attached");
+
+   const std::size_t n   = m_devices.size();
+   const uint8_t     bit = 1 << n;
+   m_devices.push_back(Device{ mask, uint16_t(value & mask), std::move(in), std::move(out) });
+
+   // Ports selecting it: all values of the bits not decoded, with the
+   // decoded ones fixed (enumerating submasks of ~mask)
+   const uint16_t free = ~mask;
+   uint16_t       rest = 0;
+   do {
+      m_select[(value & mask) | rest] |= bit;
+      rest = (rest - free) & free;
+   } while ( rest );
+   return n;
+}
+
+//
+// Detach all devices (every port reads FFh)
+//
+void
+IOPorts::clear() {
+   m_devices.clear();
+   std::fill(m_select.begin(), m_select.end(), 0);
+}
+
+} // Namespace Z80CPP
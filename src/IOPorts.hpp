@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Z80CPP {
+
+//
+// IOPorts: IO devices connected to the Z80, selected by partial decoding
+// of the port address (IORQ cycles put BC, or A:n, on the address bus).
+// Every device decodes the bits in mask, and is selected by ports whose
+// bits equal value there:
+//    CPC Gate Array (&7Fxx):       mask 0xC000, value 0x4000 (A15=0, A14=1)
+//    CPC CRTC (&BCxx-&BFxx):       mask 0x4000, value 0x0000 (A14=0, A9-A8
+//                                  select its function)
+//    CPC PPI (&F4xx-&F7xx):        mask 0x0800, value 0x0000 (A11=0)
+//    ZX Spectrum ULA (even ports): mask 0x0001, value 0x0000 (A0=0)
+// Attaching a device compiles all of them into a 64K table with the set
+// of devices selected by every port, so an access costs one indexed
+// load. As on real partial decoding, a port may select several devices:
+// all of them get writes, and reads get their values ANDed. Ports
+// selecting none read FFh (the data bus is pulled up).
+//
+class IOPorts {
+public:
+   using In  = std::function<uint8_t(uint16_t port)>;
+   using Out = std::function<void(uint16_t port, uint8_t data)>;
+   static constexpr std::size_t MAX_DEVICES = 8;
+
+   IOPorts() : m_select(0x10000, 0) {}
+
+   std::size_t attach(uint16_t mask, uint16_t value, In in, Out out = nullptr);
+   void        clear();
+   std::size_t devices() const             { return m_devices.size(); }
+   uint8_t     selected(uint16_t port) const { return m_select[port]; }  // Bit i: device i
+
+   uint8_t     in (uint16_t port) const;
+   void        out(uint16_t port, uint8_t data) const;
+
+private:
+   struct Device {
+      uint16_t mask, value;   // Address bits decoded, and their value
+      In       in;            // Read handler (none: does not drive the bus)
+      Out      out;           // Write handler (none: ignores writes)
+   };
+
+   std::vector<Device>  m_devices;    // Attached devices (at most MAX_DEVICES)
+   std::vector<uint8_t> m_select;     // Devices selected by every port (bit i: device i)
+};
+
+//
+// IORQ+RD: Value read from port (ANDed values of the devices selected)
+//
+inline uint8_t
+IOPorts::in(uint16_t port) const {
+   uint8_t data = 0xFF;
+   for (uint8_t s = m_select[port], i = 0; s; s >>= 1, ++i)
+      if ( (s & 1) && m_devices[i].in ) data &= m_devices[i].in(port);
+   return data;
+}
+
+//
+// IORQ+WR: data written to port, latched by all devices selected
+//
+inline void
+IOPorts::out(uint16_t port, uint8_t data) const {
+   for (uint8_t s = m_select[port], i = 0; s; s >>= 1, ++i)
+      if ( (s & 1) && m_devices[i].out ) m_devices[i].out(port, data);
+}
+
+} // Namespace Z80CPP
@@ -0,0 +1,269 @@
+#include <cstring>
+#include <Jit.hpp>
+
+#ifdef Z80CPP_JIT
+   #include <sys/mman.h>
+#endif
+
+namespace Z80CPP {
+
+//
+// Host registers used by compiled code (System V AMD64 ABI):
+//   rbx = Registers*   r12 = Memory*   r13 = Memory invalidations at entry
+//   eax = Address / data read   edx = Data to write   ecx = Scratch
+// rbx, r12 and r13 are callee-saved, so they survive calls to Memory
+//
+enum HostReg : uint8_t { EAX = 0, ECX = 1, EDX = 2 };
+
+// Writes to pages with no write pointer (shared or watched)
+static void
+memoryWrite(Memory* mem, uint32_t addr, uint32_t v) {
+   mem->write(addr, v);
+}
+
+Jit::Jit() {
+#ifdef Z80CPP_JIT
+   void* p = mmap(nullptr, BUFFER, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if ( p != MAP_FAILED ) m_buf = static_cast<uint8_t*>(p);
+#endif
+}
+
+Jit::~Jit() {
+#ifdef Z80CPP_JIT
+   if ( m_buf ) munmap(m_buf, BUFFER);
+#endif
+}
+
+// movzx reg, byte/word [rbx + r]
+void Jit::load8 (uint8_t reg, Reg8  r) { bytes({ 0x0F, 0xB6, uint8_t(0x43 | reg << 3), r.off }); }
+void Jit::load16(uint8_t reg, Reg16 r) { bytes({ 0x0F, 0xB7, uint8_t(0x43 | reg << 3), r.off }); }
+// mov byte/word [rbx + r], reg
+void Jit::store8 (Reg8  r, uint8_t reg) { bytes({ 0x88, uint8_t(0x43 | reg << 3), r.off }); }
+void Jit::store16(Reg16 r, uint8_t reg) { bytes({ 0x66, 0x89, uint8_t(0x43 | reg << 3), r.off }); }
+// mov byte/word [rbx + r], imm
+void Jit::set8 (Reg8  r, uint8_t  v) { bytes({ 0xC6, 0x43, r.off, v }); }
+void Jit::set16(Reg16 r, uint16_t v) { bytes({ 0x66, 0xC7, 0x43, r.off }); imm16(v); }
+// inc/dec word [rbx + r]
+void Jit::inc16(Reg16 r) { bytes({ 0x66, 0xFF, 0x43, r.off }); }
+void Jit::dec16(Reg16 r) { bytes({ 0x66, 0xFF, 0x4B, r.off }); }
+
+//
+// eax = Memory::read(eax)
+//
+void
+Jit::read() {
+   bytes({ 0x89, 0xC1 });                          // mov   ecx, eax
+   bytes({ 0xC1, 0xE9, Memory::PAGE_BITS });       // shr   ecx, PAGE_BITS
+   bytes({ 0x49, 0x8B, 0x8C, 0xCC }); imm32(m_rdoff);  // mov rcx, [r12 + rcx*8 + m_rd]
+   byte(0x25); imm32(Memory::PAGE_MASK);           // and   eax, PAGE_MASK
+   bytes({ 0x0F, 0xB6, 0x04, 0x01 });              // movzx eax, byte [rcx + rax]
+}
+
+//
+// Memory::write(eax, dl). Pages with no write pointer go through Memory
+//
+void
+Jit::write() {
+   bytes({ 0x89, 0xC1 });                          // mov   ecx, eax
+   bytes({ 0xC1, 0xE9, Memory::PAGE_BITS });       // shr   ecx, PAGE_BITS
+   bytes({ 0x49, 0x8B, 0x8C, 0xCC }); imm32(m_wroff);  // mov rcx, [r12 + rcx*8 + m_wr]
+   bytes({ 0x48, 0x85, 0xC9 });                    // test  rcx, rcx
+   bytes({ 0x74, 10 });                            // jz    slow
+   byte(0x25); imm32(Memory::PAGE_MASK);           // and   eax, PAGE_MASK
+   bytes({ 0x88, 0x14, 0x01 });                    // mov   [rcx + rax], dl
+   bytes({ 0xEB, 17 });                            // jmp   done
+   bytes({ 0x89, 0xC6 });                          // slow: mov esi, eax
+   bytes({ 0x4C, 0x89, 0xE7 });                    // mov   rdi, r12
+   bytes({ 0x48, 0xB8 }); imm64(reinterpret_cast<uint64_t>(&memoryWrite));  // mov rax, memoryWrite
+   bytes({ 0xFF, 0xD0 });                          // call  rax
+}                                                  // done:
+
+//
+// Leave after n instructions, with PC at pc (or HL) and R refreshed n times
+//
+void
+Jit::exit(uint32_t n, uint16_t pc, bool pcFromHL) {
+   if ( pcFromHL ) { load16(EAX, Reg::HL); store16(Reg::PC, EAX); }
+   else            set16(Reg::PC, pc);
+   load8(EAX, Reg::R);
+   bytes({ 0x89, 0xC1 });                          // mov   ecx, eax
+   bytes({ 0x81, 0xE1 }); imm32(0x80);             // and   ecx, 0x80 (bit 7 is kept)
+   byte(0x05); imm32(n);                           // add   eax, n
+   bytes({ 0x83, 0xE0, 0x7F });                    // and   eax, 0x7F
+   bytes({ 0x09, 0xC8 });                          // or    eax, ecx
+   store8(Reg::R, EAX);
+   byte(0xB8); imm32(n);                           // mov   eax, n
+   bytes({ 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3 });  // pop r13; pop r12; pop rbx; ret
+}
+
+//
+// Leave after n instructions when the last one invalidated watched code
+//
+void
+Jit::exitIfInvalidated(uint32_t n, uint16_t pc) {
+   bytes({ 0x49, 0x8B, 0x84, 0x24 }); imm32(m_invoff);  // mov rax, [r12 + m_invalidations]
+   bytes({ 0x4C, 0x39, 0xE8 });                    // cmp   rax, r13
+   bytes({ 0x74, 0x00 });                          // je    next
+   const std::size_t jump = m_code.size();
+   exit(n, pc);
+   m_code[jump - 1] = m_code.size() - jump;
+}                                                  // next:
+
+//
+// Code for instruction in at pc, the n-th of its block, doing exactly
+// what Z80::instruction does. Only loads, exchanges, stack and jumps are
+// compiled: F is never touched but by EX AF,AF' and PUSH/POP AF, as it
+// is up to date on entry (run). Any other opcode returns false
+//
+bool
+Jit::instruction(const Insn& in, uint16_t pc, uint32_t n) {
+   static constexpr Reg8 r8[8] = { Reg::B, Reg::C, Reg::D, Reg::E, Reg::H, Reg::L, Reg::BUS8, Reg::A };
+   const uint8_t  op   = in.op;
+   const uint8_t  e    = in.operands[0];
+   const uint16_t nn   = in.operands[0] | in.operands[1] << 8;
+   auto setA   = [&](uint16_t a) { byte(0xB8); imm32(a); };   // mov eax, a
+   auto setD   = [&](uint8_t v)  { byte(0xBA); imm32(v); };   // mov edx, v
+   auto swap   = [&](Reg16 a, Reg16 b) { load16(EAX, a); load16(EDX, b); store16(a, EDX); store16(b, EAX); };
+   auto push   = [&](Reg8 hi, Reg8 lo) {
+      dec16(Reg::SP); load16(EAX, Reg::SP); load8(EDX, hi); write();
+      dec16(Reg::SP); load16(EAX, Reg::SP); load8(EDX, lo); write();
+   };
+   auto pop    = [&](Reg8 hi, Reg8 lo) {
+      load16(EAX, Reg::SP); read(); store8(lo, EAX); inc16(Reg::SP);
+      load16(EAX, Reg::SP); read(); store8(hi, EAX); inc16(Reg::SP);
+   };
+
+   // 0x40-0x7F [[ LD r, r' ]] block decoded from its bitfields
+   if ( (op & 0xC0) == 0x40 && op != 0x76 ) {
+      const Reg8 d = r8[(op >> 3) & 7], s = r8[op & 7];
+      if      ( s == Reg::BUS8 ) { load16(EAX, Reg::HL); read(); store8(d, EAX); }
+      else if ( d == Reg::BUS8 ) { load16(EAX, Reg::HL); load8(EDX, s); write(); }
+      else                       { load8(EAX, s); store8(d, EAX); }
+      return true;
+   }
+
+   switch( op ) {
+      case 0x00:                                                        break;
+      case 0x01: set16(Reg::BC, nn);                                    break;
+      case 0x02: load16(EAX, Reg::BC); load8(EDX, Reg::A); write();     break;
+      case 0x03: inc16(Reg::BC);                                        break;
+      case 0x06: set8(Reg::B, e);                                       break;
+      case 0x08: swap(Reg::AF, Reg::AF_);                               break;
+      case 0x0A: load16(EAX, Reg::BC); read(); store8(Reg::A, EAX);     break;
+      case 0x0B: dec16(Reg::BC);                                        break;
+      case 0x0E: set8(Reg::C, e);                                       break;
+
+      case 0x11: set16(Reg::DE, nn);                                    break;
+      case 0x12: load16(EAX, Reg::DE); load8(EDX, Reg::A); write();     break;
+      case 0x13: inc16(Reg::DE);                                        break;
+      case 0x16: set8(Reg::D, e);                                       break;
+      case 0x18: {
+         const uint16_t t = pc + 2 + (int8_t)e;
+         set16(Reg::BUF, t); set16(Reg::WZ, t); exit(n, t);             break;
+      }
+      case 0x1A: load16(EAX, Reg::DE); read(); store8(Reg::A, EAX);     break;
+      case 0x1B: dec16(Reg::DE);                                        break;
+      case 0x1E: set8(Reg::E, e);                                       break;
+
+      case 0x21: set16(Reg::HL, nn);                                    break;
+      case 0x22:
+         set16(Reg::WZ, nn + 2);
+         setA(nn);                     load8(EDX, Reg::L); write();
+         setA(uint16_t(nn + 1));       load8(EDX, Reg::H); write();     break;
+      case 0x23: inc16(Reg::HL);                                        break;
+      case 0x26: set8(Reg::H, e);                                       break;
+      case 0x2A:
+         set16(Reg::WZ, nn + 2);
+         setA(nn);                     read(); store8(Reg::L, EAX);
+         setA(uint16_t(nn + 1));       read(); store8(Reg::H, EAX);     break;
+      case 0x2B: dec16(Reg::HL);                                        break;
+      case 0x2E: set8(Reg::L, e);                                       break;
+
+      case 0x31: set16(Reg::SP, nn);                                    break;
+      case 0x32: set16(Reg::WZ, nn + 1); setA(nn); load8(EDX, Reg::A); write();  break;
+      case 0x33: inc16(Reg::SP);                                        break;
+      case 0x36: set8(Reg::BFl, e); load16(EAX, Reg::HL); setD(e); write();      break;
+      case 0x3A: set16(Reg::WZ, nn + 1); setA(nn); read(); store8(Reg::A, EAX);  break;
+      case 0x3B: dec16(Reg::SP);                                        break;
+      case 0x3E: set8(Reg::A, e);                                       break;
+
+      case 0xC1: pop (Reg::B, Reg::C);                                  break;
+      case 0xC3: set16(Reg::WZ, nn); exit(n, nn);                       break;
+      case 0xC5: push(Reg::B, Reg::C);                                  break;
+
+      case 0xD1: pop (Reg::D, Reg::E);                                  break;
+      case 0xD5: push(Reg::D, Reg::E);                                  break;
+      case 0xD9: swap(Reg::BC, Reg::BC_); swap(Reg::DE, Reg::DE_); swap(Reg::HL, Reg::HL_); break;
+
+      case 0xE1: pop (Reg::H, Reg::L);                                  break;
+      case 0xE3:
+         load16(EAX, Reg::SP); bytes({ 0xFF, 0xC0 }); store16(Reg::BUF, EAX);  // BUF = SP + 1
+         load16(EAX, Reg::SP);  read(); store8(Reg::Z, EAX);
+         load16(EAX, Reg::BUF); read(); store8(Reg::W, EAX);
+         load16(EAX, Reg::BUF); load8(EDX, Reg::H); write();
+         load16(EAX, Reg::SP);  load8(EDX, Reg::L); write();
+         load16(EAX, Reg::WZ);  store16(Reg::HL, EAX);                  break;
+      case 0xE5: push(Reg::H, Reg::L);                                  break;
+      case 0xE9: exit(n, 0, true);                                      break;
+      case 0xEB: swap(Reg::DE, Reg::HL);                                break;
+
+      case 0xF1: pop (Reg::A, Reg::F);                                  break;
+      case 0xF5: push(Reg::A, Reg::F);                                  break;
+      case 0xF9: load16(EAX, Reg::HL); store16(Reg::SP, EAX);           break;
+
+      default:   return false;
+   }
+   return true;
+}
+
+//
+// Compile up to count instructions of the block at pc. count becomes the
+// number compiled (they stop before a HALT, or any opcode not compiled,
+// see instruction). It returns nullptr when
+// nothing could be compiled, or the buffer is full
+//
+Jit::Fn
+Jit::compile(uint16_t pc, const Insn* insns, uint8_t& count, const Memory& mem) {
+   if ( !m_buf ) { count = 0; return nullptr; }
+   auto offset = [&mem](const void* member) {
+      return int32_t(static_cast<const uint8_t*>(member) - reinterpret_cast<const uint8_t*>(&mem));
+   };
+   m_rdoff  = offset(&mem.m_rd);
+   m_wroff  = offset(&mem.m_wr);
+   m_invoff = offset(&mem.m_invalidations);
+
+   m_code.clear();
+   bytes({ 0x53, 0x41, 0x54, 0x41, 0x55 });        // push rbx; push r12; push r13
+   bytes({ 0x48, 0x89, 0xFB });                    // mov  rbx, rdi
+   bytes({ 0x49, 0x89, 0xF4 });                    // mov  r12, rsi
+   bytes({ 0x49, 0x89, 0xD5 });                    // mov  r13, rdx
+
+   uint8_t n = 0;
+   bool    jumped = false;
+   while ( n < count && !jumped ) {
+      const Z80::Decoded& d = Z80::decoded(insns[n].op);
+      if ( !instruction(insns[n], pc, n + 1) ) break;
+      ++n;
+      pc    += 1 + d.operands;
+      jumped = d.ends;
+      if ( d.writes ) exitIfInvalidated(n, pc);
+   }
+   count = n;
+   if ( !n ) return nullptr;
+   if ( !jumped ) exit(n, pc);
+
+#ifdef Z80CPP_JIT
+   const std::size_t size = (m_code.size() + 15) & ~std::size_t(15);
+   if ( m_used + size > BUFFER ) return nullptr;
+   if ( mprotect(m_buf, BUFFER, PROT_READ | PROT_WRITE) ) return nullptr;
+   std::memcpy(m_buf + m_used, m_code.data(), m_code.size());
+   if ( mprotect(m_buf, BUFFER, PROT_READ | PROT_EXEC) ) return nullptr;
+   Fn fn = reinterpret_cast<Fn>(m_buf + m_used);
+   m_used += size;
+   return fn;
+#else
+   return nullptr;
+#endif
+}
+
+} // Namespace Z80CPP
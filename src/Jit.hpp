@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+
+// x86-64 code generation needs a POSIX mmap/mprotect. Elsewhere (or
+// building with Z80CPP_NO_JIT) Jit is never available
+#if defined(__x86_64__) && defined(__unix__) && !defined(Z80CPP_NO_JIT)
+   #define Z80CPP_JIT 1
+#endif
+
+namespace Z80CPP {
+
+//
+// Jit: Compiles basic blocks of the Instruction engine into x86-64 code
+// (BlockCache.hpp). Compiled code works on the Registers of the CPU in
+// place, pointed to by a host register, and on Memory page tables, with
+// operands and PCs folded in as constants. Writes to pages without a
+// write pointer call Memory::write, and a write invalidating watched
+// code exits right after its instruction. Code returns the number of
+// instructions run, and T-states are added for exactly those. Lazy
+// flags are computed before entering, as ALU opcodes are not compiled.
+//
+// Code goes to an mmap'd buffer, writable while compiling and only
+// executable afterwards. compile() fails when it is full, and the
+// caller drops everything compiled and resets it.
+//
+class Jit {
+public:
+   struct Insn {
+      uint8_t op;
+      uint8_t operands[2];
+   };
+   using Fn = uint32_t (*)(Registers* regs, Memory* mem, uint64_t invalidations);
+   static constexpr std::size_t BUFFER = 1 << 20;
+
+   Jit();
+   ~Jit();
+   Jit(const Jit&)            = delete;
+   Jit& operator=(const Jit&) = delete;
+
+   bool       available() const   { return m_buf != nullptr; }
+   Fn         compile(uint16_t pc, const Insn* insns, uint8_t& count, const Memory& mem);
+   uint32_t   run(Fn fn, const uint16_t* ticks, Z80& cpu, Memory& mem) {
+      cpu.evalF();
+      uint32_t n = fn(&cpu.m_reg, &mem, mem.m_invalidations);
+      cpu.m_ticks += ticks[n];
+      return n;
+   }
+   void       reset()             { m_used = 0; }
+   std::size_t used() const       { return m_used; }
+
+private:
+   // x86-64 emission
+   void  byte(uint8_t b)          { m_code.push_back(b); }
+   void  bytes(std::initializer_list<uint8_t> bs) { m_code.insert(m_code.end(), bs); }
+   void  imm16(uint16_t v)        { byte(v); byte(v >> 8); }
+   void  imm32(uint32_t v)        { imm16(v); imm16(v >> 16); }
+   void  imm64(uint64_t v)        { imm32(v); imm32(v >> 32); }
+   void  load8 (uint8_t reg, Reg8  r);
+   void  load16(uint8_t reg, Reg16 r);
+   void  store8 (Reg8  r, uint8_t reg);
+   void  store16(Reg16 r, uint8_t reg);
+   void  set8 (Reg8  r, uint8_t  v);
+   void  set16(Reg16 r, uint16_t v);
+   void  inc16(Reg16 r);
+   void  dec16(Reg16 r);
+   void  read();
+   void  write();
+   void  exit(uint32_t n, uint16_t pc, bool pcFromHL = false);
+   void  exitIfInvalidated(uint32_t n, uint16_t pc);
+   bool  instruction(const Insn& in, uint16_t pc, uint32_t n);
+
+   uint8_t*             m_buf  = nullptr;   // Executable buffer
+   std::size_t          m_used = 0;         // Bytes of the buffer in use
+   std::vector<uint8_t> m_code;             // Block being compiled
+   int32_t              m_rdoff = 0, m_wroff = 0, m_invoff = 0;  // Offsets inside Memory
+};
+
+} // Namespace Z80CPP
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <vector>
+#include <Loader.hpp>
+#include <MappedFile.hpp>
+#include <SaveState.hpp>
+
+namespace Z80CPP {
+
+// Little endian 16-bit value at p
+static uint16_t
+le16(const uint8_t* p) { return p[0] | p[1] << 8; }
+
+static void
+check(bool ok, const std::string& file, const char* what) {
+   if ( !ok ) throw std::runtime_error(file + ": " + what);
+}
+
+// Value of hex digit c (or -1)
+static int
+hex(uint8_t c) {
+   if ( c >= '0' && c <= '9' ) return c - '0';
+   c |= 0x20;
+   return ( c >= 'a' && c <= 'f' ) ? c - 'a' + 10 : -1;
+}
+
+static bool
+startsWith(const MappedFile& f, const char* magic) {
+   const std::size_t n = std::strlen(magic);
+   return f.size() >= n && !std::memcmp(f.data(), magic, n);
+}
+
+//
+// Format of file: save states, snapshots and disk images by their magic,
+// Intel HEX by its extension (raw binaries may start with ':')
+//
+Loader::Format
+Loader::format(const std::string& file) {
+   if ( SaveState::probe(file) ) return Format::SaveState;
+   const MappedFile f(file);
+   if ( startsWith(f, "MV - SNA") )                                    return Format::Snapshot;
+   if ( startsWith(f, "MV - CPC") || startsWith(f, "EXTENDED CPC DSK") ) return Format::Disk;
+
+   std::string ext = file.substr(std::min(file.rfind('.'), file.size()));
+   std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+   return ( ext == ".ihx" || ext == ".hex" ) ? Format::IntelHex : Format::Binary;
+}
+
+//
+// Raw binary at addr. Returns its size
+//
+uint32_t
+Loader::bin(const std::string& file, Memory& mem, uint16_t addr) {
+   const MappedFile f(file);
+   check(addr + f.size() <= mem.size(), file, "Program too big to fit into memory");
+   mem.load(addr, f.data(), f.size());
+   return f.size();
+}
+
+//
+// Intel HEX records. Returns the bytes loaded
+//
+uint32_t
+Loader::ihx(const std::string& file, Memory& mem) {
+   const MappedFile f(file);
+
+   // Records are checked and decoded first, so that errors load nothing
+   struct Record { uint16_t addr; uint32_t first, size; };
+   std::vector<Record>  records;
+   std::vector<uint8_t> bytes;
+   const uint8_t*       p   = f.begin();
+   bool                 eof = false;
+   while ( !eof ) {
+      while ( p < f.end() && std::isspace(*p) ) ++p;
+      check(p < f.end(), file, "Missing end of file record");
+      check(*p++ == ':', file, "Bad Intel HEX record");
+
+      // Count, address, type, data and checksum, as hex pairs
+      uint8_t rec[5 + 255];
+      uint8_t sum = 0;
+      std::size_t n = 0;
+      for (std::size_t len = 5; n < len; ++n) {
+         check(f.end() - p >= 2 && hex(p[0]) >= 0 && hex(p[1]) >= 0, file, "Bad Intel HEX record");
+         rec[n] = hex(p[0]) << 4 | hex(p[1]);
+         sum   += rec[n];
+         p     += 2;
+         if ( n == 0 ) len += rec[0];
+      }
+      check(sum == 0, file, "Intel HEX checksum error");
+
+      const uint16_t addr = rec[1] << 8 | rec[2];
+      switch ( rec[3] ) {
+         case 0x00:  // Data
+            check(addr + rec[0] <= 0x10000, file, "Intel HEX address beyond 64K");
+            records.push_back(Record{ addr, (uint32_t)bytes.size(), rec[0] });
+            bytes.insert(bytes.end(), rec + 4, rec + 4 + rec[0]);
+            break;
+         case 0x01: eof = true; break;
+         case 0x02: case 0x04:  // Extended address: only within 64K
+            check(rec[0] == 2 && rec[4] == 0 && rec[5] == 0, file, "Intel HEX address beyond 64K");
+            break;
+         case 0x03: case 0x05: break;  // Start address
+         default: check(false, file, "Unknown Intel HEX record type");
+      }
+   }
+   for (const auto& r : records)
+      mem.load(r.addr, &bytes[r.first], r.size);
+   return bytes.size();
+}
+
+//
+// Amstrad CPC snapshot
+//
+void
+Loader::sna(const std::string& file, Z80& cpu, Memory& mem) {
+   const MappedFile f(file);
+   check(startsWith(f, "MV - SNA") && f.size() >= 0x100, file, "Not a CPC snapshot");
+   const uint8_t*    h    = f.data();
+   const std::size_t dump = le16(h + 0x6B) * 1024;
+   check(dump > 0, file, "Compressed snapshots not supported");
+   check(f.size() >= 0x100 + dump, file, "Snapshot memory dump missing");
+   const uint32_t banks = (dump + Memory::PAGE_SIZE - 1) / Memory::PAGE_SIZE;
+   check(banks <= mem.banks(), file, "Memory has not enough RAM banks for the snapshot");
+
+   Registers r = cpu.registers();
+   r.main.F = h[0x11]; r.main.A = h[0x12];
+   r.main.C = h[0x13]; r.main.B = h[0x14];
+   r.main.E = h[0x15]; r.main.D = h[0x16];
+   r.main.L = h[0x17]; r.main.H = h[0x18];
+   r.R  = h[0x19];     r.I  = h[0x1A];
+   r.IX = le16(h + 0x1D);
+   r.IY = le16(h + 0x1F);
+   r.SP = le16(h + 0x21);
+   r.PC = le16(h + 0x23);
+   r.alt.F = h[0x26]; r.alt.A = h[0x27];
+   r.alt.C = h[0x28]; r.alt.B = h[0x29];
+   r.alt.E = h[0x2A]; r.alt.D = h[0x2B];
+   r.alt.L = h[0x2C]; r.alt.H = h[0x2D];
+   cpu.setRegisters(r);
+   cpu.setIFF(h[0x1B] & 1, h[0x1C] & 1);
+   cpu.setIM(h[0x25]);
+
+   for (uint32_t b = 0; b < banks; ++b) {
+      const std::size_t size = std::min<std::size_t>(Memory::PAGE_SIZE, dump - b * Memory::PAGE_SIZE);
+      std::memcpy(mem.bank(b), h + 0x100 + b * Memory::PAGE_SIZE, size);
+   }
+
+   // Gate Array RAM configuration (6128): banks of pages 0-3
+   static constexpr uint8_t CONFIGS[8][4] = {
+      { 0, 1, 2, 3 }, { 0, 1, 2, 7 }, { 4, 5, 6, 7 }, { 0, 3, 2, 7 },
+      { 0, 4, 2, 3 }, { 0, 5, 2, 3 }, { 0, 6, 2, 3 }, { 0, 7, 2, 3 }
+   };
+   const uint8_t config = ( banks > 4 ) ? h[0x41] & 7 : 0;
+   for (uint8_t p = 0; p < Memory::PAGES; ++p)
+      mem.map(p, CONFIGS[config][p]);
+}
+
+//
+// Amstrad CPC disk image: a binary file from its AMSDOS filesystem.
+// Returns the bytes loaded
+//
+uint32_t
+Loader::dsk(const std::string& file, Z80& cpu, Memory& mem, const std::string& name) {
+   const MappedFile f(file);
+   const bool extended = startsWith(f, "EXTENDED CPC DSK");
+   check(extended || startsWith(f, "MV - CPC"), file, "Not a CPC disk image");
+   check(f.size() >= 0x100, file, "Disk image too short");
+   const uint8_t* d      = f.data();
+   const uint8_t  tracks = d[0x30], sides = std::max<uint8_t>(d[0x31], 1);
+   // The track size table of extended images ends with the header
+   check(!extended || tracks * sides <= 0x100 - 0x34, file, "Too many tracks in disk image");
+
+   // Sectors of side 0 by track and sector ID
+   std::map<uint16_t, const uint8_t*> sectors;
+   std::size_t offset = 0x100;
+   for (uint32_t t = 0; t < tracks * sides; ++t) {
+      const std::size_t size = extended ? d[0x34 + t] * 256 : le16(d + 0x32);
+      if ( !size ) continue;
+      check(size >= 0x100 && offset + size <= f.size() && !std::memcmp(d + offset, "Track-Info", 10),
+            file, "Corrupt disk image track");
+      const uint8_t* ti   = d + offset;
+      std::size_t    data = offset + 0x100;
+      for (uint8_t s = 0; s < ti[0x15] && 0x18 + s * 8 + 8 <= 0x100; ++s) {
+         const uint8_t*    si  = ti + 0x18 + s * 8;
+         const std::size_t len = extended ? le16(si + 6) : std::size_t(128) << std::min<uint8_t>(ti[0x14], 6);
+         check(data + len <= offset + size, file, "Corrupt disk image sector");
+         if ( t % sides == 0 && len >= 512 ) sectors[ti[0x10] << 8 | si[2]] = d + data;
+         data += len;
+      }
+      offset += size;
+   }
+
+   // AMSDOS: 9 sectors of 512 bytes per track, IDs from C1h (data format)
+   // or 41h (system format, 2 reserved tracks). 1K blocks, 64 entries of
+   // directory in blocks 0-1
+   const bool    system   = sectors.count(0x41) != 0;
+   const uint8_t base     = system ? 0x41 : 0xC1;
+   const uint8_t reserved = system ? 2 : 0;
+   check(system || sectors.count(0xC1), file, "Not an AMSDOS disk");
+   auto sector = [&](uint32_t n) {
+      const auto s = sectors.find((reserved + n / 9) << 8 | (base + n % 9));
+      check(s != sectors.end(), file, "AMSDOS sector missing");
+      return s->second;
+   };
+   auto block = [&](std::vector<uint8_t>& out, uint32_t b) {
+      for (uint32_t s = b * 2; s < b * 2 + 2; ++s) out.insert(out.end(), sector(s), sector(s) + 512);
+   };
+   std::vector<uint8_t> dir;
+   block(dir, 0);
+   block(dir, 1);
+
+   // Files: their extents in order, with the bytes of each one
+   std::map<std::string, std::map<uint16_t, const uint8_t*>> files;
+   std::vector<std::string> order;
+   for (std::size_t e = 0; e < dir.size(); e += 32) {
+      const uint8_t* ent = &dir[e];
+      if ( ent[0] > 15 ) continue;   // Deleted (E5h) or not a file
+      std::string n;
+      for (int i = 1; i < 12; ++i) {
+         const char c = ent[i] & 0x7F;
+         if ( i == 9 ) n += '.';
+         if ( c != ' ' ) n += std::toupper(c);
+      }
+      if ( !files.count(n) ) order.push_back(n);
+      files[n][ent[13] << 5 | ent[12]] = ent;
+   }
+   auto contents = [&](const std::string& n) {
+      std::vector<uint8_t> out;
+      for (const auto& ext : files[n]) {
+         const uint8_t* ent    = ext.second;
+         const uint32_t blocks = (ent[15] * 128 + 1023) / 1024;
+         for (uint32_t i = 0; i < blocks && i < 16; ++i) block(out, ent[16 + i]);
+         out.resize(out.size() - blocks * 1024 + ent[15] * 128);
+      }
+      return out;
+   };
+   auto amsdos = [](const std::vector<uint8_t>& c) {
+      if ( c.size() < 128 ) return false;
+      uint16_t sum = 0;
+      for (int i = 0; i < 67; ++i) sum += c[i];
+      return sum == le16(&c[67]);
+   };
+
+   // The file asked for, or the first binary one
+   std::string wanted = name;
+   std::transform(wanted.begin(), wanted.end(), wanted.begin(), [](unsigned char c) { return std::toupper(c); });
+   if ( !wanted.empty() && wanted.find('.') == std::string::npos ) wanted += '.';
+   std::vector<uint8_t> c;
+   for (const auto& n : order) {
+      if ( !wanted.empty() && n != wanted ) continue;
+      c = contents(n);
+      if ( amsdos(c) && (!wanted.empty() || (c[0x12] & 0x0E) == 0x02) ) break;
+      check(wanted.empty(), file, "File has no AMSDOS header (no load address)");
+      c.clear();
+   }
+   check(!c.empty(), file, name.empty() ? "No binary file in disk" : "File not found in disk");
+
+   const uint16_t load  = le16(&c[0x15]);
+   const uint32_t size  = c[0x40] | c[0x41] << 8 | c[0x42] << 16;
+   check(size <= c.size() - 128 && load + size <= mem.size(), file, "File does not fit into memory");
+   mem.load(load, &c[128], size);
+   cpu.setPC(le16(&c[0x1A]));
+   return size;
+}
+
+} // Namespace Z80CPP
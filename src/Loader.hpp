@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <Z80.hpp>
+#include <Memory.hpp>
+
+namespace Z80CPP {
+
+//
+// Loader: Programs and machine images, copied into Memory straight from
+// the mapped file (see MappedFile). Malformed or unsupported files throw
+// std::runtime_error, before anything is loaded.
+//    bin: Raw binary, loaded at addr
+//    ihx: Intel HEX, as sdcc emits it. Data records go through the write
+//         map of Memory, wherever their address is
+//    sna: Amstrad CPC snapshot (versions 1 to 3, uncompressed memory
+//         dump). Registers, interrupt state and RAM: the dump goes to RAM
+//         banks 0-7 (a 6128 dump needs a Memory with 8 banks), mapped
+//         as the Gate Array's RAM configuration says. ROMs and other
+//         hardware state (CRTC, PPI, PSG...) are left to the caller
+//    dsk: Amstrad CPC disk image (standard or extended), in AMSDOS data
+//         or system format. Loads a binary file (name, or the first one
+//         with an AMSDOS header) at its load address, and sets PC to its
+//         entry address
+//
+class Loader {
+public:
+   enum class Format : uint8_t { Binary, IntelHex, Snapshot, Disk, SaveState };
+
+   static Format   format(const std::string& file);
+   static uint32_t bin(const std::string& file, Memory& mem, uint16_t addr = 0);
+   static uint32_t ihx(const std::string& file, Memory& mem);
+   static void     sna(const std::string& file, Z80& cpu, Memory& mem);
+   static uint32_t dsk(const std::string& file, Z80& cpu, Memory& mem, const std::string& name = "");
+};
+
+} // Namespace Z80CPP
@@ -0,0 +1,351 @@
+#include <Lockstep.hpp>
+
+namespace Z80CPP {
+
+template <unsigned LANES>
+Lockstep<LANES>::Lockstep(const Memory& image) {
+   for (auto& m : m_mem) m = image;
+}
+
+template <unsigned LANES>
+Registers
+Lockstep<LANES>::registers(unsigned l) const {
+   Registers r;
+   uint16_t* p = reinterpret_cast<uint16_t*>(&r);
+   for (unsigned i = 0; i < PAIRS; ++i) p[i] = m_rp[i][l];
+   return r;
+}
+
+template <unsigned LANES>
+void
+Lockstep<LANES>::setRegisters(unsigned l, const Registers& r) {
+   const uint16_t* p = reinterpret_cast<const uint16_t*>(&r);
+   for (unsigned i = 0; i < PAIRS; ++i) m_rp[i][l] = p[i];
+}
+
+//
+// Run one instruction on every lane. The lockstep group is made of the
+// lanes running the most common instruction (PC and opcode, or HALT NOP
+// for halted lanes), found by majority vote. The rest run on the scalar
+// core, one by one. So do all of them when it is prefixed (CB, DD, ED,
+// FD), as only unprefixed opcodes have vector code.
+//
+template <unsigned LANES>
+void
+Lockstep<LANES>::step() {
+   constexpr uint32_t HALTED = 0x1000000;
+   uint32_t key[LANES];
+   for (unsigned l = 0; l < LANES; ++l) {
+      uint16_t pc = m_rp[PC][l];
+      key[l] = m_halt[l] ? HALTED : (uint32_t)pc << 8 | m_mem[l].read(pc);
+   }
+
+   uint32_t lead  = key[0];
+   int      votes = 0;
+   for (unsigned l = 0; l < LANES; ++l) {
+      if      ( !votes )            { lead = key[l]; votes = 1; }
+      else if ( key[l] == lead )    ++votes;
+      else                          --votes;
+   }
+   const bool prefixed = lead != HALTED && isPrefix(lead & 0xFF);
+   for (unsigned l = 0; l < LANES; ++l) {
+      m_on[l] = ( key[l] == lead && !prefixed ) ? 0xFFFF : 0;
+      if ( m_on[l] ) ++m_vlanes; else scalar(l);
+   }
+
+   if ( prefixed ) return;
+
+   // M1: Refresh (and fetch opcode). HALT NOPs just refresh. The 
+   // instruction after EI is over
+   for (unsigned l = 0; l < LANES; ++l) {
+      uint16_t ir = (m_rp[IR][l] & 0xFF80) | ((m_rp[IR][l] + 1) & 0x7F);
+      m_rp[IR][l] = (ir & m_on[l]) | (m_rp[IR][l] & ~m_on[l]);
+      m_iff[l]   &= ~(Z80::IFF_EI & m_on[l]);
+   }
+   if ( lead == HALTED ) {
+      for (unsigned l = 0; l < LANES; ++l) m_ticks[l] += 4 & m_on[l];
+      return;
+   }
+   for (unsigned l = 0; l < LANES; ++l) m_rp[PC][l] += 1 & m_on[l];
+   execute(lead);
+}
+
+//
+// Run one instruction of lane l on the scalar core
+//
+template <unsigned LANES>
+void
+Lockstep<LANES>::scalar(unsigned l) {
+   Z80 cpu(Engine::Instruction);
+   cpu.m_reg   = registers(l);
+   cpu.m_ticks = m_ticks[l];
+   cpu.m_iff   = m_iff[l];
+   cpu.m_im    = m_im[l];
+   if ( m_halt[l] ) cpu.m_fetch = TProgramTable::PRG_HALT;
+   cpu.execute(m_mem[l]);
+   setRegisters(l, cpu.registers());
+   m_ticks[l] = cpu.m_ticks;
+   m_halt[l]  = cpu.halted();
+   m_iff[l]   = cpu.m_iff;
+   m_im[l]    = cpu.m_im;
+   ++m_slanes;
+}
+
+//
+// Execute opcode op (already fetched) on the lockstep group, exactly as
+// Z80::execute does (Z80_fast.cpp)
+//
+template <unsigned LANES>
+void
+Lockstep<LANES>::execute(uint8_t op) {
+   auto&           rp = m_rp;
+   const uint16_t* on = m_on;
+
+   // Register-only operations run on all lanes, branch-free. Lanes out
+   // of the group compute too, but keep their previous values
+   auto set  = [&](Pair p, auto f) {
+      for (unsigned l = 0; l < LANES; ++l) {
+         uint16_t v = f(l);
+         rp[p][l] = (v & on[l]) | (rp[p][l] & ~on[l]);
+      }
+   };
+   auto swap = [&](Pair a, Pair b) {
+      for (unsigned l = 0; l < LANES; ++l) {
+         uint16_t x = rp[a][l], y = rp[b][l];
+         rp[a][l] = (y & on[l]) | (x & ~on[l]);
+         rp[b][l] = (x & on[l]) | (y & ~on[l]);
+      }
+   };
+   auto tick = [&](uint64_t n) { for (unsigned l = 0; l < LANES; ++l) m_ticks[l] += n & on[l]; };
+
+   // Operations accessing memory run lane by lane on the group
+   auto each = [&](auto f) { for (unsigned l = 0; l < LANES; ++l) if ( on[l] ) f(l); };
+   auto rd   = [&](unsigned l, uint16_t a) -> uint8_t { return m_mem[l].read(a); };
+   auto wr   = [&](unsigned l, uint16_t a, uint8_t v) { m_mem[l].write(a, v); };
+   auto n    = [&](unsigned l) -> uint8_t  { return rd(l, rp[PC][l]++); };
+   auto nn   = [&](unsigned l) -> uint16_t { uint16_t v = n(l); return v | n(l) << 8; };
+   auto push = [&](unsigned l, uint16_t v) { wr(l, --rp[SP][l], v >> 8); wr(l, --rp[SP][l], v); };
+   auto pop  = [&](unsigned l) -> uint16_t { uint16_t v = rd(l, rp[SP][l]++); return v | rd(l, rp[SP][l]++) << 8; };
+   auto hi   = [&](Pair p, unsigned l) -> uint8_t { return rp[p][l] >> 8; };
+   auto lo   = [&](Pair p, unsigned l) -> uint8_t { return rp[p][l];      };
+   auto setHi = [&](Pair p, unsigned l, uint8_t v) { rp[p][l] = (rp[p][l] & 0x00FF) | v << 8; };
+   auto setLo = [&](Pair p, unsigned l, uint8_t v) { rp[p][l] = (rp[p][l] & 0xFF00) | v;      };
+
+   // Flags are computed at once on every lane (Z80 does it lazily)
+   auto alu  = [&](ALU a, unsigned l, uint8_t v) -> uint16_t {
+      const uint8_t   f = lo(AF, l);
+      const LazyFlags r = LazyFlags::of(a, hi(AF, l), v, f & Flag::C);
+      return r.result() << 8 | r.flags(f);
+   };
+   auto incdec = [&](ALU a, Pair p, unsigned shift) {
+      each([&](unsigned l) {
+         const LazyFlags r = LazyFlags::of(a, rp[p][l] >> shift, 0, lo(AF, l) & Flag::C);
+         rp[p][l] = (rp[p][l] & ~(0xFF << shift)) | r.result() << shift;
+         setLo(AF, l, r.flags(0)); });
+   };
+   auto aluN = [&](ALU a) {
+      each([&](unsigned l) { setLo(BUF, l, n(l)); rp[AF][l] = alu(a, l, lo(BUF, l)); });
+   };
+   auto acc  = [&](uint16_t (*f)(uint16_t)) { set(AF, [&](unsigned l) { return f(rp[AF][l]); }); };
+
+   // 0x40-0x7F [[ LD r, r' ]] block decoded from its bitfields
+   //   01 ddd sss: ddd/sss = B,C,D,E,H,L,(HL),A
+   if ( (op & 0xC0) == 0x40 && op != 0x76 ) {
+      static constexpr Pair    pair [8] = { BC, BC, DE, DE, HL, HL, PAIRS, AF };
+      static constexpr uint8_t shift[8] = {  8,  0,  8,  0,  8,  0,     0,  8 };
+      const unsigned d = (op >> 3) & 7, s = op & 7;
+      if      ( s == 6 ) { each([&](unsigned l) {
+                              uint8_t v = rd(l, rp[HL][l]);
+                              if ( shift[d] ) setHi(pair[d], l, v); else setLo(pair[d], l, v); }); tick(7); }
+      else if ( d == 6 ) { each([&](unsigned l) { wr(l, rp[HL][l], rp[pair[s]][l] >> shift[s]); }); tick(7); }
+      else {
+         const Pair pd = pair[d], ps = pair[s];
+         const uint8_t sd = shift[d], ss = shift[s];
+         set(pd, [&](unsigned l) -> uint16_t {
+            uint16_t v = (rp[ps][l] >> ss) & 0xFF;
+            return (rp[pd][l] & ~(0xFF << sd)) | v << sd; });
+         tick(4);
+      }
+      return;
+   }
+
+   // 0x80-0xBF [[ ALU A, r ]] block decoded from its bitfields
+   //   10 aaa sss: aaa = ADD,ADC,SUB,SBC,AND,XOR,OR,CP  sss = B,...,(HL),A
+   if ( (op & 0xC0) == 0x80 ) {
+      static constexpr Pair    pair [8] = { BC, BC, DE, DE, HL, HL, PAIRS, AF };
+      static constexpr uint8_t shift[8] = {  8,  0,  8,  0,  8,  0,     0,  8 };
+      const ALU      a = ALU((op >> 3) & 7);
+      const unsigned s = op & 7;
+      if ( s == 6 ) {
+         each([&](unsigned l) {
+            setLo(BUF, l, rd(l, rp[HL][l]));
+            rp[AF][l] = alu(a, l, lo(BUF, l)); });                           tick(7);
+      } else {
+         const Pair ps = pair[s]; const uint8_t ss = shift[s];
+         set(AF, [&](unsigned l) { return alu(a, l, rp[ps][l] >> ss); });   tick(4);
+      }
+      return;
+   }
+
+   // Instruction jump table
+   switch( op ) {
+      // Basics
+      case 0x01: each([&](unsigned l) { rp[BC][l] = nn(l); });                tick(10); break;
+      case 0x02: each([&](unsigned l) { wr(l, rp[BC][l], hi(AF, l)); });      tick( 7); break;
+      case 0x03: set(BC, [&](unsigned l) { return rp[BC][l] + 1; });         tick( 6); break;
+      case 0x04: incdec(ALU::INC, BC, 8);                                    tick( 4); break;
+      case 0x05: incdec(ALU::DEC, BC, 8);                                    tick( 4); break;
+      case 0x06: each([&](unsigned l) { setHi(BC, l, n(l)); });              tick( 7); break;
+      case 0x07: acc(AccOps::rlca);                                          tick( 4); break;
+      case 0x08: swap(AF, AF_);                                              tick( 4); break;
+      case 0x0A: each([&](unsigned l) { setHi(AF, l, rd(l, rp[BC][l])); });  tick( 7); break;
+      case 0x0B: set(BC, [&](unsigned l) { return rp[BC][l] - 1; });         tick( 6); break;
+      case 0x0C: incdec(ALU::INC, BC, 0);                                    tick( 4); break;
+      case 0x0D: incdec(ALU::DEC, BC, 0);                                    tick( 4); break;
+      case 0x0E: each([&](unsigned l) { setLo(BC, l, n(l)); });              tick( 7); break;
+      case 0x0F: acc(AccOps::rrca);                                          tick( 4); break;
+
+      case 0x11: each([&](unsigned l) { rp[DE][l] = nn(l); });                tick(10); break;
+      case 0x12: each([&](unsigned l) { wr(l, rp[DE][l], hi(AF, l)); });      tick( 7); break;
+      case 0x13: set(DE, [&](unsigned l) { return rp[DE][l] + 1; });         tick( 6); break;
+      case 0x14: incdec(ALU::INC, DE, 8);                                    tick( 4); break;
+      case 0x15: incdec(ALU::DEC, DE, 8);                                    tick( 4); break;
+      case 0x16: each([&](unsigned l) { setHi(DE, l, n(l)); });              tick( 7); break;
+      case 0x17: acc(AccOps::rla);                                           tick( 4); break;
+      case 0x18:
+         each([&](unsigned l) {
+            uint8_t e = n(l);
+            rp[BUF][l] = rp[PC][l] + (int8_t)e;
+            rp[WZ][l]  = rp[BUF][l];
+            rp[PC][l]  = rp[WZ][l]; });                                      tick(12); break;
+      case 0x1A: each([&](unsigned l) { setHi(AF, l, rd(l, rp[DE][l])); });  tick( 7); break;
+      case 0x1B: set(DE, [&](unsigned l) { return rp[DE][l] - 1; });         tick( 6); break;
+      case 0x1C: incdec(ALU::INC, DE, 0);                                    tick( 4); break;
+      case 0x1D: incdec(ALU::DEC, DE, 0);                                    tick( 4); break;
+      case 0x1E: each([&](unsigned l) { setLo(DE, l, n(l)); });              tick( 7); break;
+      case 0x1F: acc(AccOps::rra);                                           tick( 4); break;
+
+      case 0x21: each([&](unsigned l) { rp[HL][l] = nn(l); });                tick(10); break;
+      case 0x22:
+         each([&](unsigned l) {
+            rp[WZ][l] = nn(l);
+            wr(l, rp[WZ][l]++, lo(HL, l));
+            wr(l, rp[WZ][l]++, hi(HL, l)); });                               tick(16); break;
+      case 0x23: set(HL, [&](unsigned l) { return rp[HL][l] + 1; });         tick( 6); break;
+      case 0x24: incdec(ALU::INC, HL, 8);                                    tick( 4); break;
+      case 0x25: incdec(ALU::DEC, HL, 8);                                    tick( 4); break;
+      case 0x26: each([&](unsigned l) { setHi(HL, l, n(l)); });              tick( 7); break;
+      case 0x27: acc(AccOps::daa);                                           tick( 4); break;
+      case 0x2A:
+         each([&](unsigned l) {
+            rp[WZ][l] = nn(l);
+            setLo(HL, l, rd(l, rp[WZ][l]++));
+            setHi(HL, l, rd(l, rp[WZ][l]++)); });                            tick(16); break;
+      case 0x2B: set(HL, [&](unsigned l) { return rp[HL][l] - 1; });         tick( 6); break;
+      case 0x2C: incdec(ALU::INC, HL, 0);                                    tick( 4); break;
+      case 0x2D: incdec(ALU::DEC, HL, 0);                                    tick( 4); break;
+      case 0x2E: each([&](unsigned l) { setLo(HL, l, n(l)); });              tick( 7); break;
+      case 0x2F: acc(AccOps::cpl);                                           tick( 4); break;
+
+      case 0x31: each([&](unsigned l) { rp[SP][l] = nn(l); });                tick(10); break;
+      case 0x32:
+         each([&](unsigned l) {
+            rp[WZ][l] = nn(l);
+            wr(l, rp[WZ][l]++, hi(AF, l)); });                               tick(13); break;
+      case 0x33: set(SP, [&](unsigned l) { return rp[SP][l] + 1; });         tick( 6); break;
+      case 0x34:
+      case 0x35:
+         each([&](unsigned l) {
+            const LazyFlags r = LazyFlags::of(op == 0x34 ? ALU::INC : ALU::DEC,
+                                              rd(l, rp[HL][l]), 0, lo(AF, l) & Flag::C);
+            setLo(BUF, l, r.result());
+            setLo(AF, l, r.flags(0));
+            wr(l, rp[HL][l], lo(BUF, l)); });                                tick(11); break;
+      case 0x36:
+         each([&](unsigned l) {
+            setLo(BUF, l, n(l));
+            wr(l, rp[HL][l], lo(BUF, l)); });                                tick(10); break;
+      case 0x3A:
+         each([&](unsigned l) {
+            rp[WZ][l] = nn(l);
+            setHi(AF, l, rd(l, rp[WZ][l]++)); });                            tick(13); break;
+      case 0x37: acc(AccOps::scf);                                           tick( 4); break;
+      case 0x3B: set(SP, [&](unsigned l) { return rp[SP][l] - 1; });         tick( 6); break;
+      case 0x3C: incdec(ALU::INC, AF, 8);                                    tick( 4); break;
+      case 0x3D: incdec(ALU::DEC, AF, 8);                                    tick( 4); break;
+      case 0x3E: each([&](unsigned l) { setHi(AF, l, n(l)); });              tick( 7); break;
+      case 0x3F: acc(AccOps::ccf);                                           tick( 4); break;
+
+      case 0x76: each([&](unsigned l) { m_halt[l] = 1; });                   tick( 4); break;
+
+      case 0xC1: each([&](unsigned l) { rp[BC][l] = pop(l); });              tick(10); break;
+      case 0xC3:
+         each([&](unsigned l) {
+            rp[WZ][l] = nn(l);
+            rp[PC][l] = rp[WZ][l]; });                                       tick(10); break;
+      case 0xC5: each([&](unsigned l) { push(l, rp[BC][l]); });              tick(11); break;
+      case 0xC6: aluN(ALU::ADD);                                             tick( 7); break;
+      case 0xC9:
+         each([&](unsigned l) {
+            rp[WZ][l] = pop(l);
+            rp[PC][l] = rp[WZ][l]; });                                       tick(10); break;
+      case 0xCE: aluN(ALU::ADC);                                             tick( 7); break;
+
+      case 0xD1: each([&](unsigned l) { rp[DE][l] = pop(l); });              tick(10); break;
+      case 0xD3:
+         each([&](unsigned l) {
+            rp[BUF][l] = hi(AF, l) << 8 | n(l);
+            rp[WZ][l]  = (rp[BUF][l] & 0xFF00) | ((rp[BUF][l] + 1) & 0xFF); });
+                                                                             tick(11); break;
+      case 0xD5: each([&](unsigned l) { push(l, rp[DE][l]); });              tick(11); break;
+      case 0xD6: aluN(ALU::SUB);                                             tick( 7); break;
+      case 0xD9: swap(BC, BC_); swap(DE, DE_); swap(HL, HL_);                tick( 4); break;
+      case 0xDB:
+         each([&](unsigned l) {
+            rp[BUF][l] = hi(AF, l) << 8 | n(l);
+            rp[WZ][l]  = rp[BUF][l] + 1;
+            setHi(AF, l, 0xFF); });                                          tick(11); break;
+      case 0xDE: aluN(ALU::SBC);                                             tick( 7); break;
+
+      case 0xE1: each([&](unsigned l) { rp[HL][l] = pop(l); });              tick(10); break;
+      case 0xE3:
+         each([&](unsigned l) {
+            rp[BUF][l] = rp[SP][l] + 1;
+            setLo(WZ, l, rd(l, rp[SP][l]));
+            setHi(WZ, l, rd(l, rp[BUF][l]));
+            wr(l, rp[BUF][l], hi(HL, l));
+            wr(l, rp[SP][l],  lo(HL, l));
+            rp[HL][l] = rp[WZ][l]; });                                       tick(19); break;
+      case 0xE5: each([&](unsigned l) { push(l, rp[HL][l]); });              tick(11); break;
+      case 0xE6: aluN(ALU::AND);                                             tick( 7); break;
+      case 0xE9: set(PC, [&](unsigned l) { return rp[HL][l]; });             tick( 4); break;
+      case 0xEB: swap(DE, HL);                                               tick( 4); break;
+      case 0xEE: aluN(ALU::XOR);                                             tick( 7); break;
+
+      case 0xF1: each([&](unsigned l) { rp[AF][l] = pop(l); });              tick(10); break;
+      case 0xF3: each([&](unsigned l) { m_iff[l] = 0; });                    tick( 4); break;
+      case 0xF5: each([&](unsigned l) { push(l, rp[AF][l]); });              tick(11); break;
+      case 0xF6: aluN(ALU::OR);                                              tick( 7); break;
+      case 0xF9: set(SP, [&](unsigned l) { return rp[HL][l]; });             tick( 6); break;
+      case 0xFB: each([&](unsigned l) { m_iff[l] = Z80::IFF1 | Z80::IFF2 | Z80::IFF_EI; }); tick( 4); break;
+      case 0xFE: aluN(ALU::CP);                                              tick( 7); break;
+
+      // RST p
+      case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+      case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+         each([&](unsigned l) {
+            rp[WZ][l] = op & 0x38;
+            push(l, rp[PC][l]);
+            rp[PC][l] = rp[WZ][l]; });                                       tick(11); break;
+
+      // NOP and not yet implemented opcodes
+      default:                                                               tick( 4); break;
+   }
+}
+
+// Lane counts available
+template class Lockstep<8>;
+template class Lockstep<16>;
+template class Lockstep<32>;
+
+} // Namespace Z80CPP
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <Z80.hpp>
+#include <Memory.hpp>
+
+namespace Z80CPP {
+
+//
+// Lockstep: Instruction engine for LANES CPUs running the same program,
+// each one with its own registers and Memory. Registers are kept as a
+// structure of arrays (one array of LANES values per register pair).
+// Lanes about to run the same opcode at the same PC form the lockstep
+// group and run it together: register operations are branch-free loops
+// over all lanes, masked by the group, that the compiler vectorizes.
+// Memory accesses are done lane by lane. Lanes diverging from the group
+// run their instruction on the scalar core (Z80::execute) and rejoin
+// as soon as they reach the group PC again. Every step() runs exactly
+// one instruction on every lane, so each lane agrees bit for bit with
+// a Z80 using Engine::Instruction. Lanes keep their interrupt state 
+// (IFFs, IM), but have no interrupt inputs, nor IO devices: IN reads
+// FFh and OUT goes nowhere.
+//
+template <unsigned LANES>
+class Lockstep {
+   static_assert(LANES > 0 && LANES <= 32, "Lockstep: From 1 to 32 lanes");
+
+public:
+   explicit Lockstep(const Memory& image);
+
+   Registers registers(unsigned l) const;
+   void      setRegisters(unsigned l, const Registers& r);
+   uint64_t  ticks (unsigned l) const   { return m_ticks[l]; }
+   bool      halted(unsigned l) const   { return m_halt[l];  }
+   Memory&   memory(unsigned l)         { return m_mem[l];   }
+   uint64_t  vectorLanes() const        { return m_vlanes;   }  // Lane instructions run in lockstep
+   uint64_t  scalarLanes() const        { return m_slanes;   }  // Lane instructions run by the scalar core
+
+   void      step();
+   void      run(uint64_t n)            { while ( n-- ) step(); }
+
+private:
+   // Register pairs in the order they are laid out in Registers
+   enum Pair : uint8_t { AF, BC, DE, HL, AF_, BC_, DE_, HL_, IX, IY, WZ, SP, IR, BUF, PC, PAIRS };
+   static_assert(sizeof(Registers) == PAIRS * sizeof(uint16_t), "Registers must be just register pairs");
+
+   void     execute(uint8_t op);
+   void     scalar(unsigned l);
+
+   alignas(64) uint16_t      m_rp[PAIRS][LANES] {};  // Register pairs of every lane
+   alignas(64) uint16_t      m_on[LANES]        {};  // Lanes in the lockstep group (0xFFFF) or not (0)
+   alignas(64) uint64_t      m_ticks[LANES]     {};  // T-states of every lane
+   uint8_t                   m_halt[LANES]      {};  // Lanes performing HALT NOPs
+   uint8_t                   m_iff[LANES]       {};  // Interrupt flip-flops of every lane (Z80::m_iff)
+   uint8_t                   m_im[LANES]        {};  // Interrupt mode of every lane
+   std::array<Memory, LANES> m_mem;
+   uint64_t                  m_vlanes = 0;
+   uint64_t                  m_slanes = 0;
+};
+
+} // Namespace Z80CPP
@@ -0,0 +1,45 @@
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <MappedFile.hpp>
+
+#ifdef Z80CPP_MMAP
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+namespace Z80CPP {
+
+MappedFile::MappedFile(const std::string& file, bool writable) {
+#ifdef Z80CPP_MMAP
+   const int fd = open(file.c_str(), O_RDONLY);
+   if ( fd < 0 ) throw std::runtime_error("Could not open " + file);
+   struct stat st;
+   if ( fstat(fd, &st) != 0 ) { close(fd); throw std::runtime_error("Could not open " + file); }
+   m_size = st.st_size;
+   if ( m_size ) {
+      const int prot = PROT_READ | (writable ? PROT_WRITE : 0);
+      void*     p    = mmap(nullptr, m_size, prot, MAP_PRIVATE, fd, 0);
+      if ( p == MAP_FAILED ) { close(fd); throw std::runtime_error("Could not map " + file); }
+      m_data = static_cast<uint8_t*>(p);
+   }
+   close(fd);
+#else
+   (void)writable;
+   std::ifstream f(file, std::ios::binary);
+   if ( !f ) throw std::runtime_error("Could not open " + file);
+   m_copy.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+   m_data = m_copy.data();
+   m_size = m_copy.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef Z80CPP_MMAP
+   if ( m_data ) munmap(m_data, m_size);
+#endif
+}
+
+} // Namespace Z80CPP
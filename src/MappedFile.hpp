@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Files are mapped with POSIX mmap. Elsewhere (or building with
+// Z80CPP_NO_MMAP) they are read into memory instead
+#if defined(__unix__) && !defined(Z80CPP_NO_MMAP)
+   #define Z80CPP_MMAP
+#endif
+
+namespace Z80CPP {
+
+//
+// MappedFile: Contents of a whole file, mapped into memory. Pages are
+// read from disk when first touched. A writable MappedFile is private
+// (copy-on-write): writes never reach the file. Throws
+// std::runtime_error when the file cannot be opened or mapped
+//
+class MappedFile {
+public:
+   explicit MappedFile(const std::string& file, bool writable = false);
+   ~MappedFile();
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+   const uint8_t* data() const   { return m_data; }
+   uint8_t*       data()         { return m_data; }
+   std::size_t    size() const   { return m_size; }
+   const uint8_t* begin() const  { return m_data; }
+   const uint8_t* end() const    { return m_data + m_size; }
+
+private:
+   uint8_t*             m_data = nullptr;  // Contents
+   std::size_t          m_size = 0;        // Bytes in the file
+   std::vector<uint8_t> m_copy;            // Contents, when not mapped
+};
+
+} // Namespace Z80CPP
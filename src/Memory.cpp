@@ -1,23 +1,370 @@
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
 #include <Memory.hpp>
 
 namespace Z80CPP {
 
-Memory::Memory(uint16_t size) : m_size(size) {
-   m_bytes = std::make_unique<uint8_t[]>(size);
+Memory::Memory(uint32_t banks) {
+   m_ram.resize(std::max(banks, 1u));
+   m_dirty.resize(m_ram.size());
+   for (auto& b : m_ram) 
+      b = std::make_shared<Bank>();
+   m_rdbank.fill(EXTERNAL);
+   m_wrbank.fill(SINK);
+   reset();
+   for (uint8_t p = 0; p < PAGES; ++p)
+      map(p, p);
+}
+
+//
+// Copy shares all RAM banks with m. Both Memories lose write access to 
+// their pages of RAM banks until they get their own copies by writing.
+//
+Memory::Memory(const Memory& m)
+   : m_ram(m.m_ram), m_rd(m.m_rd), m_wr(m.m_wr)
+   , m_rdbank(m.m_rdbank), m_wrbank(m.m_wrbank), m_rdcode(m.m_rdcode)
+   , m_watched(m.m_watched), m_wrcode(m.m_wrcode), m_code(m.m_code), m_trap(m.m_trap)
+   , m_wrtrap(m.m_wrtrap), m_gen(m.m_gen)
+   , m_generations(m.m_generations), m_invalidations(m.m_invalidations), m_tracking(m.m_tracking), m_dirty(m.m_dirty)
+{
+   if ( m.m_sink ) {
+      m_sink = std::make_unique<uint8_t[]>(PAGE_SIZE);
+      for (uint8_t p = 0; p < PAGES; ++p)
+         if ( m_wrbank[p] == SINK ) m_wr[p] = m_sink.get();
+   }
+   protectShared();
+   m.protectShared();
+}
+
+//
+// Remove write pointers of pages whose RAM bank is shared
+//
+void
+Memory::protectShared() const {
+   for (uint8_t p = 0; p < PAGES; ++p)
+      if ( m_wrbank[p] >= 0 && m_ram[m_wrbank[p]].use_count() > 1 ) 
+         m_wr[p] = m_wrcode[p] = nullptr;
+}
+
+//
+// Write to a page with no write pointer: its RAM bank is shared, has
+// watched code or its writes are tracked. Watched code being written
+// is invalidated, and clean code pages get dirty
+//
+uint8_t*
+Memory::writable(uint16_t addr) {
+   const uint8_t page = addr >> PAGE_BITS;
+   if ( m_watched[page] ) {
+      const uint32_t code = codeOf(m_wrbank[page], addr);
+      if ( m_trap[code] & TRAP_CODE ) {
+         m_code[code] = false;
+         m_gen[code]  = ++m_generations;
+         ++m_invalidations;
+      }
+      if ( m_trap[code] & TRAP_CLEAN )
+         m_dirty[m_wrbank[page]] |= uint64_t(1) << (code % BANK_PAGES);
+      setTrap(code, 0);
+      if ( m_wrcode[page] ) return m_wrcode[page];
+   }
+   return own(m_wrbank[page]);
+}
+
+//
+// Make a RAM bank exclusively owned, copying it when shared, and 
+// point all pages mapping it to the owned bank
+//
+uint8_t*
+Memory::own(uint32_t bank) {
+   auto& b = m_ram[bank];
+   if ( b.use_count() > 1 ) {
+      b = std::make_shared<Bank>(*b);
+      ++m_copied;
+   }
+   for (uint8_t p = 0; p < PAGES; ++p) {
+      if ( m_rdbank[p] == (int32_t)bank ) m_rd[p] = b->data();
+      if ( m_wrbank[p] == (int32_t)bank ) {
+         m_wr[p]     = m_watched[p] ? nullptr : b->data();
+         m_wrcode[p] = m_watched[p] ? b->data() : nullptr;
+      }
+   }
+   return b->data();
+}
+
+//
+// Writable RAM bank. Code read from it may change at any time
+//
+uint8_t*
+Memory::bank(uint32_t n) {
+   n %= m_ram.size();
+   rewrite(n);
+   if ( m_tracking ) m_dirty[n] = ~uint64_t(0);
+   for (uint8_t p = 0; p < PAGES; ++p) trap(p);
+   return own(n);
+}
+
+//
+// Watch code at addr: its code page will get a new generation when
+// written through any page mapping its RAM bank, which all lose their
+// write pointer. Code read from external pointers (ROM) gets a new one
+// when its page is remapped. It returns current generation
+//
+uint32_t
+Memory::watch(uint16_t addr) {
+   const int32_t  bank = m_rdbank[addr >> PAGE_BITS];
+   const uint32_t code = codeAt(addr);
+   m_code[code] = true;
+   if ( bank >= 0 && !(m_trap[code] & TRAP_CODE) ) {
+      setTrap(code, m_trap[code] | TRAP_CODE);
+      for (uint8_t p = 0; p < PAGES; ++p)
+         if ( m_wrbank[p] == bank && !m_watched[p] ) trap(p);
+   }
+   return m_gen[code];
+}
+
+//
+// Page is going to be remapped: code read from an external pointer gets
+// a new generation. Code of RAM banks keeps it, wherever it is mapped
+//
+void
+Memory::invalidate(uint8_t page) {
+   if ( m_rdbank[page] >= 0 ) return;
+   const uint32_t first = codeAt(page << PAGE_BITS);
+   bool watched = false;
+   for (uint32_t c = first; c < first + BANK_PAGES; ++c) {
+      watched  |= m_code[c];
+      m_code[c] = false;
+      m_gen[c]  = ++m_generations;
+   }
+   if ( watched ) ++m_invalidations;
+}
+
+//
+// All of bank is going to be overwritten: its code pages get a new
+// generation and are not watched (nor clean) any more
+//
+void
+Memory::rewrite(uint32_t bank) {
+   const uint32_t first = bank * BANK_PAGES;
+   bool watched = false;
+   for (uint32_t c = first; c < first + BANK_PAGES; ++c) {
+      watched  |= m_code[c];
+      m_code[c] = false;
+      m_trap[c] = 0;
+      m_gen[c]  = ++m_generations;
+   }
+   if ( watched ) ++m_invalidations;
+}
+
+//
+// Traps of a code page of a RAM bank, for all pages writing to it
+//
+void
+Memory::setTrap(uint32_t code, uint8_t trap) {
+   m_trap[code] = trap;
+   for (uint8_t p = 0; p < PAGES; ++p)
+      if ( m_wrbank[p] == (int32_t)(code / BANK_PAGES) ) m_wrtrap[p * BANK_PAGES + code % BANK_PAGES] = trap;
+}
+
+//
+// Page changed the bank it reads from: code pages read in it are those
+// of the bank, or its own after all banks when reading an external pointer
+//
+void
+Memory::setCode(uint8_t page) {
+   m_rdcode[page] = codeOf(( m_rdbank[page] >= 0 ) ? m_rdbank[page] : (int32_t)m_ram.size() + page, 0);
+}
+
+//
+// RAM banks were replaced: every code page gets a new generation, none
+// is watched, and pages trap the writes they still have to
+//
+void
+Memory::reset() {
+   const std::size_t codes = (m_ram.size() + PAGES) * BANK_PAGES;
+   for (uint8_t p = 0; p < PAGES; ++p) setCode(p);
+   bool watched = std::find(m_code.begin(), m_code.end(), true) != m_code.end();
+   m_code.assign(codes, false);
+   m_trap.assign(codes, 0);
+   m_gen.resize(codes);
+   for (auto& g : m_gen) g = ++m_generations;
+   for (uint32_t b = 0; b < m_ram.size(); ++b)
+      for (uint32_t i = 0; i < BANK_PAGES; ++i)
+         if ( m_tracking && !(m_dirty[b] >> i & 1) ) m_trap[b * BANK_PAGES + i] = TRAP_CLEAN;
+   for (uint8_t p = 0; p < PAGES; ++p) trap(p);
+   if ( watched ) ++m_invalidations;
+}
+
+void 
+Memory::map(uint8_t page, uint32_t bank) {
+   page &= PAGES-1;
+   bank %= m_ram.size();
+   invalidate(page);
+   m_rdbank[page] = m_wrbank[page] = bank;
+   setCode(page);
+   m_rd[page] = m_ram[bank]->data();
+   trap(page);
+}
+
+//
+// Page reads come from src (i.e. a ROM), writes are not affected
+//
+void 
+Memory::mapRead(uint8_t page, const uint8_t* src) {
+   page &= PAGES-1;
+   invalidate(page);
+   m_rdbank[page] = EXTERNAL;
+   setCode(page);
+   m_rd[page]     = src;
+   trap(page);
+}
+
+//
+// Page writes go to dst, reads are not affected
+//
+void 
+Memory::mapWrite(uint8_t page, uint8_t* dst) {
+   page &= PAGES-1;
+   m_wrbank[page] = EXTERNAL;
+   m_wr[page]     = dst;
+   trap(page);
+}
+
+//
+// Page writes are discarded (i.e. a ROM with no RAM underneath)
+//
+void 
+Memory::unmapWrite(uint8_t page) {
+   page &= PAGES-1;
+   if ( !m_sink ) m_sink = std::make_unique<uint8_t[]>(PAGE_SIZE);
+   m_wrbank[page] = SINK;
+   m_wr[page]     = m_sink.get();
+   trap(page);
 }
 
 void 
 Memory::fill(uint8_t v) {
-   std::memset(m_bytes.get(), v, m_size);
+   for (uint32_t b = 0; b < m_ram.size(); ++b) {
+      rewrite(b);
+      if ( m_ram[b].use_count() > 1 ) m_ram[b] = std::make_shared<Bank>();
+      std::memset(own(b), v, PAGE_SIZE);
+   }
+   if ( m_tracking ) std::fill(m_dirty.begin(), m_dirty.end(), ~uint64_t(0));
+   for (uint8_t p = 0; p < PAGES; ++p) trap(p);
+}
+
+//
+// Current page maps
+//
+Memory::Mapping
+Memory::mapping() const {
+   Mapping m;
+   m.rdbank = m_rdbank;
+   m.wrbank = m_wrbank;
+   for (uint8_t p = 0; p < PAGES; ++p) {
+      m.rd[p] = ( m_rdbank[p] == EXTERNAL ) ? m_rd[p] : nullptr;
+      m.wr[p] = ( m_wrbank[p] == EXTERNAL ) ? m_wr[p] : nullptr;
+   }
+   return m;
+}
+
+//
+// Map all pages as given by m (from mapping())
+//
+void
+Memory::setMapping(const Mapping& m) {
+   for (uint8_t p = 0; p < PAGES; ++p) {
+      const int32_t rd = ( m.rdbank[p] >= 0 ) ? m.rdbank[p] % m_ram.size() : m.rdbank[p];
+      const int32_t wr = ( m.wrbank[p] >= 0 ) ? m.wrbank[p] % m_ram.size() : m.wrbank[p];
+      invalidate(p);
+      m_rdbank[p] = rd;
+      m_wrbank[p] = wr;
+      setCode(p);
+      m_rd[p]     = ( rd >= 0 ) ? m_ram[rd]->data() : m.rd[p];
+      if ( wr == SINK ) {
+         if ( !m_sink ) m_sink = std::make_unique<uint8_t[]>(PAGE_SIZE);
+         m_wr[p] = m_sink.get();
+      } else {
+         m_wr[p] = m.wr[p];
+      }
+      trap(p);
+   }
+}
+
+//
+// Start tracking writes with all pages clean, or stop it
+//
+void
+Memory::track(bool on) {
+   m_tracking = on;
+   if ( on ) { clean(); return; }
+   for (auto& t : m_trap) t &= ~TRAP_CLEAN;
+   for (uint8_t p = 0; p < PAGES; ++p) trap(p);
+}
+
+//
+// Mark all pages of all banks clean: next writes to them are tracked
+//
+void
+Memory::clean() {
+   std::fill(m_dirty.begin(), m_dirty.end(), 0);
+   for (uint32_t c = 0; c < m_ram.size() * BANK_PAGES; ++c) m_trap[c] |= TRAP_CLEAN;
+   for (uint8_t p = 0; p < PAGES; ++p) trap(p);
+}
+
+//
+// Set the write pointer of page. Pages writing to a RAM bank with
+// watched code, or with writes tracked, have none: they check the code
+// pages they write to, and the clean ones trap their first write
+//
+void
+Memory::trap(uint8_t page) {
+   uint8_t* const wrtrap = &m_wrtrap[page * BANK_PAGES];
+   m_watched[page] = false;
+   m_wrcode[page]  = nullptr;
+   std::fill(wrtrap, wrtrap + BANK_PAGES, 0);
+   if ( m_wrbank[page] < 0 ) return;
+   const auto&    b     = m_ram[m_wrbank[page]];
+   uint8_t* const data  = ( b.use_count() > 1 ) ? nullptr : b->data();
+   const uint32_t first = m_wrbank[page] * BANK_PAGES;
+   bool code = false;
+   for (uint32_t i = 0; i < BANK_PAGES; ++i) {
+      wrtrap[i] = m_trap[first + i];
+      code |= wrtrap[i] & TRAP_CODE;
+   }
+   m_watched[page] = m_tracking || code;
+   m_wrcode[page]  = m_watched[page] ? data : nullptr;
+   m_wr[page]      = m_watched[page] ? nullptr : data;
+}
+
+//
+// Write size bytes from addr onwards through the write map,
+// wrapping around at the end of the address space. Pages with a
+// write pointer get whole runs copied
+//
+void 
+Memory::load(uint16_t addr, const uint8_t* data, std::size_t size) {
+   while ( size ) {
+      const uint8_t     page = addr >> PAGE_BITS;
+      const std::size_t run  = std::min<std::size_t>(size, PAGE_SIZE - (addr & PAGE_MASK));
+      if ( m_wr[page] ) {
+         std::memcpy(m_wr[page] + (addr & PAGE_MASK), data, run);
+      } else {
+         for (std::size_t i = 0; i < run; ++i) write(addr + i, data[i]);
+      }
+      addr += run;
+      data += run;
+      size -= run;
+   }
 }
 
-const uint8_t&
-Memory::get(uint16_t pos) const {
-   if (pos > m_size) throw std::out_of_range("[]: Requested memory location is out of range\n");
-   
-   return m_bytes[pos];
+//
+// RAM banks currently shared with other Memories
+//
+uint32_t
+Memory::sharedBanks() const {
+   return std::count_if(m_ram.begin(), m_ram.end(), 
+                        [](const auto& b) { return b.use_count() > 1; });
 }
 
-} // Namespace Z80CPP
\ No newline at end of file
+} // Namespace Z80CPP
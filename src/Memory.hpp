@@ -1,23 +1,156 @@
 #pragma once
 
+#include <array>
 #include <memory>
+#include <vector>
 #include <cstdint>
+#include <cstddef>
 #include <iostream>
 
 namespace Z80CPP {
 
+//
+// Memory: Full 64K address space mapped through a table of 4 pages of
+// 16K. Reads and writes have their own page maps, so that ROM overlays
+// (read from ROM, write to RAM underneath) and bank switching are just
+// pointer swaps. Reads are branch-free and accesses never fail.
+//
+// Memory owns a number of 16K RAM banks (4 by default, 8 for a CPC 
+// 6128). Initially, banks 0-3 are mapped for reading and writing to 
+// pages 0-3. ROMs and other read sources are owned by the caller.
+//
+// RAM banks are reference counted and copied on write: copying a Memory
+// only copies its tables and banks get duplicated when first written.
+// Pages of shared banks have no write pointer, so writes to them take
+// the only branch of the hot path to get their own copy.
+//
+// Code caches watch the 256-byte code pages they translate. Code pages
+// belong to RAM banks (or to pages read from the caller's memory), not
+// to addresses, so code is watched through every page mapping its bank.
+// Every code page has a generation, a new one whenever it is written or
+// its bank is replaced, and addresses get the generation of the code
+// page they read. Pages writing to a bank with watched code lose their
+// write pointer too. Writes to them check the code page in the same
+// branch, and other writes cost nothing.
+//
+// Writes to RAM banks may be tracked in 256-byte pages too, for delta
+// checkpoints: a bitmap per bank of the pages written since clean().
+// Tracked pages lose their write pointer like watched ones, and only
+// the first write to every clean code page takes the slow path.
+//
 class Memory {
-   std::unique_ptr<uint8_t[]> m_bytes;    // Raw Memory Bytes
-   uint16_t m_size = 0;                   // Size of the memory
+   friend class Jit;
+   friend class SaveState;
 
-   const uint8_t& get(uint16_t pos) const;
 public:
-   Memory(uint16_t size);
-   
-   void     fill(uint8_t v);
-   uint8_t&       operator[](uint16_t pos)         { return const_cast<uint8_t&>(get(pos)); }
-   const uint8_t& operator[](uint16_t pos) const   { return get(pos); }
-   uint16_t size() const { return m_size; }
+   static constexpr uint32_t PAGE_BITS = 14;
+   static constexpr uint32_t PAGE_SIZE = 1 << PAGE_BITS;    // 16K
+   static constexpr uint32_t PAGE_MASK = PAGE_SIZE - 1;
+   static constexpr uint32_t PAGES     = 0x10000 / PAGE_SIZE;
+   static constexpr uint32_t CODE_BITS = 8;
+
+   explicit Memory(uint32_t banks = PAGES);
+   Memory(const Memory& m);
+   Memory(Memory&&) = default;
+   Memory& operator=(const Memory& m)  { return *this = Memory(m); }
+   Memory& operator=(Memory&&) = default;
+
+   // Hot path accesses
+   uint8_t  read (uint16_t addr) const       { return m_rd[addr >> PAGE_BITS][addr & PAGE_MASK]; }
+   void     write(uint16_t addr, uint8_t v)  {
+      uint8_t* w = m_wr[addr >> PAGE_BITS];
+      if ( !w ) {
+         w = m_wrcode[addr >> PAGE_BITS];
+         if ( !w || m_wrtrap[addr >> CODE_BITS] ) w = writable(addr);
+      }
+      w[addr & PAGE_MASK] = v;
+   }
+   uint8_t  operator[](uint16_t addr) const  { return read(addr); }
+
+   // Page mapping
+   void     map      (uint8_t page, uint32_t bank);
+   void     mapRead  (uint8_t page, const uint8_t* src);
+   void     mapWrite (uint8_t page, uint8_t* dst);
+   void     unmapWrite(uint8_t page);
+
+   // Page maps as a whole (external pointers are the caller's)
+   struct Mapping {
+      std::array<int32_t, PAGES>        rdbank, wrbank;   // Bank of every page (or EXTERNAL, SINK)
+      std::array<const uint8_t*, PAGES> rd;               // Pointers of EXTERNAL pages
+      std::array<uint8_t*, PAGES>       wr;
+   };
+   Mapping  mapping() const;
+   void     setMapping(const Mapping& m);
+
+   // Contents and RAM banks
+   void           fill(uint8_t v);
+   void           load(uint16_t addr, const uint8_t* data, std::size_t size);
+   uint8_t*       bank(uint32_t n);
+   const uint8_t* bank(uint32_t n) const     { return m_ram[n % m_ram.size()]->data(); }
+   uint32_t       banks() const              { return m_ram.size(); }
+   uint32_t       size() const               { return 0x10000; }
+
+   // Copy-on-write statistics
+   uint32_t       sharedBanks() const;
+   uint32_t       copiedBanks() const        { return m_copied; }
+
+   // Self-modifying code detection
+   uint32_t       watch(uint16_t addr);
+   uint32_t       generation(uint16_t addr) const { return m_gen[codeAt(addr)]; }
+   uint64_t       invalidations() const      { return m_invalidations; }
+
+   // Write tracking (bit i of a bank: its 256-byte page i was written)
+   static constexpr uint32_t BANK_PAGES = PAGE_SIZE >> CODE_BITS;
+   static_assert(BANK_PAGES == 64, "Memory: Dirty bitmaps are 64 bits per bank");
+   void           track(bool on);
+   bool           tracking() const           { return m_tracking; }
+   uint64_t       dirty(uint32_t bank) const { return m_dirty[bank % m_ram.size()]; }
+   void           clean();
+
+private:
+   using Bank = std::array<uint8_t, PAGE_SIZE>;
+   static constexpr int32_t EXTERNAL = -1;   // Page mapped to a caller's pointer
+   static constexpr int32_t SINK     = -2;   // Page writes discarded
+   static constexpr uint8_t TRAP_CODE  = 0x01;  // Code page of a bank with watched code
+   static constexpr uint8_t TRAP_CLEAN = 0x02;  // Code page tracked and not written yet
+
+   // Code page of addr in bank, and code page read at addr (banks first,
+   // then the pages reading from external pointers, see setCode)
+   uint32_t       codeOf(int32_t bank, uint16_t addr) const {
+      return (uint32_t)bank * BANK_PAGES + ((addr & PAGE_MASK) >> CODE_BITS);
+   }
+   uint32_t       codeAt(uint16_t addr) const {
+      return m_rdcode[addr >> PAGE_BITS] + ((addr & PAGE_MASK) >> CODE_BITS);
+   }
+
+   uint8_t*       writable(uint16_t addr);
+   uint8_t*       own(uint32_t bank);
+   void           protectShared() const;
+   void           invalidate(uint8_t page);
+   void           rewrite(uint32_t bank);
+   void           setCode(uint8_t page);
+   void           setTrap(uint32_t code, uint8_t trap);
+   void           reset();
+   void           trap(uint8_t page);
+
+   std::vector<std::shared_ptr<Bank>> m_ram;    // RAM banks
+   std::array<const uint8_t*, PAGES>  m_rd;     // Read page map
+   mutable std::array<uint8_t*, PAGES> m_wr;    // Write page map (nullptr: shared bank or watched)
+   std::array<int32_t, PAGES>         m_rdbank; // Bank mapped for reading in each page
+   std::array<int32_t, PAGES>         m_wrbank; // Bank mapped for writing in each page
+   std::array<uint32_t, PAGES>        m_rdcode; // First code page read in each page
+   std::unique_ptr<uint8_t[]>         m_sink;   // Discards unmapped writes
+   uint32_t                           m_copied = 0;  // Banks copied on write
+   std::array<bool, PAGES>            m_watched {};  // Pages writing to watched code or with tracked writes
+   mutable std::array<uint8_t*, PAGES> m_wrcode {};  // Write pointers of watched pages (nullptr: shared bank)
+   std::vector<bool>                  m_code;        // Code pages with translated code
+   std::vector<uint8_t>               m_trap;        // Code pages whose writes take the slow path (TRAP_*)
+   std::array<uint8_t, PAGES * BANK_PAGES> m_wrtrap {}; // m_trap of the code page written at every address
+   std::vector<uint32_t>              m_gen;         // Generation of every code page
+   uint32_t                           m_generations = 0;    // Generations given, all of them different
+   uint64_t                           m_invalidations = 0;  // Watched code pages changed
+   bool                               m_tracking = false;   // Writes to RAM banks tracked
+   std::vector<uint64_t>              m_dirty;       // Pages of every bank written since clean()
 };
 
-} // Namespace Z80CPP
\ No newline at end of file
+} // Namespace Z80CPP
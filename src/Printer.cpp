@@ -1,5 +1,6 @@
 #include <Printer.hpp>
 #include <iomanip>
+#include <algorithm>
 #include <Z80.hpp>
 #include <Memory.hpp>
 
@@ -28,24 +29,42 @@ Printer::printCPUStatus(const Z80& cpu) {
    pr("PC",  r.PC); pr("SP ",  r.SP); m_out << "\n";
    pr("IR",  r.IR); pr("WZ ",  r.WZ); pr("BUF", r.BUF); m_out << "\n";
    m_out << "Signals:(" << cpu.signals() << "):";
-   if ( cpu.signal(Signal::M1)    ) m_out << "|M1";
-   if ( cpu.signal(Signal::MREQ)  ) m_out << "|MREQ";
-   if ( cpu.signal(Signal::IORQ)  ) m_out << "|IORQ";
-   if ( cpu.signal(Signal::RD)    ) m_out << "|RD";
-   if ( cpu.signal(Signal::WR)    ) m_out << "|WR";
-   if ( cpu.signal(Signal::RFSH)  ) m_out << "|RFSH";
-   if ( cpu.signal(Signal::HALT)  ) m_out << "|HALT";
-   if ( cpu.signal(Signal::WAIT)  ) m_out << "|WAIT";
-   if ( cpu.signal(Signal::WSAMP) ) m_out << "|WSMP";
-   m_out << "|\n";
+   printSignals(cpu.signals());
+   m_out << "\n";
    m_out << "Ticks: " << std::dec << cpu.ticks() << "\n";
 }
 
-uint16_t
-adjustMemAddr(uint16_t addr, uint32_t max) {
+void
+Printer::printSignals(uint16_t signals) {
+   auto on = [signals](Signal s) { return signals & (uint16_t)s; };
+   if ( on(Signal::M1)    ) m_out << "|M1";
+   if ( on(Signal::MREQ)  ) m_out << "|MREQ";
+   if ( on(Signal::IORQ)  ) m_out << "|IORQ";
+   if ( on(Signal::RD)    ) m_out << "|RD";
+   if ( on(Signal::WR)    ) m_out << "|WR";
+   if ( on(Signal::RFSH)  ) m_out << "|RFSH";
+   if ( on(Signal::HALT)  ) m_out << "|HALT";
+   if ( on(Signal::WAIT)  ) m_out << "|WAIT";
+   if ( on(Signal::WSAMP) ) m_out << "|WSMP";
+   m_out << "|";
+}
+
+// One T-state of a bus trace: Tick, buses and signals in a line
+void
+Printer::printPins(uint64_t tick, uint16_t signals, uint16_t address, uint8_t data) {
+   m_out << std::dec << std::setw(12) << std::setfill(' ') << tick << " ";
+   printRegister("ADD", address);
+   printRegister("DAT", data);
+   m_out << "SIG";
+   printSignals(signals);
+   m_out << "\n";
+}
+
+uint32_t
+adjustMemAddr(uint32_t addr, uint32_t max) {
    // Adjust address to show 2 rows around given address
    if (addr >= max) addr = max;
-   addr &= 0xFFF0;
+   addr &= ~0xFu;
    if (addr >= 0x10) addr -= 0x10;
 
    return addr;
@@ -54,27 +73,25 @@ adjustMemAddr(uint16_t addr, uint32_t max) {
 
 void
 Printer::printMemoryContents(const Memory& mem, uint16_t pos, uint16_t blocks) {
-   auto higlight= pos;
-   auto size    = mem.size();
-        pos     = adjustMemAddr(pos, size);
-   auto maxaddr = adjustMemAddr(pos + 16*blocks, size) + 0x10;
-   auto* pmem   = &mem[pos];
-   blocks       = 1 + (maxaddr - pos) / 16;
+   uint32_t higlight= pos;
+   uint32_t size    = mem.size();
+   uint32_t addr    = adjustMemAddr(pos, size);
+   uint32_t maxaddr = std::min(adjustMemAddr(addr + 16*blocks, size) + 0x10, size);
+   blocks           = 1 + (maxaddr - addr) / 16;
    
    m_out << "dddd|  0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F |\n";
    m_out << "----|-------------------------------------------------|\n";
    while(--blocks) {
       m_out << std::hex << std::setw(4) << std::setfill('0');
-      m_out << pos << "|";
+      m_out << addr << "|";
       uint8_t i = 17;
       while(--i) { 
-         uint16_t v = static_cast<uint16_t>(*pmem);
-         if      (higlight == pos  ) m_out << "[";
-         else if (higlight == pos-1) m_out << "]";
-         else                        m_out << " ";
+         uint16_t v = static_cast<uint16_t>(mem[addr]);
+         if      (higlight == addr  ) m_out << "[";
+         else if (higlight == addr-1) m_out << "]";
+         else                         m_out << " ";
          m_out << std::setw(2) << std::setfill('0') << v;
-         ++pmem;
-         ++pos;
+         ++addr;
       }
       m_out << " |\n";
    }
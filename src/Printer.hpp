@@ -20,6 +20,8 @@ public:
 
    void  printRegister        (const char* name, uint16_t value);
    void  printCPUStatus       (const Z80& cpu);
+   void  printSignals         (uint16_t signals);
+   void  printPins            (uint64_t tick, uint16_t signals, uint16_t address, uint8_t data);
    void  printMemoryContents  (const Memory& mem, uint16_t pos, uint16_t blocks);
 };
 
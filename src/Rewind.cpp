@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <Rewind.hpp>
+
+namespace Z80CPP {
+
+//
+// Start tracking writes to mem, with a first checkpoint now
+//
+Rewind::Rewind(Z80& cpu, Memory& mem, uint64_t period, std::size_t budget)
+   : m_cpu(cpu), m_mem(mem), m_period(std::max<uint64_t>(period, 1)), m_budget(budget)
+   , m_shadow(std::size_t(mem.banks()) * Memory::PAGE_SIZE)
+{
+   const Memory& ram = m_mem;
+   for (uint32_t b = 0; b < ram.banks(); ++b)
+      std::memcpy(&m_shadow[std::size_t(b) * Memory::PAGE_SIZE], ram.bank(b), Memory::PAGE_SIZE);
+   m_mem.track(true);
+   checkpoint();
+}
+
+//
+// Take a checkpoint now. Pages written since the previous one go to its
+// delta (their contents then, from the copy of RAM) and the copy gets
+// their contents now. The oldest checkpoints go if over budget
+//
+void
+Rewind::checkpoint() {
+   const Memory& ram = m_mem;
+   if ( !m_checkpoints.empty() ) {
+      Checkpoint& last = m_checkpoints.back();
+      for (uint32_t b = 0; b < ram.banks(); ++b) {
+         uint8_t*       copy = &m_shadow[std::size_t(b) * Memory::PAGE_SIZE];
+         const uint8_t* now  = ram.bank(b);
+         for (uint64_t d = ram.dirty(b), i = 0; d; d >>= 1, ++i) {
+            if ( !(d & 1) ) continue;
+            const uint32_t off = i * PAGE;
+            last.pages.push_back(b * Memory::BANK_PAGES + i);
+            last.data.insert(last.data.end(), copy + off, copy + off + PAGE);
+            std::memcpy(copy + off, now + off, PAGE);
+         }
+      }
+      m_bytes += last.pages.size() * (sizeof(uint16_t) + PAGE);
+   }
+   m_checkpoints.push_back(Checkpoint{ m_cpu.ticks(), m_cpu, m_mem.mapping(), {}, {} });
+   m_bytes += sizeof(Checkpoint);
+   m_mem.clean();
+
+   while ( m_bytes > m_budget && m_checkpoints.size() > 1 ) {
+      drop(m_checkpoints.front());
+      m_bytes -= sizeof(Checkpoint);
+      m_checkpoints.pop_front();
+   }
+}
+
+//
+// Free the delta of cp
+//
+void
+Rewind::drop(Checkpoint& cp) {
+   m_bytes -= cp.pages.size() * (sizeof(uint16_t) + PAGE);
+   cp.pages = {};
+   cp.data  = {};
+}
+
+//
+// Restore the newest checkpoint at or before tick, and drop all newer
+// ones: RAM gets back the pages written since the newest checkpoint,
+// and then the deltas of older ones, newest first
+//
+void
+Rewind::restore(uint64_t tick) {
+   if ( tick < oldest() )
+      throw std::out_of_range("Rewind: Tick before the oldest checkpoint");
+
+   std::vector<uint64_t> dirty(m_mem.banks());
+   for (uint32_t b = 0; b < m_mem.banks(); ++b) dirty[b] = m_mem.dirty(b);
+   for (uint32_t b = 0; b < m_mem.banks(); ++b) {
+      if ( !dirty[b] ) continue;
+      uint8_t*       dst  = m_mem.bank(b);
+      const uint8_t* copy = &m_shadow[std::size_t(b) * Memory::PAGE_SIZE];
+      for (uint64_t d = dirty[b], i = 0; d; d >>= 1, ++i)
+         if ( d & 1 ) std::memcpy(dst + i * PAGE, copy + i * PAGE, PAGE);
+   }
+
+   while ( m_checkpoints.back().tick > tick ) {
+      m_bytes -= sizeof(Checkpoint);
+      m_checkpoints.pop_back();
+      Checkpoint& cp = m_checkpoints.back();
+      for (std::size_t i = 0; i < cp.pages.size(); ++i) {
+         const uint32_t b   = cp.pages[i] / Memory::BANK_PAGES;
+         const uint32_t off = cp.pages[i] % Memory::BANK_PAGES * PAGE;
+         std::memcpy(m_mem.bank(b) + off, &cp.data[i * PAGE], PAGE);
+         std::memcpy(&m_shadow[std::size_t(b) * Memory::PAGE_SIZE + off], &cp.data[i * PAGE], PAGE);
+      }
+      drop(cp);
+   }
+
+   const Checkpoint& cp = m_checkpoints.back();
+   m_mem.setMapping(cp.mapping);
+   m_cpu = cp.cpu;
+   m_mem.clean();
+}
+
+//
+// Bytes used per second of emulated time, at hz T-states per second
+//
+double
+Rewind::bytesPerSecond(uint64_t hz) const {
+   const uint64_t span = m_cpu.ticks() - oldest();
+   return span ? (double)bytes() * hz / span : 0;
+}
+
+} // Namespace Z80CPP
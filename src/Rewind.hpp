@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+
+namespace Z80CPP {
+
+//
+// Rewind: Checkpoints of a Z80 and its Memory, taken every period ticks
+// while running through it, to go back to any tick after the oldest one.
+// Every checkpoint has a copy of the Z80 (its whole state, see Z80) and
+// the page maps. RAM is kept as deltas: a copy of all banks as of the
+// newest checkpoint and, for every older one, the contents at its tick
+// of the 256-byte pages written until the next one (Memory tracks them).
+// The oldest checkpoints are dropped to keep them within budget bytes
+// (all but the copy of RAM, which is banks * 16K).
+//   rewindTo(tick) restores the nearest checkpoint before tick and runs
+// from it up to tick: T-state runs get there exactly, and instruction
+// runs to the first instruction boundary from tick on. Only the CPU and
+// Memory are rewound: devices must not change what the program does.
+// The Memory keeps its RAM banks while rewinding (no SaveState restores).
+//
+class Rewind {
+public:
+   Rewind(Z80& cpu, Memory& mem, uint64_t period, std::size_t budget);
+   ~Rewind()                      { m_mem.track(false); }
+
+   template <class BUS>
+   void        run(BUS& bus, uint64_t ticks);          // T-state engine
+   void        run(uint64_t ticks) { run(m_mem, ticks); }  // Instruction engine
+   template <class BUS>
+   void        rewindTo(BUS& bus, uint64_t tick);
+   void        rewindTo(uint64_t tick) { rewindTo(m_mem, tick); }
+   void        checkpoint();
+
+   std::size_t checkpoints() const { return m_checkpoints.size(); }
+   uint64_t    oldest() const      { return m_checkpoints.front().tick; }
+   std::size_t bytes() const       { return m_bytes + m_shadow.size(); }
+   double      bytesPerSecond(uint64_t hz) const;
+
+private:
+   struct Checkpoint {
+      uint64_t              tick;
+      Z80                   cpu;
+      Memory::Mapping       mapping;
+      std::vector<uint16_t> pages;   // Pages written until the next checkpoint (bank * 64 + page)
+      std::vector<uint8_t>  data;    // Their contents at tick
+   };
+   static constexpr uint32_t PAGE = Memory::PAGE_SIZE / Memory::BANK_PAGES;
+
+   template <class BUS>
+   void     step(BUS& bus, uint64_t ticks) { m_cpu.run(bus, ticks); }
+   void     step(Memory& mem, uint64_t ticks) { m_cpu.execute(mem, ticks); }
+   void     restore(uint64_t tick);
+   void     drop(Checkpoint& cp);
+
+   Z80&                   m_cpu;
+   Memory&                m_mem;
+   uint64_t               m_period;       // Ticks from a checkpoint to the next one
+   std::size_t            m_budget;       // Maximum bytes of checkpoints
+   std::size_t            m_bytes = 0;    // Bytes of checkpoints
+   std::deque<Checkpoint> m_checkpoints;  // Oldest first
+   std::vector<uint8_t>   m_shadow;       // All RAM banks, as of the newest checkpoint
+};
+
+//
+// Run ticks T-states (or instructions for at least ticks T-states, when
+// bus is the Memory), taking checkpoints when due
+//
+template <class BUS>
+inline void
+Rewind::run(BUS& bus, uint64_t ticks) {
+   const uint64_t end = m_cpu.ticks() + ticks;
+   while ( m_cpu.ticks() < end ) {
+      const uint64_t next = m_checkpoints.back().tick + m_period;
+      step(bus, std::min(end, next) - m_cpu.ticks());
+      if ( m_cpu.ticks() >= next ) checkpoint();
+   }
+}
+
+//
+// Go back (or forward) to tick. Throws std::out_of_range when it is
+// before the oldest checkpoint
+//
+template <class BUS>
+inline void
+Rewind::rewindTo(BUS& bus, uint64_t tick) {
+   if ( tick < m_cpu.ticks() ) restore(tick);
+   if ( tick > m_cpu.ticks() ) run(bus, tick - m_cpu.ticks());
+}
+
+} // Namespace Z80CPP
@@ -0,0 +1,171 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <SaveState.hpp>
+#include <MappedFile.hpp>
+
+namespace Z80CPP {
+
+//
+// Fingerprint of the T-state programs (FNV-1a of their layout), which
+// T-state positions index into
+//
+uint32_t
+SaveState::fingerprint() {
+   uint32_t h = 2166136261u;
+   auto mix = [&](uint32_t v) { for (int i = 0; i < 4; ++i, v >>= 8) h = (h ^ (v & 0xFF)) * 16777619u; };
+   mix(TProgramTable::programs);
+   mix(g_tprograms.used);
+   mix(sizeof(Registers));
+   for (const auto& p : g_tprograms.prg) mix(uint32_t(p.first) << 16 | p.length);
+   return h;
+}
+
+//
+// Write cpu and mem to file. Throws std::runtime_error when it fails
+//
+void
+SaveState::save(const std::string& file, const Z80& cpu, const Memory& mem) {
+   Header h {};
+   std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+   h.version    = VERSION;
+   h.tprograms  = fingerprint();
+   h.ticks      = cpu.m_ticks;
+   h.reg        = cpu.registers();
+   h.signals    = cpu.m_signals;
+   h.in_signals = cpu.m_in_signals;
+   h.address    = cpu.m_address;
+   h.tp         = cpu.m_tp;
+   h.tend       = cpu.m_tend;
+   h.fetch      = cpu.m_fetch;
+   h.data       = cpu.m_data;
+   h.space      = (uint8_t)cpu.m_space;
+   h.iff        = cpu.m_iff;
+   h.im         = cpu.m_im;
+   h.banks      = mem.banks();
+   for (uint8_t p = 0; p < Memory::PAGES; ++p) {
+      h.rdbank[p] = mem.m_rdbank[p];
+      h.wrbank[p] = mem.m_wrbank[p];
+   }
+
+   std::vector<char> header(ALIGN, 0);
+   std::memcpy(header.data(), &h, sizeof(h));
+   std::ofstream f(file, std::ios::binary | std::ios::trunc);
+   f.write(header.data(), header.size());
+   for (uint32_t b = 0; b < h.banks; ++b)
+      f.write(reinterpret_cast<const char*>(mem.bank(b)), Memory::PAGE_SIZE);
+   if ( !f ) throw std::runtime_error("SaveState: Could not write " + file);
+}
+
+//
+// Is file a save state?
+//
+bool
+SaveState::probe(const std::string& file) {
+   char magic[sizeof(MAGIC)] = {};
+   std::ifstream f(file, std::ios::binary);
+   return f.read(magic, sizeof(magic)) && !std::memcmp(magic, MAGIC, sizeof(MAGIC));
+}
+
+//
+// Header of a save state of size bytes, checked to be restorable
+//
+SaveState::Header
+SaveState::parse(const uint8_t* data, std::size_t size) {
+   Header h;
+   if ( size < ALIGN ) throw std::runtime_error("SaveState: File too short");
+   std::memcpy(&h, data, sizeof(h));
+   if ( std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) )
+      throw std::runtime_error("SaveState: Not a save state");
+   if ( h.version != VERSION )
+      throw std::runtime_error("SaveState: Unsupported version " + std::to_string(h.version));
+   if ( h.tprograms != fingerprint() )
+      throw std::runtime_error("SaveState: Saved by a build with different T-state programs");
+   if ( h.banks == 0 || size < ALIGN + (std::size_t)h.banks * Memory::PAGE_SIZE )
+      throw std::runtime_error("SaveState: RAM banks missing");
+   if ( h.tp > h.tend || h.tend > g_tprograms.used || h.fetch >= TProgramTable::programs
+     || h.space >= (uint8_t)Space::count || h.im > 2 || (h.iff & ~(Z80::IFF1 | Z80::IFF2 | Z80::IFF_EI)) )
+      throw std::runtime_error("SaveState: Corrupt CPU state");
+   // Pages read from a bank or an external pointer, and write to a bank,
+   // the sink or an external pointer
+   for (uint8_t p = 0; p < Memory::PAGES; ++p) {
+      if ( h.rdbank[p] >= (int32_t)h.banks || h.rdbank[p] < Memory::EXTERNAL
+        || h.wrbank[p] >= (int32_t)h.banks || h.wrbank[p] < Memory::SINK )
+         throw std::runtime_error("SaveState: Corrupt page map");
+   }
+   return h;
+}
+
+//
+// Restore cpu and mem from file. Throws std::runtime_error, leaving both
+// untouched, when it cannot be restored
+//
+void
+SaveState::restore(const std::string& file, Z80& cpu, Memory& mem) {
+   // Banks keep the file mapped, each one with its own count of owners
+   std::shared_ptr<MappedFile> map;
+   try {
+      map = std::make_shared<MappedFile>(file, true);
+   } catch (const std::runtime_error& e) {
+      throw std::runtime_error(std::string("SaveState: ") + e.what());
+   }
+   const Header h = parse(map->data(), map->size());
+   std::vector<std::shared_ptr<Memory::Bank>> banks;
+   for (uint32_t b = 0; b < h.banks; ++b) {
+      auto* bank = reinterpret_cast<Memory::Bank*>(map->data() + ALIGN + (std::size_t)b * Memory::PAGE_SIZE);
+      banks.emplace_back(bank, [map](Memory::Bank*) {});
+   }
+   restore(h, cpu);
+   restore(h, mem, std::move(banks));
+}
+
+//
+// CPU state. The engine is not changed
+//
+void
+SaveState::restore(const Header& h, Z80& cpu) {
+   if ( cpu.m_engine == Engine::Instruction && (h.tp != h.tend || h.space != (uint8_t)Space::Main) )
+      throw std::runtime_error("SaveState: Saved in the middle of an instruction (T-state engine only)");
+
+   cpu.m_ticks      = h.ticks;
+   cpu.setRegisters(h.reg);
+   cpu.m_signals    = h.signals;
+   cpu.m_in_signals = h.in_signals;
+   cpu.m_address    = h.address;
+   cpu.m_tp         = h.tp;
+   cpu.m_tend       = h.tend;
+   cpu.m_fetch      = h.fetch;
+   cpu.m_data       = h.data;
+   cpu.m_space      = (Space)h.space;
+   cpu.m_iff        = h.iff;
+   cpu.m_im         = h.im;
+}
+
+//
+// Memory gets banks and the saved page maps. Pages mapped to the
+// caller's memory keep the mapping they have (or map the RAM bank of
+// their number, if they have none). All watched code is invalidated
+//
+void
+SaveState::restore(const Header& h, Memory& mem, std::vector<std::shared_ptr<Memory::Bank>> banks) {
+   mem.m_ram = std::move(banks);
+
+   for (uint8_t p = 0; p < Memory::PAGES; ++p) {
+      int32_t rd = h.rdbank[p], wr = h.wrbank[p];
+      if ( rd == Memory::EXTERNAL && mem.m_rdbank[p] != Memory::EXTERNAL ) rd = p % h.banks;
+      if ( wr == Memory::EXTERNAL && mem.m_wrbank[p] != Memory::EXTERNAL ) wr = p % h.banks;
+
+      if ( rd >= 0 ) mem.m_rd[p] = mem.m_ram[rd]->data();
+      if ( wr == Memory::SINK ) {
+         if ( !mem.m_sink ) mem.m_sink = std::make_unique<uint8_t[]>(Memory::PAGE_SIZE);
+         mem.m_wr[p] = mem.m_sink.get();
+      }
+      mem.m_rdbank[p] = rd;
+      mem.m_wrbank[p] = wr;
+   }
+   // All of it changed, for write tracking
+   mem.m_dirty.assign(mem.m_ram.size(), mem.m_tracking ? ~uint64_t(0) : 0);
+   mem.reset();
+}
+
+} // Namespace Z80CPP
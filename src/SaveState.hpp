@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Z80.hpp>
+#include <Memory.hpp>
+
+namespace Z80CPP {
+
+//
+// SaveState: Binary snapshot of a Z80 and its Memory, in host byte order
+//    Header (4K): magic, version, fingerprint of g_tprograms, CPU state
+//                 (registers, pending T-state of the instruction in flight,
+//                 signals, buses, ticks, interrupt state) and page maps
+//    Banks:       every RAM bank (16K each), at 4K aligned offsets
+// Restoring maps the file private (copy-on-write, see MappedFile) and
+// RAM banks point into it: pages are only read from disk when touched,
+// and only copied when written, so restoring costs as much as parsing
+// the header.
+//   T-state positions are indexes into g_tprograms, so a snapshot is only
+// restored by builds with the same T-state programs. The engine is the
+// restoring Z80's own, but a T-state snapshot taken in the middle of an
+// instruction needs the T-state engine. Pages mapped to the caller's
+// memory (ROMs) are not saved: they keep the mapping of the Memory being
+// restored, so ROMs are mapped first. IO devices are not saved either.
+//
+class SaveState {
+public:
+   static constexpr char     MAGIC[8] = { 'Z', '8', '0', 'C', 'P', 'P', 'S', 'S' };
+   static constexpr uint32_t VERSION  = 1;
+   static constexpr uint32_t ALIGN    = 4096;   // Header size and bank alignment
+
+   static void save   (const std::string& file, const Z80& cpu, const Memory& mem);
+   static void restore(const std::string& file, Z80& cpu, Memory& mem);
+   static bool probe  (const std::string& file);
+
+private:
+   struct Header {
+      char      magic[8];
+      uint32_t  version;
+      uint32_t  tprograms;        // Fingerprint of g_tprograms
+      uint64_t  ticks;
+      Registers reg;
+      uint16_t  signals, in_signals, address;
+      uint16_t  tp, tend, fetch;  // T-state position
+      uint8_t   data, space, iff, im;
+      uint32_t  banks;            // RAM banks, from offset ALIGN onwards
+      int32_t   rdbank[Memory::PAGES];   // Bank of every page (or EXTERNAL, SINK)
+      int32_t   wrbank[Memory::PAGES];
+   };
+   static_assert(sizeof(Header) <= ALIGN, "SaveState: Header does not fit");
+
+   static uint32_t fingerprint();
+   static Header   parse(const uint8_t* data, std::size_t size);
+   static void     restore(const Header& h, Z80& cpu);
+   static void     restore(const Header& h, Memory& mem, std::vector<std::shared_ptr<Memory::Bank>> banks);
+};
+
+} // Namespace Z80CPP
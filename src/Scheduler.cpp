@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <Scheduler.hpp>
+
+namespace Z80CPP {
+
+Scheduler::EventId
+Scheduler::schedule(uint64_t tick, Callback cb) {
+   uint32_t slot;
+   if ( m_free.empty() ) {
+      slot = m_slots.size();
+      m_slots.emplace_back();
+   } else {
+      slot = m_free.back();
+      m_free.pop_back();
+   }
+   m_slots[slot].cb = std::move(cb);
+
+   m_heap.push_back(Event{tick, m_seq++, slot});
+   std::push_heap(m_heap.begin(), m_heap.end(), later);
+   ++m_pending;
+
+   return (EventId)m_slots[slot].gen << 32 | slot;
+}
+
+bool
+Scheduler::cancel(EventId id) {
+   // Slot remains in the heap until its tick, but it will not be called
+   uint32_t slot = id & 0xFFFFFFFF;
+   if ( slot >= m_slots.size() )  return false;
+   Slot& s = m_slots[slot];
+   if ( s.gen != (id >> 32) || !s.cb ) return false;
+   s.cb = nullptr;
+   --m_pending;
+   return true;
+}
+
+Scheduler::Event
+Scheduler::pop() {
+   std::pop_heap(m_heap.begin(), m_heap.end(), later);
+   Event e = m_heap.back();
+   m_heap.pop_back();
+   return e;
+}
+
+void
+Scheduler::dispatch(uint64_t now) {
+   while ( !m_heap.empty() && m_heap.front().tick <= now ) {
+      Event e = pop();
+
+      // Free the slot before calling, as the callback may schedule
+      Slot& s = m_slots[e.slot];
+      Callback cb = std::move(s.cb);
+      s.cb = nullptr;
+      ++s.gen;
+      m_free.push_back(e.slot);
+
+      if ( cb ) {
+         --m_pending;
+         cb(e.tick);
+      }
+   }
+}
+
+} // Namespace Z80CPP
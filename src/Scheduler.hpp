@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <Z80.hpp>
+
+namespace Z80CPP {
+
+//
+// Scheduler: Timestamp-ordered events keyed by Z80::ticks(). Devices 
+// register callbacks to be called at a given tick and the CPU runs 
+// uninterrupted from one event to the next, so devices cost nothing
+// between their events. Events due at the same tick are called in the
+// order they were scheduled. Callbacks receive the tick they were 
+// scheduled for and may schedule new events (i.e. periodic ones).
+//
+class Scheduler {
+public:
+   using Callback = std::function<void(uint64_t tick)>;
+   using EventId  = uint64_t;
+   static constexpr uint64_t NEVER = UINT64_MAX;
+
+   EventId     schedule(uint64_t tick, Callback cb);
+   bool        cancel(EventId id);
+   void        dispatch(uint64_t now);
+   uint64_t    next() const      { return m_heap.empty() ? NEVER : m_heap.front().tick; }
+   std::size_t pending() const   { return m_pending; }
+
+   template <class BUS>
+   uint64_t    run(Z80& cpu, BUS& bus, uint64_t max_ticks);
+
+private:
+   // Heap entries point to callback slots. Slot generations make 
+   // EventIds of already called or cancelled events invalid
+   struct Event { uint64_t tick; uint64_t seq; uint32_t slot; };
+   struct Slot  { Callback cb;   uint32_t gen = 0; };
+
+   static bool later(const Event& a, const Event& b) {
+      return a.tick > b.tick || (a.tick == b.tick && a.seq > b.seq);
+   }
+   Event    pop();
+
+   std::vector<Event>    m_heap;        // Min-heap by (tick, seq)
+   std::vector<Slot>     m_slots;       // Callbacks (empty when cancelled)
+   std::vector<uint32_t> m_free;        // Free slots
+   uint64_t              m_seq = 0;     // Scheduling order
+   std::size_t           m_pending = 0; // Events neither called nor cancelled
+};
+
+//
+// Run the cpu exactly max_ticks T-states, calling events when due. The 
+// CPU runs in slices from one event to the next one
+//
+template <class BUS>
+inline uint64_t
+Scheduler::run(Z80& cpu, BUS& bus, uint64_t max_ticks) {
+   const uint64_t start = cpu.ticks();
+   const uint64_t end   = start + max_ticks;
+
+   dispatch(start);
+   while ( cpu.ticks() != end ) {
+      uint64_t stop = ( next() < end ) ? next() : end;
+      cpu.run(bus, stop - cpu.ticks());
+      dispatch(cpu.ticks());
+   }
+   return cpu.ticks() - start;
+}
+
+} // Namespace Z80CPP
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <TraceDiff.hpp>
+#include <MappedFile.hpp>
+
+#ifdef __SSE2__
+   #include <emmintrin.h>
+#endif
+
+namespace Z80CPP {
+
+//
+// Offset of the first byte where a and b differ (size if none)
+//
+std::size_t
+TraceDiff::mismatch(const uint8_t* a, const uint8_t* b, std::size_t size) {
+   std::size_t i = 0;
+#ifdef __SSE2__
+   for (; i + 64 <= size; i += 64) {
+      auto eq = [&](std::size_t o) {
+         return _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + o)),
+                               _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + o)));
+      };
+      const __m128i e = _mm_and_si128(_mm_and_si128(eq(0), eq(16)), _mm_and_si128(eq(32), eq(48)));
+      if ( _mm_movemask_epi8(e) != 0xFFFF ) break;
+   }
+#else
+   for (; i + 64 <= size && !std::memcmp(a + i, b + i, 64); i += 64);
+#endif
+   while ( i < size && a[i] == b[i] ) ++i;
+   return i;
+}
+
+//
+// Compare the mapped traces, then decode both from the chunk before the
+// first different byte (for context) until their records differ
+//
+TraceDiff::Result
+TraceDiff::diff(const std::string& a, const std::string& b, unsigned context) {
+   BusTrace::Reader ra(a), rb(b);
+   const MappedFile& fa = ra.file();
+   const MappedFile& fb = rb.file();
+   Result res;
+   res.offset = mismatch(fa.data(), fb.data(), std::min(fa.size(), fb.size()));
+   if ( res.offset == fa.size() && fa.size() == fb.size() ) return res;
+
+   // Both files are equal up to offset, so are their chunks
+   const std::size_t at    = ra.chunkOf(res.offset);
+   const std::size_t start = ( at > BusTrace::HEADER ) ? ra.chunkOf(at - 1) : at;
+   ra.seek(start);
+   rb.seek(start);
+
+   std::deque<BusTrace::Record> before;
+   BusTrace::Record x, y;
+   bool hx, hy;
+   for (;;) {
+      hx = ra.next(x);
+      hy = rb.next(y);
+      if ( !hx || !hy || x != y ) break;
+      before.push_back(x);
+      if ( before.size() > context ) before.pop_front();
+   }
+
+   // Pins hold from a record to the next one: they first differ at the
+   // first of the different records, or past the end of a trace
+   const uint64_t ta = hx ? x.tick : ra.end() + 1;
+   const uint64_t tb = hy ? y.tick : rb.end() + 1;
+   if ( !hx && !hy && ta == tb ) return res;
+   res.equal = false;
+   res.tick  = std::min(ta, tb);
+
+   res.a.assign(before.begin(), before.end());
+   res.b.assign(before.begin(), before.end());
+   for (unsigned i = 0; i < context && hx; ++i, hx = ra.next(x)) res.a.push_back(x);
+   for (unsigned i = 0; i < context && hy; ++i, hy = rb.next(y)) res.b.push_back(y);
+   return res;
+}
+
+} // Namespace Z80CPP
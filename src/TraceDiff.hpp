@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <BusTrace.hpp>
+
+namespace Z80CPP {
+
+//
+// TraceDiff: First T-state where the pins of two bus traces (BusTrace
+// files, e.g. from different builds or engines) differ, with the
+// records around it in both. The mapped files are compared 64 bytes at
+// a time (SSE2 where available) without decoding: traces with equal
+// records are equal byte for byte, so only the chunks around the first
+// different byte get decoded. Errors throw std::runtime_error
+//
+class TraceDiff {
+public:
+   struct Result {
+      bool        equal  = true;
+      uint64_t    tick   = 0;   // First T-state whose pins differ (or only one trace has)
+      std::size_t offset = 0;   // First different byte
+      std::vector<BusTrace::Record> a, b;   // Records around tick (up to context before and after)
+   };
+
+   static Result      diff(const std::string& a, const std::string& b, unsigned context = 8);
+   static std::size_t mismatch(const uint8_t* a, const uint8_t* b, std::size_t size);
+};
+
+} // Namespace Z80CPP
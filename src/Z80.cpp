@@ -1,4 +1,5 @@
 #include <Z80.hpp>
+#include <Bus.hpp>
 
 namespace Z80CPP {
 
@@ -7,312 +8,256 @@ Z80::exe_JP_IrpI(uint16_t& reg) {
    m_reg.PC = reg;
 }
 
-void 
-Z80::exe_POP_rp(uint8_t& rhi, uint8_t& rlo) {
-   m_ops.addM45Read( m_reg.SP, rlo, TZ80Op(&Z80::inc, m_reg.SP) );
-   m_ops.addM45Read( m_reg.SP, rhi, TZ80Op(&Z80::inc, m_reg.SP) );
-}
-
-void 
-Z80::exe_PUSH_rp(uint8_t& rhi, uint8_t& rlo) {
-   m_ops.extendM    ( TZ80Op(&Z80::dec, m_reg.SP) );
-   m_ops.addM45Write( m_reg.SP, rhi, TZ80Op(&Z80::dec, m_reg.SP) );
-   m_ops.addM45Write( m_reg.SP, rlo ); 
+void
+Z80::exe_HALT() {
+   m_fetch = TProgramTable::PRG_HALT;
 }
 
-
-void 
-Z80::exe_JP_nn() {
-   m_ops.addM23Read     (m_reg.PC, m_reg.Z, TZ80Op(&Z80::inc, m_reg.PC));
-   m_ops.addM3ReadAssign(m_reg.PC, m_reg.W, m_reg.PC, m_reg.WZ);
-} 
-
-
-void 
-Z80::exe_JR_n() {
-   m_ops.addM23Read(m_reg.PC, m_data, TZ80Op(&Z80::inc, m_reg.PC));
-   m_ops.addM3alu(2, TZ80Op(&Z80::assign, m_reg.BUF, m_reg.PC));
-   m_ops.addM3alu(1, TZ80Op(&Z80::add,    m_reg.BUF, m_data));
-   m_ops.addM3alu(1, TZ80Op(&Z80::assign, m_reg.WZ,  m_reg.BUF));
-   m_ops.addM3alu(1, TZ80Op(&Z80::assign, m_reg.PC,  m_reg.WZ));   
+void
+Z80::exe_LD_r_r(uint8_t& rd, uint8_t& rs) {
+   rd = rs;
 }
 
-void 
-Z80::exe_LD_r_n(uint8_t& reg) {
-   m_ops.addM23Read(m_reg.PC, reg, TZ80Op(&Z80::inc, m_reg.PC));
+void
+Z80::exe_LD_rp_rp (uint16_t& rd, uint16_t& rs) {
+   rd = rs;  
 }
 
-void 
-Z80::exe_LD_r_IrpI(uint8_t& rd8, uint16_t& rs16) {
-   m_ops.addM23Read(rs16, rd8);
+void
+Z80::exe_EX_rp_rp (uint16_t& r1, uint16_t& r2) {
+   uint16_t tmp = r1;
+   r1 = r2; r2 = tmp;
 }
 
-void 
-Z80::read2BytesFrom(uint8_t& rdhi, uint8_t& rdlo, uint16_t& rs16) {
-   m_ops.addM23Read (rs16, rdlo, TZ80Op(&Z80::inc, rs16));
-   m_ops.addM23Read (rs16, rdhi, TZ80Op(&Z80::inc, rs16));
+void
+Z80::exe_EX_AF_AF () {
+   evalF();
+   exe_EX_rp_rp(m_reg.main.AF, m_reg.alt.AF);
 }
 
-void 
-Z80::exe_LD_InnI_r(uint8_t& rs8) {
-   read2BytesFrom   (m_reg.W, m_reg.Z, m_reg.PC);
-   m_ops.addM45Write(m_reg.WZ, rs8, TZ80Op(&Z80::inc, m_reg.WZ));
+void
+Z80::exe_EXX () {
+   exe_EX_rp_rp(m_reg.main.BC, m_reg.alt.BC);
+   exe_EX_rp_rp(m_reg.main.DE, m_reg.alt.DE);
+   exe_EX_rp_rp(m_reg.main.HL, m_reg.alt.HL);
 }
 
-void 
-Z80::exe_LD_InnI_rp(uint8_t& rhi, uint8_t& rlo) {
-   read2BytesFrom   (m_reg.W, m_reg.Z, m_reg.PC);
-   m_ops.addM45Write(m_reg.WZ,     rlo, TZ80Op(&Z80::inc, m_reg.WZ));
-   m_ops.addM45Write(m_reg.WZ,     rhi, TZ80Op(&Z80::inc, m_reg.WZ));
+//
+// Interrupt flip-flops and mode. EI leaves IFF_EI set until the next
+// instruction boundary: no INT is accepted right after it
+//
+void
+Z80::exe_DI() {
+   m_iff = 0;
 }
 
-void 
-Z80::exe_LD_r_InnI(uint8_t& rd8) {
-   read2BytesFrom  (m_reg.W, m_reg.Z, m_reg.PC);
-   m_ops.addM23Read(m_reg.WZ,     rd8, TZ80Op(&Z80::inc, m_reg.WZ));
+void
+Z80::exe_EI() {
+   m_iff = IFF1 | IFF2 | IFF_EI;
 }
 
-void 
-Z80::exe_LD_rp_InnI(uint8_t& rhi, uint8_t& rlo) {
-   read2BytesFrom  (m_reg.W, m_reg.Z, m_reg.PC);
-   read2BytesFrom  (    rhi,     rlo, m_reg.WZ);
+void
+Z80::exe_IM(uint8_t mode) {
+   m_im = mode;
 }
 
-
+// RETN/RETI restore IFF1 from IFF2 (before returning)
 void
-Z80::exe_NOP () {}
+Z80::exe_RETN() {
+   m_iff = (m_iff & ~IFF1) | ((m_iff & IFF2) ? IFF1 : 0);
+}
 
+// RST p: Calls p (WZ), once PC is pushed
 void
-Z80::exe_HALT() {
-   m_nextM1 = &TVecOps::addHALTNOP;
+Z80::exe_RST(uint8_t addr) {
+   m_reg.WZ = addr;
 }
 
+//
+// 16-bit ADC/SBC HL, rp (ED opcodes). Their flags are computed at once
+//
 void
-Z80::exe_LD_r_r(uint8_t& rd, uint8_t& rs) {
-   rd = rs;
+Z80::adc16(uint16_t& rp) {
+   const FlagTables& t  = g_flagtables;
+   const uint16_t    hl = m_reg.main.HL, v = rp;
+   const uint32_t    r  = hl + v + carry();
+   const uint8_t     hv = ((hl & 0x8800) >> 11) | ((v & 0x8800) >> 10) | ((r & 0x8800) >> 9);
+   m_reg.WZ      = hl + 1;
+   m_reg.main.HL = r;
+   setF(((r >> 16) & Flag::C) | t.hAdd[hv & 7] | t.vAdd[hv >> 4]
+       | (t.sz53[uint8_t(r >> 8)] & ~Flag::Z) | (uint16_t(r) ? 0 : Flag::Z));
 }
 
 void
-Z80::exe_LD_rp_rp (uint16_t& rd, uint16_t& rs) {
-   rd = rs;  
+Z80::sbc16(uint16_t& rp) {
+   const FlagTables& t  = g_flagtables;
+   const uint16_t    hl = m_reg.main.HL, v = rp;
+   const uint32_t    r  = hl - v - carry();
+   const uint8_t     hv = ((hl & 0x8800) >> 11) | ((v & 0x8800) >> 10) | ((r & 0x8800) >> 9);
+   m_reg.WZ      = hl + 1;
+   m_reg.main.HL = r;
+   setF(((r >> 16) & Flag::C) | Flag::N | t.hSub[hv & 7] | t.vSub[hv >> 4]
+       | (t.sz53[uint8_t(r >> 8)] & ~Flag::Z) | (uint16_t(r) ? 0 : Flag::Z));
 }
 
-
-void 
-Z80::exe_LD_IrpI_r(uint16_t& rd16, uint8_t& rs8) {
-   m_ops.addM45Write(rd16, rs8);
+//
+// LD A, I / LD A, R. PV takes IFF2
+//
+void
+Z80::exe_LD_A_IR(uint8_t& reg) {
+   m_reg.main.A = reg;
+   setF(carry() | g_flagtables.sz53[reg] | ((m_iff & IFF2) ? Flag::PV : 0));
 }
 
+// RLD/RRD: Rotate nibbles of A and (HL), read into BFl
 void
-Z80::exe_LD_rp_nn(uint8_t& rhi, uint8_t& rlo) {
-   read2BytesFrom(rhi, rlo, m_reg.PC);
+Z80::exe_RLD() {
+   const uint8_t a = m_reg.main.A, m = m_reg.BFl;
+   m_reg.main.A = (a & 0xF0) | (m >> 4);
+   m_reg.BFl    = (m << 4)   | (a & 0x0F);
+   m_reg.WZ     = m_reg.main.HL + 1;
+   setF(carry() | g_flagtables.sz53p[m_reg.main.A]);
 }
 
-void 
-Z80::exe_LD_IrpI_n(uint16_t& reg) {
-   exe_LD_r_n   (m_reg.BFl);
-   exe_LD_IrpI_r(reg, m_reg.BFl);
+void
+Z80::exe_RRD() {
+   const uint8_t a = m_reg.main.A, m = m_reg.BFl;
+   m_reg.main.A = (a & 0xF0) | (m & 0x0F);
+   m_reg.BFl    = (a << 4)   | (m >> 4);
+   m_reg.WZ     = m_reg.main.HL + 1;
+   setF(carry() | g_flagtables.sz53p[m_reg.main.A]);
 }
 
-void
-Z80::exe_INC_rp (uint16_t& reg) {
-   m_ops.extendM(TZ80Op(&Z80::inc, reg));
-   m_ops.extendM();
+//
+// Block instructions LDI, CPI, LDD, CPD and their repeating forms 
+// (opcode op: ED A0/A1, A8/A9, B0/B1, B8/B9), once (HL) has been read
+// into BFl (and written to (DE) by LDs). Returns whether it repeats
+//
+bool
+Z80::blockOp(uint8_t op) {
+   using namespace Flag;
+   auto&          rm     = m_reg.main;
+   const uint16_t step   = ( op & 0x08 ) ? -1 : 1;
+   const bool     repeat = op & 0x10;
+   evalF();
+   const uint8_t  f      = rm.F;
+   --rm.BC;
+   rm.HL += step;
+   if ( !(op & 1) ) {
+      const uint8_t n = rm.A + m_reg.BFl;
+      rm.DE += step;
+      setF((f & (S | Z | C)) | (n & X3) | ((n << 4) & X5) | (rm.BC ? PV : 0));
+      return repeat && rm.BC;
+   }
+   const uint8_t r = rm.A - m_reg.BFl;
+   const uint8_t h = (rm.A ^ m_reg.BFl ^ r) & H;
+   const uint8_t n = r - (h ? 1 : 0);
+   m_reg.WZ += step;
+   setF((f & C) | N | h | (g_flagtables.sz53[r] & (S | Z)) | (n & X3) | ((n << 4) & X5) | (rm.BC ? PV : 0));
+   return repeat && rm.BC && r;
 }
 
+// T-state engine: Repetitions go on with 5 more T-states (PRG_REPEAT)
 void
-Z80::exe_DEC_rp (uint16_t& reg) {
-   m_ops.extendM(TZ80Op(&Z80::dec, reg));
-   m_ops.extendM();
+Z80::exe_block(uint8_t op) {
+   if ( blockOp(op) ) {
+      m_tp   = g_tprograms.begin(TProgramTable::PRG_REPEAT);
+      m_tend = g_tprograms.end  (TProgramTable::PRG_REPEAT);
+   }
 }
 
-void
-Z80::exe_EX_rp_rp (uint16_t& r1, uint16_t& r2) {
-   uint16_t tmp = r1;
-   r1 = r2; r2 = tmp;
+//
+// Block IO instructions INI, OUTI, IND, OUTD and their repeating forms
+// (opcode op: ED A2/A3, AA/AB, B2/B3, BA/BB), once the byte moved is in
+// BFl and B has been decremented. Flags come from B, and from the byte
+// added to C+1/C-1 (INs) or to L once stepped (OUTs) into k: N is bit 7
+// of the byte, H and C the carry of k, and PV the parity of (k & 7) ^ B.
+// Returns whether it repeats
+//
+bool
+Z80::ioBlockOp(uint8_t op) {
+   using namespace Flag;
+   auto&          rm   = m_reg.main;
+   const uint8_t  step = ( op & 0x08 ) ? -1 : 1;
+   const uint8_t  v    = m_reg.BFl;
+   rm.HL += (int8_t)step;
+   const uint16_t k    = v + ( (op & 1) ? rm.L : uint8_t(rm.C + step) );
+   setF(g_flagtables.sz53[rm.B] | ((v & 0x80) ? N : 0) | ((k > 0xFF) ? (H | C) : 0)
+       | (g_flagtables.sz53p[(k & 7) ^ rm.B] & PV));
+   return (op & 0x10) && rm.B;
 }
 
+// T-state engine: Repetitions go on with 5 more T-states moving PC back
+// (PRG_REPEAT_IO), which leave WZ as it is
 void
-Z80::exe_EX_ISPI_rp (uint16_t& rd16, uint8_t& rhi, uint8_t& rlo) {
-   m_reg.BUF = m_reg.SP + 1; // Should be done with WZ
-   m_ops.addM23Read (m_reg.SP , m_reg.Z);
-   m_ops.addM23Read (m_reg.BUF, m_reg.W);
-   m_ops.extendM();
-   m_ops.addM45Write(m_reg.BUF, rhi);
-   m_ops.addM45Write(m_reg.SP,  rlo);
-   m_ops.extendM( TZ80Op(&Z80::assign, rd16, m_reg.WZ) );
-   m_ops.extendM();
+Z80::exe_ioblock(uint8_t op) {
+   if ( ioBlockOp(op) ) {
+      m_tp   = g_tprograms.begin(TProgramTable::PRG_REPEAT_IO);
+      m_tend = g_tprograms.end  (TProgramTable::PRG_REPEAT_IO);
+   }
 }
 
-void
-Z80::exe_EXX () {
-   exe_EX_rp_rp(m_reg.main.BC, m_reg.alt.BC);
-   exe_EX_rp_rp(m_reg.main.DE, m_reg.alt.DE);
-   exe_EX_rp_rp(m_reg.main.HL, m_reg.alt.HL);
+//
+// Interrupt requested at an instruction boundary (INT/NMI input signals),
+// next being the program to run otherwise. Returns the acknowledge 
+// program of the interrupt accepted (next if none). NMI is always
+// accepted, INT only with IFF1 set and not right after EI. Accepting
+// one leaves HALT, resets the flip-flops and takes the request: as the
+// CPC Gate Array does, devices release their request on acknowledge.
+// Those holding it for a while (ZX Spectrum ULA: 32 T-states) release
+// it on their own (rstSignal()) if it has not been accepted by then.
+//    NMI:  PC is pushed and jumps to 0066h (WZ)
+//    IM 0: Runs the opcode on the data bus (only 1-byte ones: RST p)
+//    IM 1: PC is pushed and jumps to 0038h (WZ)
+//    IM 2: PC is pushed and jumps to the address read from I:vector 
+//          (I preset into BFh, the data bus vector goes to BFl)
+//
+uint16_t
+Z80::interrupt(uint16_t next) {
+   if ( m_space != Space::Main ) return next;
+   if ( m_in_signals & (uint16_t)Signal::NMI ) {
+      m_in_signals &= ~(uint16_t)Signal::NMI;
+      m_iff        &= ~IFF1;
+      m_fetch       = TProgramTable::PRG_M1;
+      m_reg.WZ      = 0x0066;
+      return TProgramTable::PRG_NMI;
+   }
+   if ( !(m_iff & IFF1) || (m_iff & IFF_EI) ) return next;
+   m_in_signals &= ~(uint16_t)Signal::INT;
+   m_iff         = 0;
+   m_fetch       = TProgramTable::PRG_M1;
+   if      ( m_im == 1 ) m_reg.WZ  = 0x0038;
+   else if ( m_im == 2 ) m_reg.BFh = m_reg.I;
+   return TProgramTable::PRG_IM0 + m_im;
 }
 
 void 
 Z80::decode() {
-   // Aliases for brevity
-   auto&  r     = m_reg;
-   auto&  rm    = r.main;
-   auto&  ra    = r.alt;
-
-   // Instruction jump table   
-   switch( m_data ) {
-      // Basics
-      case 0x00: exe_NOP      ();            break;
-      case 0x01: exe_LD_rp_nn (rm.B , rm.C); break;
-      case 0x02: exe_LD_IrpI_r(rm.BC, rm.A); break;
-      case 0x03: exe_INC_rp   (rm.BC);       break;
-      case 0x06: exe_LD_r_n   (rm.B );       break;
-      case 0x08: exe_EX_rp_rp (rm.AF, ra.AF);break;
-      case 0x0A: exe_LD_r_IrpI(rm.A ,rm.BC); break;
-      case 0x0B: exe_DEC_rp   (rm.BC);       break;
-      case 0x0E: exe_LD_r_n   (rm.C );       break;
-
-      case 0x11: exe_LD_rp_nn (rm.D , rm.E); break;
-      case 0x12: exe_LD_IrpI_r(rm.DE, rm.A); break;
-      case 0x13: exe_INC_rp   (rm.DE);       break;
-      case 0x16: exe_LD_r_n   (rm.D );       break;
-      case 0x18: exe_JR_n     ();            break;
-      case 0x1A: exe_LD_r_IrpI(rm.A ,rm.DE); break;
-      case 0x1B: exe_DEC_rp   (rm.DE);       break;
-      case 0x1E: exe_LD_r_n   (rm.E );       break;
-
-      case 0x21: exe_LD_rp_nn  (rm.H , rm.L);break;
-      case 0x22: exe_LD_InnI_rp(rm.H , rm.L);break;
-      case 0x23: exe_INC_rp    (rm.HL);      break;
-      case 0x26: exe_LD_r_n    (rm.H );      break;
-      case 0x2A: exe_LD_rp_InnI(rm.H , rm.L);break;
-      case 0x2B: exe_DEC_rp    (rm.HL);      break;
-      case 0x2E: exe_LD_r_n    (rm.L );      break;
-
-      case 0x31: exe_LD_rp_nn  ( r.S ,  r.P);break;
-      case 0x32: exe_LD_InnI_r (rm.A);       break;
-      case 0x33: exe_INC_rp    ( r.SP);      break;
-      case 0x36: exe_LD_IrpI_n (rm.HL);      break;
-      case 0x3A: exe_LD_r_InnI (rm.A);       break;
-      case 0x3B: exe_DEC_rp    ( r.SP);      break;
-      case 0x3E: exe_LD_r_n    (rm.A );      break;
-
-      // 0x40-0x47 [[ LD B, r ]]
-      case 0x40: exe_LD_r_r   (rm.B, rm.B ); break;
-      case 0x41: exe_LD_r_r   (rm.B, rm.C ); break;
-      case 0x42: exe_LD_r_r   (rm.B, rm.D ); break;
-      case 0x43: exe_LD_r_r   (rm.B, rm.E ); break;
-      case 0x44: exe_LD_r_r   (rm.B, rm.H ); break;
-      case 0x45: exe_LD_r_r   (rm.B, rm.L ); break;
-      case 0x46: exe_LD_r_IrpI(rm.B, rm.HL); break;
-      case 0x47: exe_LD_r_r   (rm.B, rm.A ); break;
-      // 0x48-0x4F [[ LD C, r ]]
-      case 0x48: exe_LD_r_r   (rm.C, rm.B ); break;
-      case 0x49: exe_LD_r_r   (rm.C, rm.C ); break;
-      case 0x4A: exe_LD_r_r   (rm.C, rm.D ); break;
-      case 0x4B: exe_LD_r_r   (rm.C, rm.E ); break;
-      case 0x4C: exe_LD_r_r   (rm.C, rm.H ); break;
-      case 0x4D: exe_LD_r_r   (rm.C, rm.L ); break;
-      case 0x4E: exe_LD_r_IrpI(rm.C, rm.HL); break;
-      case 0x4F: exe_LD_r_r   (rm.C, rm.A ); break;
-      // 0x50-0x57 [[ LD D, r ]]
-      case 0x50: exe_LD_r_r   (rm.D, rm.B ); break;
-      case 0x51: exe_LD_r_r   (rm.D, rm.C ); break;
-      case 0x52: exe_LD_r_r   (rm.D, rm.D ); break;
-      case 0x53: exe_LD_r_r   (rm.D, rm.E ); break;
-      case 0x54: exe_LD_r_r   (rm.D, rm.H ); break;
-      case 0x55: exe_LD_r_r   (rm.D, rm.L ); break;
-      case 0x56: exe_LD_r_IrpI(rm.D, rm.HL); break;
-      case 0x57: exe_LD_r_r   (rm.D, rm.A ); break;
-      // 0x50-0x57 [[ LD E, r ]]
-      case 0x58: exe_LD_r_r   (rm.E, rm.B ); break;
-      case 0x59: exe_LD_r_r   (rm.E, rm.C ); break;
-      case 0x5A: exe_LD_r_r   (rm.E, rm.D ); break;
-      case 0x5B: exe_LD_r_r   (rm.E, rm.E ); break;
-      case 0x5C: exe_LD_r_r   (rm.E, rm.H ); break;
-      case 0x5D: exe_LD_r_r   (rm.E, rm.L ); break;
-      case 0x5E: exe_LD_r_IrpI(rm.E, rm.HL); break;
-      case 0x5F: exe_LD_r_r   (rm.E, rm.A ); break;
-      // 0x60-0x67 [[ LD H, r ]]
-      case 0x60: exe_LD_r_r   (rm.H, rm.B ); break;
-      case 0x61: exe_LD_r_r   (rm.H, rm.C ); break;
-      case 0x62: exe_LD_r_r   (rm.H, rm.D ); break;
-      case 0x63: exe_LD_r_r   (rm.H, rm.E ); break;
-      case 0x64: exe_LD_r_r   (rm.H, rm.H ); break;
-      case 0x65: exe_LD_r_r   (rm.H, rm.L ); break;
-      case 0x66: exe_LD_r_IrpI(rm.H, rm.HL); break;
-      case 0x67: exe_LD_r_r   (rm.H, rm.A ); break;
-      // 0x68-0x6F [[ LD L, r ]]
-      case 0x68: exe_LD_r_r   (rm.L, rm.B ); break;
-      case 0x69: exe_LD_r_r   (rm.L, rm.C ); break;
-      case 0x6A: exe_LD_r_r   (rm.L, rm.D ); break;
-      case 0x6B: exe_LD_r_r   (rm.L, rm.E ); break;
-      case 0x6C: exe_LD_r_r   (rm.L, rm.H ); break;
-      case 0x6D: exe_LD_r_r   (rm.L, rm.L ); break;
-      case 0x6E: exe_LD_r_IrpI(rm.L, rm.HL); break;
-      case 0x6F: exe_LD_r_r   (rm.L, rm.A ); break;
-      // 0x70-0x77 [[ LD (HL), r ]]
-      case 0x70: exe_LD_IrpI_r(rm.HL, rm.B );break;
-      case 0x71: exe_LD_IrpI_r(rm.HL, rm.C );break;
-      case 0x72: exe_LD_IrpI_r(rm.HL, rm.D );break;
-      case 0x73: exe_LD_IrpI_r(rm.HL, rm.E );break;
-      case 0x74: exe_LD_IrpI_r(rm.HL, rm.H );break;
-      case 0x75: exe_LD_IrpI_r(rm.HL, rm.L );break;
-      case 0x76: exe_HALT();                 break;
-      case 0x77: exe_LD_IrpI_r(rm.HL, rm.A );break;
-      // 0x78-0x7F [[ LD A, r ]]
-      case 0x78: exe_LD_r_r   (rm.A, rm.B ); break;
-      case 0x79: exe_LD_r_r   (rm.A, rm.C ); break;
-      case 0x7A: exe_LD_r_r   (rm.A, rm.D ); break;
-      case 0x7B: exe_LD_r_r   (rm.A, rm.E ); break;
-      case 0x7C: exe_LD_r_r   (rm.A, rm.H ); break;
-      case 0x7D: exe_LD_r_r   (rm.A, rm.L ); break;
-      case 0x7E: exe_LD_r_IrpI(rm.A, rm.HL); break;
-      case 0x7F: exe_LD_r_r   (rm.A, rm.A ); break;
+   // Perform the decode-time operation of the opcode (in the space
+   // selected by prefixes) and continue with its static T-state 
+   // program (M1/T4 onwards)
+   const uint16_t  prg = TProgramTable::program(m_space, m_data);
+   const TProgram& p   = g_tprograms.prg[prg];
+   m_space = Space::Main;
+   m_iff  &= ~IFF_EI;
+   interpret(p.exec);
+   m_tp   = g_tprograms.begin(prg);
+   m_tend = g_tprograms.end  (prg);
+}
 
-      case 0xC1: exe_POP_rp    ( rm.B, rm.C);      break;
-      case 0xC3: exe_JP_nn     ();                 break;
-      case 0xC5: exe_PUSH_rp   ( rm.B, rm.C);      break;
-      
-      case 0xD1: exe_POP_rp    ( rm.D, rm.E);      break;
-      case 0xD5: exe_PUSH_rp   ( rm.D, rm.E);      break;
-      case 0xD9: exe_EXX       ();                 break;
-      
-      case 0xE1: exe_POP_rp    ( rm.H, rm.L);      break;
-      case 0xE3: exe_EX_ISPI_rp(rm.HL, rm.H, rm.L);break;
-      case 0xE5: exe_PUSH_rp   ( rm.H, rm.L);      break;      
-      case 0xE9: exe_JP_IrpI   (rm.HL);            break;
-      case 0xEB: exe_EX_rp_rp  (rm.DE, rm.HL);     break;
-      
-      case 0xF1: exe_POP_rp    ( rm.A, rm.F);      break;
-      case 0xF5: exe_PUSH_rp   ( rm.A, rm.F);      break;
-      case 0xF9: exe_LD_rp_rp  ( r.SP, rm.HL);     break;
-   }
+void
+Z80::perform(const TZ80Op& op) {
+   interpret(op);
 }
 
+//
+// Pin-level T-state: The outside world reads signals(), address() and
+// data() after every tick and drives memory, IO and WAIT on its own
+//
 void 
 Z80::tick() {
-   // When there are no machine operations
-   // pending, add a new M1 Cycle to fetch and decode
-   // next instruction
-   if ( m_ops.empty() )
-      (m_ops.*m_nextM1)();
-
-   // Now process next T-state in pending operations
-   const TState& t = m_ops.get();
-   m_signals = t.signals | m_in_signals;
-   m_address = *t.addr;
-   m_data    = *t.data;
-   
-   // If we are on a T-state that samples WAIT signal (WSAMP)
-   // And WAIT signal is activated, we should repeat this 
-   // T-state until WAIT goes OFF
-   if ( !signal(Signal::WSAMP) || !signal(Signal::WAIT)) {
-      m_ops.pop();
-      t.op(*this);
-   }
-   
-   // One more clock tick has passed (0.25 us at 4 Mhz)
-   ++m_ticks;
+   PinBus bus;
+   tick(bus);
 }
 
 } // Namespace Z80CPP
@@ -2,19 +2,52 @@
 
 #include <cstdint>
 #include <iostream>
+#include <array>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 #include <Z80_tqueue.hpp>
+#include <Flags.hpp>
 
 namespace Z80CPP {
 
 // Foward declares
 class Printer;
+class Memory;
+class IOPorts;
+template <unsigned LANES> class Lockstep;
+
+//
+// Engine: Execution engines available to a Z80 instance
+//   TState:      Pin-level emulation. Every tick() processes one T-state and
+//                the outside world drives memory through signals/buses
+//   Instruction: Every execute() runs a complete instruction, reading and
+//                writing Memory directly and adding its documented T-states
+//
+enum class Engine : uint8_t {
+      TState
+   ,  Instruction
+};
 
 //
 // Z80 CPU Class Declaration
+//   All of its state, including the pending T-states of an instruction
+// in flight, is held by value: registers are referenced by offset and
+// programs by index into g_tprograms. So a Z80 may be copied, memcpy'd
+// or moved anywhere at any tick, and the copy goes on on its own.
+//   Flags are lazy: ALU operations keep their operands and result in
+// m_lazy, and F is only computed when read (evalF). registers() always
+// shows it computed.
+//   IO goes through the bus on the T-state engine. The Instruction
+// engine reaches the IOPorts set with setPorts() instead (none: ports 
+// read FFh), which copies share.
 //
 class Z80 {
-   friend class TVecOps;
-   using FNextM1 = void(TVecOps::*)();
+   friend class  TProgramBuilder;
+   friend struct TZ80Op;
+   template <unsigned LANES> friend class Lockstep;
+   friend class  Jit;
+   friend class  SaveState;
 
    // Member variables
    uint16_t   m_signals    = 0;  // Signal pins information (Positive logic (1=ON))
@@ -22,54 +55,84 @@ class Z80 {
    uint16_t   m_address = 0;     // Address Bus information
    uint8_t    m_data    = 0;     // Data Bus information 
    uint64_t   m_ticks   = 0;     // Total ticks of operation transcurred
-   Registers  m_reg;             // Register Banks
-   TVecOps    m_ops = TVecOps(*this);     // Queue of pending operations
-   FNextM1    m_nextM1 = &TVecOps::addM1; // Next M1 Cycle operation to perform (for halt situations)
+   mutable Registers m_reg;      // Register Banks (F computed on read, see evalF)
+   mutable LazyFlags m_lazy;     // Last ALU operation, not yet in F
+   uint16_t   m_tp      = 0;     // Next T-state to process (index into g_tprograms.ts)
+   uint16_t   m_tend    = 0;     // End of the TProgram being processed
+   uint16_t   m_fetch   = TProgramTable::PRG_M1; // Next fetch program to perform (for halt situations)
+   Space      m_space   = Space::Main;           // Space the next opcode is decoded from (after a prefix)
+   Engine     m_engine  = Engine::TState;        // Execution engine selected for this instance
+   uint8_t    m_iff     = 0;     // Interrupt flip-flops (IFF1, IFF2) and EI just executed (IFF_EI)
+   uint8_t    m_im      = 0;     // Interrupt mode (0-2)
+   IOPorts*   m_ports   = nullptr; // IO devices of the Instruction engine
 
-   // Private member functions
-
-   void  read2BytesFrom(uint8_t& rdhi, uint8_t& rdlo, uint16_t& rs16);
+   // Bits of m_iff, and input signals requesting interrupts
+   static constexpr uint8_t  IFF1   = 0x01;
+   static constexpr uint8_t  IFF2   = 0x02;
+   static constexpr uint8_t  IFF_EI = 0x04;
+   static constexpr uint16_t INTERRUPTS = (uint16_t)Signal::INT | (uint16_t)Signal::NMI;
 
-   // Z80 Instructions (Execution)
+   // Private member functions
+   inline void interpret(const TZ80Op& op);
+   template <class BUS>
+   void        tstate(BUS& bus, uint64_t limit);
+   template <class BUS>
+   void        access(BUS& bus);
+   template <class BUS>
+   uint64_t    skipIdle(BUS& bus, uint64_t limit);
+   const IdleLoop* idleLoop() const;
+   uint16_t    interrupt(uint16_t next);
+   void        acknowledge(Memory& mem, uint16_t prg);
+   uint8_t&   reg8 (Reg8  r) { return reinterpret_cast<uint8_t*>(&m_reg)[r.off]; }
+   uint16_t&  reg16(Reg16 r) { return *reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(&m_reg) + r.off); }
 
-   // Basic
-   void  exe_NOP       (); 
+   // Z80 Instructions (Execution at decode time)
    void  exe_HALT      ();
    void  exe_EX_rp_rp  (uint16_t& r1, uint16_t& r2);
    void  exe_EXX       ();
-   void  exe_EX_ISPI_rp(uint16_t& rd16, uint8_t& rhi, uint8_t& rlo);
-   // Load
    void  exe_LD_r_r    (uint8_t& rd, uint8_t& rs);
    void  exe_LD_rp_rp  (uint16_t& rd, uint16_t& rs);
-   void  exe_LD_r_n    (uint8_t& reg);
-   void  exe_LD_r_InnI (uint8_t& rd8);
-   void  exe_LD_r_IrpI (uint8_t& rd8, uint16_t& rs16);
-   void  exe_LD_rp_nn  (uint8_t& rhi, uint8_t& rlo);
-   void  exe_LD_rp_InnI(uint8_t& rhi, uint8_t& rlo);
-   void  exe_LD_IrpI_n (uint16_t& reg);
-   void  exe_LD_IrpI_r (uint16_t& rd16, uint8_t& rs8);
-   void  exe_LD_InnI_r (uint8_t& rs8);
-   void  exe_LD_InnI_rp(uint8_t& rhi, uint8_t& rlo);
-
-   // INC/DEC
-   void  exe_INC_rp (uint16_t& reg);
-   void  exe_DEC_rp (uint16_t& reg);
-
-   // PUSH/POP
-   void  exe_PUSH_rp(uint8_t& rhi, uint8_t& rlo);
-   void  exe_POP_rp (uint8_t& rhi, uint8_t& rlo);
-
-   // JUMP
-   void  exe_JR_n ();
-   void  exe_JP_nn();
-   void  exe_JP_IrpI(uint16_t& reg);
-
-   // Private API for friend class
-   Registers& registers_r() { return m_reg;     }
-   uint8_t&   data_r()      { return m_data;    }
-   uint16_t&  address_r()   { return m_address; }
+   void  exe_JP_IrpI   (uint16_t& reg);
+   void  exe_EX_AF_AF  ();
+   void  exe_evalF     ()        { evalF(); }
+   void  exe_RLCA      ()        { evalF(); m_reg.main.AF = AccOps::rlca(m_reg.main.AF); }
+   void  exe_RRCA      ()        { evalF(); m_reg.main.AF = AccOps::rrca(m_reg.main.AF); }
+   void  exe_RLA       ()        { evalF(); m_reg.main.AF = AccOps::rla (m_reg.main.AF); }
+   void  exe_RRA       ()        { evalF(); m_reg.main.AF = AccOps::rra (m_reg.main.AF); }
+   void  exe_DAA       ()        { evalF(); m_reg.main.AF = AccOps::daa (m_reg.main.AF); }
+   void  exe_CPL       ()        { evalF(); m_reg.main.AF = AccOps::cpl (m_reg.main.AF); }
+   void  exe_SCF       ()        { evalF(); m_reg.main.AF = AccOps::scf (m_reg.main.AF); }
+   void  exe_CCF       ()        { evalF(); m_reg.main.AF = AccOps::ccf (m_reg.main.AF); }
+   void  exe_NEG       ()        { m_lazy = LazyFlags::of(ALU::SUB, 0, m_reg.main.A); m_reg.main.A = m_lazy.result(); }
+   void  exe_LD_A_IR   (uint8_t& reg);
+   void  exe_RLD       ();
+   void  exe_RRD       ();
+   void  exe_block     (uint8_t op);
+   void  exe_repeat    ()        { m_reg.PC -= 2; m_reg.WZ = m_reg.PC + 1; }
+   void  exe_ioblock   (uint8_t op);
+   void  exe_DI        ();
+   void  exe_EI        ();
+   void  exe_IM        (uint8_t mode);
+   void  exe_RETN      ();
+   void  exe_RST       (uint8_t addr);
+   bool  blockOp       (uint8_t op);
+   bool  ioBlockOp     (uint8_t op);
+   uint8_t portIn      (uint16_t port);
+   void  portOut       (uint16_t port, uint8_t data);
+
+   // Lazy flags: F up to date (after ALU operations), and carry alone
+   void     evalF() const {
+      if ( m_lazy.op != ALU::NONE ) {
+         m_reg.main.F = m_lazy.flags(m_reg.main.F);
+         m_lazy.op    = ALU::NONE;
+      }
+   }
+   uint8_t  carry() const        { return m_lazy.carry(m_reg.main.F); }
+   void     setF(uint8_t f)      { m_reg.main.F = f; m_lazy.op = ALU::NONE; }
+
 public:
    Z80() = default;
+   explicit Z80(Engine e) : m_engine(e) {}
    void     setData(uint8_t in)     { m_data = in; }
    void     setSignal(Signal s)     { m_in_signals |=  (uint16_t)s; }
    void     rstSignal(Signal s)     { m_in_signals &= ~(uint16_t)s; }
@@ -80,21 +143,491 @@ public:
    uint64_t ticks() const           { return m_ticks; }
    void     setPC(uint16_t pc)      { m_reg.PC = pc;  }
    uint16_t pc() const              { return m_reg.PC;  }
-   const Registers& registers() const { return m_reg; }
+   const Registers& registers() const { evalF(); return m_reg; }
+   void     setRegisters(const Registers& r) { m_reg = r; m_lazy.op = ALU::NONE; }
+   Engine   engine() const          { return m_engine; }
+   void     setPorts(IOPorts* p)    { m_ports = p; }
+   IOPorts* ports() const           { return m_ports; }
+   void     setEngine(Engine e)     { m_engine = e; }  // Only at instruction boundaries!
+   bool     halted() const          { return m_fetch == TProgramTable::PRG_HALT; }
+   bool     atInstructionBoundary() const { return m_tp == m_tend && m_space == Space::Main; }
+   bool     iff1() const            { return m_iff & IFF1; }
+   bool     iff2() const            { return m_iff & IFF2; }
+   uint8_t  im() const              { return m_im; }
+   void     setIFF(bool iff1, bool iff2) { m_iff = (iff1 ? IFF1 : 0) | (iff2 ? IFF2 : 0); }
+   void     setIM(uint8_t mode)     { m_im = mode % 3; }
+   bool     afterEI() const         { return m_iff & IFF_EI; }  // Last instruction was EI
+   // An interrupt request may be accepted at the next instruction boundary
+   bool     interruptPending() const {
+      return (m_in_signals & (uint16_t)Signal::NMI)
+          || ((m_in_signals & (uint16_t)Signal::INT) && (m_iff & IFF1));
+   }
 
    // Processing operations
    void  decode();
-   void  inc7(uint8_t& reg)      { reg = (reg+1) & 0x7F; }
+   void  inc7(uint8_t& reg)      { reg = (reg & 0x80) | ((reg+1) & 0x7F); }
    void  inc(uint8_t& reg)       { ++reg; }
    void  inc(uint16_t& reg)      { ++reg; }
+   void  dec(uint8_t& reg)       { --reg; }
    void  dec(uint16_t& reg)      { --reg; }
+   void  set(uint8_t& reg, uint8_t v)       { reg = v; }
    void  assign(uint8_t& rd, uint8_t& rs)   { rd = rs; }
    void  assign(uint16_t& rd, uint16_t& rs) { rd = rs; }
    void  data_in(uint8_t& reg)   { reg = m_data;  }
    void  data_in_assign(uint8_t& rin, uint16_t& rd, uint16_t& rs) { data_in(rin); assign(rd, rs); }
+   // IN r, (C): Flags from the value read, but carry
+   void  data_in_flags(uint8_t& reg) { data_in(reg); setF(carry() | g_flagtables.sz53p[reg]); }
    void  add(uint16_t& reg, uint8_t& offset){ reg += (int8_t)offset; }
+   void  alu8(ALU op, uint8_t v) {
+      const uint8_t cin = ( op == ALU::ADC || op == ALU::SBC ) ? carry() : 0;
+      m_lazy = LazyFlags::of(op, m_reg.main.A, v, cin);
+      m_reg.main.A = m_lazy.result();
+   }
+   template <ALU OP>
+   void  alu(uint8_t& reg)       { alu8(OP, reg); }
+   template <ALU OP>
+   void  data_in_alu(uint8_t& reg) { data_in(reg); alu8(OP, reg); }
+   void  inc_alu(uint8_t& reg)   { m_lazy = LazyFlags::of(ALU::INC, reg, 0, carry()); reg = m_lazy.result(); }
+   void  dec_alu(uint8_t& reg)   { m_lazy = LazyFlags::of(ALU::DEC, reg, 0, carry()); reg = m_lazy.result(); }
+   void  prefix(uint8_t space)   { m_space = Space(space); }
+   // addr = base + d, d being the displacement read into the low byte of addr
+   void  displace(uint16_t& addr, uint16_t& base) { addr = base + (int8_t)(addr & 0xFF); }
+   void  cb(uint8_t& reg, uint8_t op);
+   void  adc16(uint16_t& rp);
+   void  sbc16(uint16_t& rp);
 
+   void  perform(const TZ80Op& op);
    void  tick();
+   template <class BUS>
+   void  tick(BUS& bus);
+
+   // Batched execution (T-state engine). They return ticks consumed
+   template <class BUS>
+   uint64_t run(BUS& bus, uint64_t max_ticks);
+   template <class BUS>
+   uint64_t runInstructions(BUS& bus, uint64_t n);
+   template <class BUS, class PRED>
+   uint64_t runUntil(BUS& bus, PRED pred, uint64_t max_ticks = UINT64_MAX);
+   void  execute(Memory& mem);
+   uint64_t execute(Memory& mem, uint64_t max_ticks);
+   uint64_t skipIdle(Memory& mem, uint64_t limit);
+
+   // Threaded code (BlockCache.hpp): every opcode has a handler that 
+   // runs it with its operand bytes already read from memory
+   using Threaded = void (*)(Z80& cpu, Memory& mem, const uint8_t* operands);
+   // Prefixes read the rest of their instruction from memory when run,
+   // and end their block
+   struct Decoded {
+      Threaded run;       // Handler
+      uint8_t  operands;  // Operand bytes after the opcode
+      bool     ends;      // Jumps, halts or prefixes (ends a basic block)
+      bool     writes;    // May write to memory
+      uint8_t  ticks;     // T-states taken (prefixes: followed by 00)
+   };
+   static const Decoded& decoded(uint8_t op);
+
+private:
+   // Instruction engine: handlers of every opcode of every space, in a 
+   // flat table indexed by TProgramTable::program(space, opcode)
+   using Handler = void (*)(Z80& cpu, Memory& mem);
+   static const std::array<Handler, TProgramTable::PRG_M1> s_handlers;
+
+   template <class IDX, uint8_t OP, class OPERAND>
+   void  instruction(Memory& mem, OPERAND n);
+   template <uint8_t OP>
+   void  instructionED(Memory& mem);
+   template <class IDX, uint8_t OP>
+   void  instructionCB(Memory& mem);
+   template <uint16_t PRG>
+   static void handler(Z80& cpu, Memory& mem);
+   template <std::size_t... PRGS>
+   static std::array<Handler, TProgramTable::PRG_M1> handlerTable(std::index_sequence<PRGS...>);
+   template <uint8_t OP>
+   static void threaded(Z80& cpu, Memory& mem, const uint8_t* operands);
+   template <std::size_t... OPS>
+   static std::array<Decoded, 256> decodedTable(std::index_sequence<OPS...>);
+};
+
+//
+// CB opcode op on reg: rotation or shift, BIT, RES or SET (bits 7-6) 
+// number y (bits 5-3). BIT on memory (bits 2-0 = 6) takes flags 5 and 3
+// from W, as in (HL) and (IX+d) forms
+//
+inline void
+Z80::cb(uint8_t& reg, uint8_t op) {
+   const uint8_t y   = (op >> 3) & 7;
+   const uint8_t bit = 1 << y;
+   switch( op >> 6 ) {
+      case 0: m_lazy = LazyFlags::shift(y, reg, carry()); reg = m_lazy.result(); break;
+      case 1: {
+         const uint8_t c   = carry();
+         const uint8_t src = ( (op & 7) == 6 ) ? m_reg.W : reg;
+         setF(c | Flag::H | (g_flagtables.sz53p[reg & bit] & ~(Flag::X5 | Flag::X3))
+                | (src & (Flag::X5 | Flag::X3)));
+         break;
+      }
+      case 2: reg &= ~bit; break;
+      case 3: reg |=  bit; break;
+   }
+}
+
+static_assert(std::is_trivially_copyable_v<Z80>, "Z80 state must be a flat copy");
+
+//
+// Handlers of all micro-operations, indexed by UOp
+//
+inline constexpr TZ80Op::Handler TZ80Op::handlers[] = {
+   #define Z80CPP_UOP_HANDLER(NAME, FP) TZ80Op::Handler(FP),
+   Z80CPP_UOPS(Z80CPP_UOP_HANDLER)
+   #undef Z80CPP_UOP_HANDLER
 };
 
+constexpr bool
+TZ80Op::Handler::operator==(const Handler& h) const {
+   if (m_type != h.m_type) return false;
+   switch(m_type) {
+      case Type::VOID:           return m_fv          == h.m_fv;
+      case Type::_1PU8Ref:       return m_f1u8r       == h.m_f1u8r;
+      case Type::_1PU16Ref:      return m_f1u16r      == h.m_f1u16r;
+      case Type::_2PU8Ref:       return m_f2u8r       == h.m_f2u8r;
+      case Type::_2PU16Ref:      return m_f2u16r      == h.m_f2u16r;
+      case Type::_2PU16U8Ref:    return m_f2u16u8r    == h.m_f2u16u8r;
+      case Type::_3PU8U16U16Ref: return m_f3u8u16u16r == h.m_f3u8u16u16r;
+      case Type::_1PImm:         return m_f1i         == h.m_f1i;
+      case Type::_2PU8RefImm:    return m_f2u8ri      == h.m_f2u8ri;
+      case Type::NOP:            break;
+   }
+   return true;
+}
+
+// UOp of a handler (Fails to compile when not registered in Z80CPP_UOPS)
+constexpr UOp
+TZ80Op::find(const Handler& h) {
+   static_assert(std::size(handlers) == (std::size_t)UOp::count);
+   for (uint8_t i = 0; i < std::size(handlers); ++i)
+      if (handlers[i] == h) return UOp(i);
+   throw "TZ80Op: Micro-operation not registered in Z80CPP_UOPS";
+}
+
+constexpr TZ80Op::TZ80Op( VOIDFp f ) 
+   : m_uop(find(Handler(f))) {}
+constexpr TZ80Op::TZ80Op( _1PU8RefFp f, Reg8 p ) 
+   : m_uop(find(Handler(f))), m_p1(p.off) {}
+constexpr TZ80Op::TZ80Op( _1PU16RefFp f, Reg16 p ) 
+   : m_uop(find(Handler(f))), m_p1(p.off) {}
+constexpr TZ80Op::TZ80Op( _2PU8RefFp f, Reg8 p1, Reg8 p2 ) 
+   : m_uop(find(Handler(f))), m_p1(p1.off), m_p2(p2.off) {}
+constexpr TZ80Op::TZ80Op( _2PU16RefFp f, Reg16 p1, Reg16 p2 ) 
+   : m_uop(find(Handler(f))), m_p1(p1.off), m_p2(p2.off) {}
+constexpr TZ80Op::TZ80Op( _2PU16U8RefFp f, Reg16 p1, Reg8 p2 ) 
+   : m_uop(find(Handler(f))), m_p1(p1.off), m_p2(p2.off) {}
+constexpr TZ80Op::TZ80Op( _3PU8U16U16RefFp f, Reg8 p1, Reg16 p2, Reg16 p3 ) 
+   : m_uop(find(Handler(f))), m_p1(p1.off), m_p2(p2.off), m_p3(p3.off) {}
+constexpr TZ80Op::TZ80Op( _1PImmFp f, uint8_t imm ) 
+   : m_uop(find(Handler(f))), m_p1(imm) {}
+constexpr TZ80Op::TZ80Op( _2PU8RefImmFp f, Reg8 p1, uint8_t imm ) 
+   : m_uop(find(Handler(f))), m_p1(p1.off), m_p2(imm) {}
+
+//
+// Micro-operation interpreter. Calls the member function each UOp stands
+// for directly, so that trivial ones (inc, assign, data_in...) get inlined
+// here, and the interpreter itself gets inlined into tick(BUS&). It uses a
+// portable switch by default. Building with Z80CPP_COMPUTED_GOTO switches
+// to threaded dispatch through a table of label addresses (GCC/Clang),
+// which measured slower for one micro-operation per T-state on GCC 12.
+//
+#if defined(Z80CPP_COMPUTED_GOTO) && !defined(__GNUC__)
+   #error "Z80CPP_COMPUTED_GOTO requires labels as values (GCC/Clang)"
+#endif
+
+inline void
+Z80::interpret(const TZ80Op& op) {
+   auto r8  = [this](uint8_t off) -> uint8_t&  { return reg8 (Reg8 {off}); };
+   auto r16 = [this](uint8_t off) -> uint16_t& { return reg16(Reg16{off}); };
+
+#ifdef Z80CPP_COMPUTED_GOTO
+   #define UOP(NAME) L_##NAME:
+   #define Z80CPP_UOP_LABEL(NAME, FP) __extension__ &&L_##NAME,
+   static const void* const s_labels[] = { Z80CPP_UOPS(Z80CPP_UOP_LABEL) };
+   #undef Z80CPP_UOP_LABEL
+   goto *s_labels[(uint8_t)op.uop()];
+#else
+   #define UOP(NAME) case UOp::NAME:
+   switch(op.uop()) {
+      case UOp::count: return;
+#endif
+
+   UOP(NOP)            return;
+   UOP(decode)         decode();                                      return;
+   UOP(inc7)           inc7(r8(op.p1()));                             return;
+   UOP(inc8)           inc(r8(op.p1()));                              return;
+   UOP(inc16)          inc(r16(op.p1()));                             return;
+   UOP(dec8)           dec(r8(op.p1()));                              return;
+   UOP(dec16)          dec(r16(op.p1()));                             return;
+   UOP(assign8)        assign(r8(op.p1()), r8(op.p2()));              return;
+   UOP(assign16)       assign(r16(op.p1()), r16(op.p2()));            return;
+   UOP(data_in)        data_in(r8(op.p1()));                          return;
+   UOP(data_in_assign) data_in_assign(r8(op.p1()), r16(op.p2()), r16(op.p3())); return;
+   UOP(data_in_flags)  data_in_flags(r8(op.p1()));                    return;
+   UOP(set8)           set(r8(op.p1()), op.p2());                     return;
+   UOP(add)            add(r16(op.p1()), r8(op.p2()));                return;
+   UOP(exe_HALT)       exe_HALT();                                    return;
+   UOP(exe_EX_rp_rp)   exe_EX_rp_rp(r16(op.p1()), r16(op.p2()));      return;
+   UOP(exe_EXX)        exe_EXX();                                     return;
+   UOP(exe_LD_r_r)     exe_LD_r_r(r8(op.p1()), r8(op.p2()));          return;
+   UOP(exe_LD_rp_rp)   exe_LD_rp_rp(r16(op.p1()), r16(op.p2()));      return;
+   UOP(exe_JP_IrpI)    exe_JP_IrpI(r16(op.p1()));                     return;
+   UOP(exe_EX_AF_AF)   exe_EX_AF_AF();                                return;
+   UOP(exe_evalF)      exe_evalF();                                   return;
+   UOP(exe_RLCA)       exe_RLCA();                                    return;
+   UOP(exe_RRCA)       exe_RRCA();                                    return;
+   UOP(exe_RLA)        exe_RLA();                                     return;
+   UOP(exe_RRA)        exe_RRA();                                     return;
+   UOP(exe_DAA)        exe_DAA();                                     return;
+   UOP(exe_CPL)        exe_CPL();                                     return;
+   UOP(exe_SCF)        exe_SCF();                                     return;
+   UOP(exe_CCF)        exe_CCF();                                     return;
+   UOP(inc_alu)        inc_alu(r8(op.p1()));                          return;
+   UOP(dec_alu)        dec_alu(r8(op.p1()));                          return;
+   UOP(alu_ADD)        alu<ALU::ADD>(r8(op.p1()));                    return;
+   UOP(alu_ADC)        alu<ALU::ADC>(r8(op.p1()));                    return;
+   UOP(alu_SUB)        alu<ALU::SUB>(r8(op.p1()));                    return;
+   UOP(alu_SBC)        alu<ALU::SBC>(r8(op.p1()));                    return;
+   UOP(alu_AND)        alu<ALU::AND>(r8(op.p1()));                    return;
+   UOP(alu_XOR)        alu<ALU::XOR>(r8(op.p1()));                    return;
+   UOP(alu_OR)         alu<ALU::OR >(r8(op.p1()));                    return;
+   UOP(alu_CP)         alu<ALU::CP >(r8(op.p1()));                    return;
+   UOP(data_in_ADD)    data_in_alu<ALU::ADD>(r8(op.p1()));            return;
+   UOP(data_in_ADC)    data_in_alu<ALU::ADC>(r8(op.p1()));            return;
+   UOP(data_in_SUB)    data_in_alu<ALU::SUB>(r8(op.p1()));            return;
+   UOP(data_in_SBC)    data_in_alu<ALU::SBC>(r8(op.p1()));            return;
+   UOP(data_in_AND)    data_in_alu<ALU::AND>(r8(op.p1()));            return;
+   UOP(data_in_XOR)    data_in_alu<ALU::XOR>(r8(op.p1()));            return;
+   UOP(data_in_OR)     data_in_alu<ALU::OR >(r8(op.p1()));            return;
+   UOP(data_in_CP)     data_in_alu<ALU::CP >(r8(op.p1()));            return;
+   UOP(prefix)         prefix(op.p1());                               return;
+   UOP(displace)       displace(r16(op.p1()), r16(op.p2()));          return;
+   UOP(cb)             cb(r8(op.p1()), op.p2());                      return;
+   UOP(adc16)          adc16(r16(op.p1()));                           return;
+   UOP(sbc16)          sbc16(r16(op.p1()));                           return;
+   UOP(exe_NEG)        exe_NEG();                                     return;
+   UOP(exe_LD_A_IR)    exe_LD_A_IR(r8(op.p1()));                      return;
+   UOP(exe_RLD)        exe_RLD();                                     return;
+   UOP(exe_RRD)        exe_RRD();                                     return;
+   UOP(exe_block)      exe_block(op.p1());                            return;
+   UOP(exe_repeat)     exe_repeat();                                  return;
+   UOP(exe_ioblock)    exe_ioblock(op.p1());                          return;
+   UOP(exe_DI)         exe_DI();                                      return;
+   UOP(exe_EI)         exe_EI();                                      return;
+   UOP(exe_IM)         exe_IM(op.p1());                               return;
+   UOP(exe_RETN)       exe_RETN();                                    return;
+   UOP(exe_RST)        exe_RST(op.p1());                              return;
+
+#ifndef Z80CPP_COMPUTED_GOTO
+   }
+#endif
+   #undef UOP
+}
+
+//
+// T-state driving a Bus policy (Bus.hpp). Serves the memory or IO access
+// requested by the resulting signals afterwards, exactly as an external
+// circuit reading the pins after tick() would. Everything is inlined 
+// into the caller, so a CPU+Bus loop compiles into a single hot loop.
+//
+template <class BUS>
+inline void
+Z80::tick(BUS& bus) {
+   tstate(bus, m_ticks + 1);
+}
+
+//
+// Process next T-state. At T-states sampling WAIT, the Bus gives the 
+// wait states to insert. When all of them fit before limit they just
+// pass and the T-state goes on. Otherwise, the T-state is held with 
+// WAIT ON until limit, and asked again next time. The WAIT pin is 
+// sampled tick by tick, holding the T-state one tick each time.
+//
+template <class BUS>
+inline void
+Z80::tstate(BUS& bus, uint64_t limit) {
+   // When current program has been completely processed,
+   // start next fetch program (M1 Cycle to fetch and decode 
+   // next instruction, or HALT NOP), or acknowledge an interrupt
+   // when requested (only checked here, at instruction boundaries)
+   if ( m_tp == m_tend ) {
+      uint16_t next = m_fetch;
+      if ( m_in_signals & INTERRUPTS ) next = interrupt(next);
+      m_tp   = g_tprograms.begin(next);
+      m_tend = g_tprograms.end  (next);
+   }
+
+   // Now process next T-state in the program
+   const TState& t = g_tprograms.ts[m_tp];
+   m_signals = t.signals | m_in_signals;
+   if ( t.addr != Reg::BUS16 ) m_address = reg16(t.addr);
+   if ( t.data != Reg::BUS8  ) m_data    = reg8 (t.data);
+   
+   // T-state sampling WAIT (WSAMP) with wait states from the Bus. When
+   // they do not fit before limit, hold the T-state with WAIT ON
+   if ( signal(Signal::WSAMP) && !signal(Signal::WAIT) ) {
+      if ( uint32_t waits = bus.waitStates(m_ticks, m_address) ) {
+         if ( limit - m_ticks <= waits ) {
+            m_signals |= (uint16_t)Signal::WAIT;
+            m_ticks    = limit - 1;
+         } else {
+            m_ticks   += waits;
+         }
+      }
+   }
+
+   // If we are on a T-state that samples WAIT signal (WSAMP)
+   // And WAIT signal is activated, we should repeat this 
+   // T-state until WAIT goes OFF
+   if ( !signal(Signal::WSAMP) || !signal(Signal::WAIT)) {
+      ++m_tp;
+      interpret(t.op);
+   }
+   
+   // One more clock tick has passed (0.25 us at 4 Mhz)
+   ++m_ticks;
+   access(bus);
+}
+
+//
+// Memory or IO access requested by current signals (M1+IORQ being the
+// interrupt acknowledge). IORQ stays active for several T-states, but
+// devices are accessed just once per cycle, at the T-state sampling
+// WAIT once released, so that reads with side effects happen only once
+//
+template <class BUS>
+inline void
+Z80::access(BUS& bus) {
+   if        ( signal(Signal::MREQ) ) {
+      if      ( signal(Signal::RD) ) bus.read (m_address, m_data);
+      else if ( signal(Signal::WR) ) bus.write(m_address, m_data);
+   } else if ( signal(Signal::IORQ) ) {
+      if ( !signal(Signal::WSAMP) || signal(Signal::WAIT) ) return;
+      if      ( signal(Signal::RD) ) bus.in   (m_address, m_data);
+      else if ( signal(Signal::WR) ) bus.out  (m_address, m_data);
+      else if ( signal(Signal::M1) ) bus.ack  (m_data);
+   }
+}
+
+//
+// Run exactly max_ticks T-states. Instructions leaving PC as it was
+// may be idle loops, which are fast-forwarded (skipIdle)
+//
+template <class BUS>
+inline uint64_t
+Z80::run(BUS& bus, uint64_t max_ticks) {
+   const uint64_t start = m_ticks;
+   const uint64_t end   = m_ticks + max_ticks;
+   uint32_t       from  = UINT32_MAX;   // PC at the start of the last program
+   while ( m_ticks != end ) {
+      if ( m_tp == m_tend ) {
+         if ( m_reg.PC == from && skipIdle(bus, end) ) continue;
+         from = m_reg.PC;
+      }
+      tstate(bus, end);
+   }
+   return m_ticks - start;
+}
+
+//
+// Idle loop the CPU is in, after an instruction that left PC as it was
+// (nullptr if none). Pending input signals may end it, so none counts
+// but an INT request with interrupts disabled
+//
+inline const IdleLoop*
+Z80::idleLoop() const {
+   if ( (m_in_signals & ~(uint16_t)Signal::INT) || interruptPending() ) return nullptr;
+   if ( m_space != Space::Main ) return nullptr;
+   for (const IdleLoop& l : g_idleLoops) {
+      if ( m_tend != l.end ) continue;
+      return ( l.opcode != 0xE9 || m_reg.main.HL == m_reg.PC ) ? &l : nullptr;
+   }
+   return nullptr;
+}
+
+//
+// Fast-forward of idle loops (T-state engine), at the end of a program 
+// that left PC as it was. The iterations of the idle loop fitting before
+// limit, all but the last one, are skipped: they only add their T-states
+// and refreshes, and leave everything else as the last one does, which
+// is run afterwards as usual. The Bus gets asked for their wait states,
+// but not to read. As those repeat every BUS::WAIT_PERIOD ticks, so do
+// iterations starting at the same tick modulo WAIT_PERIOD: once one 
+// does, whole cycles of them are skipped at once (Brent's cycle 
+// detection). Returns the T-states skipped
+//
+template <class BUS>
+inline uint64_t
+Z80::skipIdle(BUS& bus, uint64_t limit) {
+   const IdleLoop* loop = idleLoop();
+   if ( !loop ) return 0;
+
+   // End of an iteration starting at tick t
+   const uint16_t pc   = m_reg.PC;
+   auto           next = [&](uint64_t t) {
+      uint64_t waits = 0;
+      for (uint8_t i = 0; i < loop->samples; ++i)
+         waits += bus.waitStates(t + loop->wsamp[i] + waits, uint16_t(pc + i));
+      return t + loop->ticks + waits;
+   };
+
+   uint64_t t = m_ticks, n = 0, last = t;     // Now, iterations done, start of the last one
+   uint64_t ref = t, refn = 0, power = 1;     // Reference iteration for cycle detection
+   for (uint64_t u; (u = next(t)) <= limit; ) {
+      last = t; t = u; ++n;
+      if ( (t - ref) % BUS::WAIT_PERIOD == 0 ) {
+         // Same phase as the reference: whole cycles of t - ref ticks
+         // and n - refn iterations, leaving one to go on iterating
+         const uint64_t cycles = (limit - t) / (t - ref);
+         if ( cycles > 1 ) {
+            t += (cycles - 1) * (t - ref);
+            n += (cycles - 1) * (n - refn);
+            ref = t; refn = n; power = 1;
+         }
+      }
+      if ( n - refn == power ) { ref = t; refn = n; power <<= 1; }
+   }
+   if ( n < 2 ) return 0;
+
+   const uint64_t skipped = last - m_ticks;
+   m_ticks  = last;
+   m_reg.R  = (m_reg.R & 0x80) | ((m_reg.R + n - 1) & 0x7F);
+   return skipped;
+}
+
+//
+// Run n complete instructions (A HALT NOP counts as one). If called 
+// in the middle of an instruction, completing it counts as the first
+//
+template <class BUS>
+inline uint64_t
+Z80::runInstructions(BUS& bus, uint64_t n) {
+   const uint64_t start = m_ticks;
+   while ( n-- ) {
+      do { tstate(bus, UINT64_MAX); } while ( !atInstructionBoundary() );
+   }
+   return m_ticks - start;
+}
+
+//
+// Run complete instructions until pred(const Z80&) returns true after
+// one of them, or until max_ticks have passed (which may be surpassed
+// by up to one instruction). A breakpoint at the current PC does not
+// stop the run immediately, as at least one instruction is executed.
+//
+template <class BUS, class PRED>
+inline uint64_t
+Z80::runUntil(BUS& bus, PRED pred, uint64_t max_ticks) {
+   const uint64_t start = m_ticks;
+   do {
+      do { tstate(bus, UINT64_MAX); } while ( !atInstructionBoundary() );
+   } while ( !pred(static_cast<const Z80&>(*this)) && m_ticks - start < max_ticks );
+   return m_ticks - start;
+}
+
 } // Namespace Z80CPP
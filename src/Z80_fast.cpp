@@ -0,0 +1,520 @@
+#include <Z80.hpp>
+#include <Memory.hpp>
+#include <IOPorts.hpp>
+
+namespace Z80CPP {
+
+//
+// Instruction-granular engine: executes one complete instruction
+// per call. Memory is read and written directly and m_ticks grows
+// by the documented T-states of the instruction. Internal registers
+// (WZ, BUF) are left exactly as the T-state engine leaves them, so
+// both engines produce identical Registers after every instruction.
+//
+void
+Z80::execute(Memory& mem) {
+   // Interrupt requests are accepted before the next instruction
+   uint16_t prg = m_fetch;
+   if ( m_in_signals & INTERRUPTS ) prg = interrupt(prg);
+   m_iff &= ~IFF_EI;
+   if ( prg >= TProgramTable::PRG_NMI ) { acknowledge(mem, prg); return; }
+
+   // HALT: Keep performing NOPs (4 T-states, refreshing memory)
+   if ( halted() ) {
+      inc7(m_reg.R);
+      m_ticks += 4;
+      return;
+   }
+
+   // M1: Fetch opcode and refresh
+   uint8_t op = mem.read(m_reg.PC++);
+   inc7(m_reg.R);
+   s_handlers[op](*this, mem);
+}
+
+//
+// Acknowledge of the interrupt accepted (interrupt() gave its program
+// prg), as the T-state engine does. There is no bus, so the data bus
+// reads FFh: IM 0 runs RST 38h and IM 2 reads its address from I:FFh
+//
+void
+Z80::acknowledge(Memory& mem, uint16_t prg) {
+   auto& r = m_reg;
+   inc7(r.R);
+   if ( prg == TProgramTable::PRG_IM0 ) { m_ticks += 2; s_handlers[0xFF](*this, mem); return; }
+   mem.write(--r.SP, r.PCh);
+   mem.write(--r.SP, r.PCl);
+   if ( prg == TProgramTable::PRG_IM2 ) {
+      r.BFl = 0xFF;
+      r.Z   = mem.read(r.BUF++);
+      r.W   = mem.read(r.BUF);
+   }
+   r.PC = r.WZ;
+   m_ticks += ( prg == TProgramTable::PRG_NMI ) ? 11 : ( prg == TProgramTable::PRG_IM1 ) ? 13 : 19;
+}
+
+//
+// IO accesses of the Instruction engine, to the IOPorts set (if any)
+//
+uint8_t
+Z80::portIn(uint16_t port) {
+   return m_ports ? m_ports->in(port) : 0xFF;
+}
+
+void
+Z80::portOut(uint16_t port, uint8_t data) {
+   if ( m_ports ) m_ports->out(port, data);
+}
+
+//
+// Run complete instructions for at least max_ticks T-states (surpassing
+// them by up to one instruction). Instructions leaving PC as it was may
+// be idle loops, which are fast-forwarded (skipIdle)
+//
+uint64_t
+Z80::execute(Memory& mem, uint64_t max_ticks) {
+   const uint64_t start = m_ticks;
+   while ( m_ticks - start < max_ticks ) {
+      const uint16_t pc = m_reg.PC;
+      execute(mem);
+      if ( m_reg.PC == pc ) skipIdle(mem, start + max_ticks);
+   }
+   return m_ticks - start;
+}
+
+//
+// Fast-forward of idle loops (Instruction engine), right after an
+// instruction that left PC as it was. When it is an idle loop (the HALT
+// NOP, JR $, JP $ or JP (HL)), all the iterations execute() would run
+// before reaching limit are done at once, adding their T-states and 
+// refreshes. Returns the T-states skipped
+//
+uint64_t
+Z80::skipIdle(Memory& mem, uint64_t limit) {
+   if ( m_ticks >= limit || interruptPending() ) return 0;
+   const uint8_t op = halted() ? 0x76 : mem.read(m_reg.PC);
+   for (const IdleLoop& l : g_idleLoops) {
+      if ( l.opcode != op ) continue;
+      const uint64_t n = (limit - m_ticks + l.ticks - 1) / l.ticks;
+      m_ticks += n * l.ticks;
+      m_reg.R  = (m_reg.R & 0x80) | ((m_reg.R + n) & 0x7F);
+      return n * l.ticks;
+   }
+   return 0;
+}
+
+//
+// Rest of instruction OP of Main space (or DD/FD spaces, IDX being
+// IndexIX/IndexIY), once fetched. Its bitfields select the code at
+// compile time (see TProgramBuilder::opcode):
+//    x (bits 7-6), y (bits 5-3), z (bits 2-0), p (bits 5-4), q (bit 3)
+// n() returns its next operand byte: handlers read them from memory
+// advancing PC, threaded code takes them from the block it was 
+// decoded to. Prefixes read the next opcode from memory themselves
+//
+template <class IDX, uint8_t OP, class OPERAND>
+inline void
+Z80::instruction(Memory& mem, OPERAND n) {
+   constexpr uint8_t x = OP >> 6, y = (OP >> 3) & 7, z = OP & 7, p = y >> 1, q = y & 1;
+   constexpr Reg8  r8[8] = { Reg::B, Reg::C, Reg::D, Reg::E, IDX::HI, IDX::LO, Reg::BUS8, Reg::A };
+   constexpr Reg8  rr[8] = { Reg::B, Reg::C, Reg::D, Reg::E, Reg::H,  Reg::L,  Reg::BUS8, Reg::A };
+   constexpr Reg16 rp[4] = { Reg::BC, Reg::DE, IDX::RP, Reg::SP };
+   constexpr Reg8  hi[4] = { Reg::B, Reg::D, IDX::HI, Reg::A };   // PUSH/POP pairs
+   constexpr Reg8  lo[4] = { Reg::C, Reg::E, IDX::LO, Reg::F };
+   constexpr uint8_t D   = IDX::DISP ? 8 : 0;   // Extra T-states of (IX+d)
+
+   // Aliases for brevity
+   auto&     r  = m_reg;
+   auto&     rm = r.main;
+   uint16_t& ix = reg16(IDX::RP);
+
+   // Direct memory access helpers
+   auto rd   = [&mem](uint16_t a) -> uint8_t { return mem.read(a); };
+   auto wr   = [&mem](uint16_t a, uint8_t v) { mem.write(a, v);   };
+   auto nn   = [&](uint8_t& h, uint8_t& l)   { l = n(); h = n(); };
+   auto push = [&](uint8_t h, uint8_t l)     { wr(--r.SP, h); wr(--r.SP, l); };
+   auto pop  = [&](uint8_t& h, uint8_t& l)   { l = rd(r.SP++); h = rd(r.SP++); };
+
+   // Address of (HL), or (IX+d) reading d into Z and adding it into WZ
+   auto addr = [&]() -> uint16_t {
+      if constexpr ( IDX::DISP ) { r.Z = n(); r.WZ = ix + (int8_t)r.Z; return r.WZ; }
+      else                       return rm.HL;
+   };
+   // Prefixes: next opcode (fetched by M1) runs from space s
+   auto prefix = [&](Space s) {
+      m_ticks += 4;
+      const uint8_t op = rd(r.PC++);
+      inc7(r.R);
+      s_handlers[TProgramTable::program(s, op)](*this, mem);
+   };
+
+   if constexpr ( x == 0 ) {
+      if constexpr ( z == 0 ) {
+         if constexpr      ( y == 1 ) { exe_EX_AF_AF();                  m_ticks +=  4; }
+         else if constexpr ( y == 3 ) {
+            r.Z   = n();
+            r.BUF = r.PC + (int8_t)r.Z;
+            r.WZ  = r.BUF;
+            r.PC  = r.WZ;                                                m_ticks += 12; 
+         }
+         else                         {                                  m_ticks +=  4; }
+      }
+      else if constexpr ( z == 1 && !q ) { 
+         if constexpr ( p == 3 )  nn(r.S, r.P);
+         else                     nn(reg8(hi[p]), reg8(lo[p]));
+                                                                         m_ticks += 10; 
+      }
+      else if constexpr ( z == 2 ) {
+         if constexpr      ( p < 2 && !q ) { wr(reg16(rp[p]), rm.A);     m_ticks +=  7; }
+         else if constexpr ( p < 2 )       { rm.A = rd(reg16(rp[p]));    m_ticks +=  7; }
+         else if constexpr ( p == 2 && !q ) {
+            nn(r.W, r.Z);
+            wr(r.WZ++, reg8(IDX::LO));
+            wr(r.WZ++, reg8(IDX::HI));                                   m_ticks += 16;
+         }
+         else if constexpr ( p == 2 ) {
+            nn(r.W, r.Z);
+            reg8(IDX::LO) = rd(r.WZ++);
+            reg8(IDX::HI) = rd(r.WZ++);                                  m_ticks += 16;
+         }
+         else if constexpr ( !q ) { nn(r.W, r.Z); wr(r.WZ++, rm.A);      m_ticks += 13; }
+         else                     { nn(r.W, r.Z); rm.A = rd(r.WZ++);     m_ticks += 13; }
+      }
+      else if constexpr ( z == 3 ) {
+         if constexpr ( !q ) ++reg16(rp[p]); else --reg16(rp[p]);
+                                                                         m_ticks +=  6;
+      }
+      else if constexpr ( (z == 4 || z == 5) && y == 6 ) {
+         const uint16_t a = addr();
+         r.BFl = rd(a);
+         if constexpr ( z == 4 ) inc_alu(r.BFl); else dec_alu(r.BFl);
+         wr(a, r.BFl);                                                   m_ticks += 11 + D;
+      }
+      else if constexpr ( z == 4 ) { inc_alu(reg8(r8[y]));               m_ticks +=  4; }
+      else if constexpr ( z == 5 ) { dec_alu(reg8(r8[y]));               m_ticks +=  4; }
+      else if constexpr ( z == 6 && y == 6 ) {
+         if constexpr ( IDX::DISP ) {
+            r.Z   = n();
+            r.BFl = n();
+            r.WZ  = ix + (int8_t)r.Z;
+            wr(r.WZ, r.BFl);                                             m_ticks += 15;
+         } else {
+            r.BFl = n(); 
+            wr(rm.HL, r.BFl);                                            m_ticks += 10;
+         }
+      }
+      else if constexpr ( z == 6 ) { reg8(r8[y]) = n();                  m_ticks +=  7; }
+      else if constexpr ( z == 7 ) {
+         if constexpr      ( y == 0 ) exe_RLCA();
+         else if constexpr ( y == 1 ) exe_RRCA();
+         else if constexpr ( y == 2 ) exe_RLA ();
+         else if constexpr ( y == 3 ) exe_RRA ();
+         else if constexpr ( y == 4 ) exe_DAA ();
+         else if constexpr ( y == 5 ) exe_CPL ();
+         else if constexpr ( y == 6 ) exe_SCF ();
+         else                         exe_CCF ();
+                                                                         m_ticks +=  4;
+      }
+      else                           {                                   m_ticks +=  4; }
+   }
+   // [[ LD r, r' ]] (H/L stay H/L along with (IX+d))
+   else if constexpr ( x == 1 ) {
+      if constexpr      ( OP == 0x76 ) { exe_HALT();                      m_ticks +=  4; }
+      else if constexpr ( z == 6 )     { reg8(rr[y]) = rd(addr());        m_ticks +=  7 + D; }
+      else if constexpr ( y == 6 )     { const uint16_t a = addr(); wr(a, reg8(rr[z])); m_ticks += 7 + D; }
+      else                             { reg8(r8[y]) = reg8(r8[z]);      m_ticks +=  4; }
+   }
+   // [[ ALU A, r ]]
+   else if constexpr ( x == 2 ) {
+      if constexpr ( z == 6 ) { const uint16_t a = addr(); r.BFl = rd(a); alu8(ALU(y), r.BFl); m_ticks += 7 + D; }
+      else                    { alu8(ALU(y), reg8(r8[z]));               m_ticks +=  4; }
+   }
+   else {
+      if constexpr ( z == 1 && !q ) {
+         if constexpr ( p == 3 ) evalF();
+         pop(reg8(hi[p]), reg8(lo[p]));                                  m_ticks += 10;
+      }
+      else if constexpr ( z == 1 && p == 0 ) { pop(r.W, r.Z); r.PC = r.WZ; m_ticks += 10; }
+      else if constexpr ( z == 1 && p == 1 ) { exe_EXX();                m_ticks +=  4; }
+      else if constexpr ( z == 1 && p == 2 ) { r.PC = ix;                m_ticks +=  4; }
+      else if constexpr ( z == 1 && p == 3 ) { r.SP = ix;                m_ticks +=  6; }
+      else if constexpr ( z == 3 && y == 0 ) { nn(r.W, r.Z); r.PC = r.WZ; m_ticks += 10; }
+      else if constexpr ( z == 3 && y == 1 && IDX::DISP ) {
+         // DD CB d op: d and op are read as data. op runs from DDCB space
+         m_ticks += 12;
+         r.Z = rd(r.PC++);
+         const uint8_t op = rd(r.PC++);
+         r.WZ = ix + (int8_t)r.Z;
+         s_handlers[TProgramTable::program(IDX::CBSPACE, op)](*this, mem);
+      }
+      else if constexpr ( z == 3 && y == 1 ) { prefix(Space::CB); }
+      else if constexpr ( z == 3 && y == 2 ) {
+         r.BFh = rm.A;
+         r.BFl = n();
+         r.WZ  = r.BUF;
+         ++r.Z;
+         portOut(r.BUF, rm.A);                                           m_ticks += 11;
+      }
+      else if constexpr ( z == 3 && y == 3 ) {
+         r.BFh = rm.A;
+         r.BFl = n();
+         r.WZ  = r.BUF + 1;
+         rm.A  = portIn(r.BUF);                                          m_ticks += 11;
+      }
+      else if constexpr ( z == 3 && y == 4 ) {
+         r.BUF = r.SP + 1;
+         r.Z   = rd(r.SP);
+         r.W   = rd(r.BUF);
+         wr(r.BUF, reg8(IDX::HI));
+         wr(r.SP,  reg8(IDX::LO));
+         ix    = r.WZ;                                                   m_ticks += 19;
+      }
+      else if constexpr ( z == 3 && y == 5 ) { exe_EX_rp_rp(rm.DE, rm.HL); m_ticks += 4; }
+      else if constexpr ( z == 3 && y == 6 ) { exe_DI();                 m_ticks +=  4; }
+      else if constexpr ( z == 3 && y == 7 ) { exe_EI();                 m_ticks +=  4; }
+      else if constexpr ( z == 5 && !q ) {
+         if constexpr ( p == 3 ) evalF();
+         push(reg8(hi[p]), reg8(lo[p]));                                 m_ticks += 11;
+      }
+      else if constexpr ( z == 5 && p == 1 ) { prefix(Space::DD); }
+      else if constexpr ( z == 5 && p == 2 ) { prefix(Space::ED); }
+      else if constexpr ( z == 5 && p == 3 ) { prefix(Space::FD); }
+      else if constexpr ( z == 6 ) { r.BFl = n(); alu8(ALU(y), r.BFl);   m_ticks +=  7; }
+      else if constexpr ( z == 7 ) {
+         exe_RST(y * 8);
+         push(r.PCh, r.PCl);
+         r.PC = r.WZ;                                                    m_ticks += 11;
+      }
+      else                         {                                     m_ticks +=  4; }
+   }
+}
+
+//
+// Rest of instruction OP of ED space, once fetched (its ED prefix has
+// taken 4 T-states). IN (C) and OUT (C), 0 use BFl as their register
+//
+template <uint8_t OP>
+inline void
+Z80::instructionED(Memory& mem) {
+   constexpr uint8_t x = OP >> 6, y = (OP >> 3) & 7, z = OP & 7, p = y >> 1, q = y & 1;
+   constexpr Reg16 rp[4] = { Reg::BC, Reg::DE, Reg::HL, Reg::SP };
+   constexpr Reg8  hi[4] = { Reg::B, Reg::D, Reg::H, Reg::S };
+   constexpr Reg8  lo[4] = { Reg::C, Reg::E, Reg::L, Reg::P };
+   constexpr Reg8  r8[8] = { Reg::B, Reg::C, Reg::D, Reg::E, Reg::H, Reg::L, Reg::BFl, Reg::A };
+
+   auto& r  = m_reg;
+   auto& rm = r.main;
+   auto  rd = [&mem](uint16_t a) -> uint8_t { return mem.read(a); };
+   auto  wr = [&mem](uint16_t a, uint8_t v) { mem.write(a, v);   };
+   auto  nn = [&](uint8_t& h, uint8_t& l)   { l = rd(r.PC++); h = rd(r.PC++); };
+
+   if constexpr ( x == 1 && z == 0 ) {
+      uint8_t& reg = reg8(r8[y]);
+      r.WZ = rm.BC + 1;
+      reg  = portIn(rm.BC);
+      setF(carry() | g_flagtables.sz53p[reg]);                           m_ticks +=  8;
+   }
+   else if constexpr ( x == 1 && z == 1 ) {
+      if constexpr ( y == 6 ) r.BFl = 0;
+      r.WZ = rm.BC + 1;
+      portOut(rm.BC, reg8(r8[y]));                                       m_ticks +=  8;
+   }
+   else if constexpr ( x == 1 && z == 2 ) {
+      if constexpr ( q ) adc16(reg16(rp[p])); else sbc16(reg16(rp[p]));
+                                                                         m_ticks += 11;
+   }
+   else if constexpr ( x == 1 && z == 3 && !q ) {
+      nn(r.W, r.Z);
+      wr(r.WZ++, reg8(lo[p]));
+      wr(r.WZ++, reg8(hi[p]));                                           m_ticks += 16;
+   }
+   else if constexpr ( x == 1 && z == 3 ) {
+      nn(r.W, r.Z);
+      reg8(lo[p]) = rd(r.WZ++);
+      reg8(hi[p]) = rd(r.WZ++);                                          m_ticks += 16;
+   }
+   else if constexpr ( x == 1 && z == 4 ) { exe_NEG();                   m_ticks +=  4; }
+   else if constexpr ( x == 1 && z == 5 ) {
+      exe_RETN();
+      r.Z = rd(r.SP++);
+      r.W = rd(r.SP++);
+      r.PC = r.WZ;                                                       m_ticks += 10;
+   }
+   else if constexpr ( x == 1 && z == 6 ) {
+      constexpr uint8_t im[8] = { 0, 0, 1, 2, 0, 0, 1, 2 };
+      exe_IM(im[y]);                                                     m_ticks +=  4;
+   }
+   else if constexpr ( x == 1 && z == 7 && y == 0 ) { r.I = rm.A;        m_ticks +=  5; }
+   else if constexpr ( x == 1 && z == 7 && y == 1 ) { r.R = rm.A;        m_ticks +=  5; }
+   else if constexpr ( x == 1 && z == 7 && y == 2 ) { exe_LD_A_IR(r.I);  m_ticks +=  5; }
+   else if constexpr ( x == 1 && z == 7 && y == 3 ) { exe_LD_A_IR(r.R);  m_ticks +=  5; }
+   else if constexpr ( x == 1 && z == 7 && (y == 4 || y == 5) ) {
+      r.BFl = rd(rm.HL);
+      if constexpr ( y == 4 ) exe_RRD(); else exe_RLD();
+      wr(rm.HL, r.BFl);                                                  m_ticks += 14;
+   }
+   else if constexpr ( x == 2 && y >= 4 && z <= 1 ) {
+      r.BFl = rd(rm.HL);
+      if constexpr ( z == 0 ) wr(rm.DE, r.BFl);
+                                                                         m_ticks += 12;
+      if ( blockOp(OP) ) { exe_repeat();                                 m_ticks +=  5; }
+   }
+   else if constexpr ( x == 2 && y >= 4 && z <= 3 ) {
+      // INI, OUTI... stepping WZ as HL
+      const uint16_t step = ( y & 1 ) ? -1 : 1;
+      if constexpr ( z == 2 ) {
+         r.WZ  = rm.BC + step;
+         r.BFl = portIn(rm.BC);
+         --rm.B;
+         wr(rm.HL, r.BFl);
+      } else {
+         --rm.B;
+         r.BFl = rd(rm.HL);
+         r.WZ  = rm.BC + step;
+         portOut(rm.BC, r.BFl);
+      }
+                                                                         m_ticks += 12;
+      if ( ioBlockOp(OP) ) { r.PC -= 2;                                  m_ticks +=  5; }
+   }
+   else                                                                { m_ticks +=  4; }
+}
+
+//
+// Rest of instruction OP of CB space, once fetched, or DDCB/FDCB spaces
+// (IDX = IndexIX/IndexIY) once their d and OP have been read, with 
+// (IX+d) in WZ. These work on (IX+d), copying results to register z
+//
+template <class IDX, uint8_t OP>
+inline void
+Z80::instructionCB(Memory& mem) {
+   constexpr uint8_t x = OP >> 6, z = OP & 7;
+   constexpr Reg8    r8[8] = { Reg::B, Reg::C, Reg::D, Reg::E, Reg::H, Reg::L, Reg::BUS8, Reg::A };
+
+   auto& r = m_reg;
+   if constexpr ( !IDX::DISP && z != 6 ) {
+      cb(reg8(r8[z]), OP);                                               m_ticks +=  4;
+   } else {
+      const uint16_t a = IDX::DISP ? r.WZ : r.main.HL;
+      r.BFl = mem.read(a);
+      cb(r.BFl, (OP & 0xF8) | 6);
+      if constexpr ( x == 1 ) {                                          m_ticks += IDX::DISP ? 4 : 8; }
+      else {
+         mem.write(a, r.BFl);
+         if constexpr ( IDX::DISP && z != 6 ) reg8(r8[z]) = r.BFl;
+                                                                         m_ticks += IDX::DISP ? 7 : 11;
+      }
+   }
+}
+
+//
+// Handler of program PRG (TProgramTable::program(space, opcode)), with
+// the opcode already fetched
+//
+template <uint16_t PRG>
+void
+Z80::handler(Z80& cpu, Memory& mem) {
+   constexpr Space   S  = Space(PRG >> 8);
+   constexpr uint8_t OP = PRG & 0xFF;
+   auto n = [&]() -> uint8_t { return mem.read(cpu.m_reg.PC++); };
+   if constexpr      ( S == Space::Main ) cpu.instruction<IndexHL, OP>(mem, n);
+   else if constexpr ( S == Space::DD   ) cpu.instruction<IndexIX, OP>(mem, n);
+   else if constexpr ( S == Space::FD   ) cpu.instruction<IndexIY, OP>(mem, n);
+   else if constexpr ( S == Space::ED   ) cpu.instructionED<OP>(mem);
+   else if constexpr ( S == Space::CB   ) cpu.instructionCB<IndexHL, OP>(mem);
+   else if constexpr ( S == Space::DDCB ) cpu.instructionCB<IndexIX, OP>(mem);
+   else                                   cpu.instructionCB<IndexIY, OP>(mem);
+}
+
+template <std::size_t... PRGS>
+std::array<Z80::Handler, TProgramTable::PRG_M1>
+Z80::handlerTable(std::index_sequence<PRGS...>) {
+   return {{ &Z80::handler<PRGS>... }};
+}
+
+const std::array<Z80::Handler, TProgramTable::PRG_M1> 
+Z80::s_handlers = Z80::handlerTable(std::make_index_sequence<TProgramTable::PRG_M1>());
+
+//
+// Operand bytes following each opcode, as the instruction engine decodes 
+// them (opcodes not implemented yet are 1-byte NOPs)
+//
+static constexpr uint8_t
+operandBytes(uint8_t op) {
+   switch( op ) {
+      case 0x01: case 0x11: case 0x21: case 0x31:
+      case 0x22: case 0x2A: case 0x32: case 0x3A: case 0xC3:
+         return 2;
+      case 0x06: case 0x0E: case 0x16: case 0x1E:
+      case 0x26: case 0x2E: case 0x36: case 0x3E: case 0x18:
+      case 0xD3: case 0xDB:
+      case 0xC6: case 0xCE: case 0xD6: case 0xDE:
+      case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+         return 1;
+      default:
+         return 0;
+   }
+}
+
+// Opcodes that may not continue with the next one (jumps, calls and
+// returns, HALT, and prefixes, whose instructions are read when run).
+// So does EI, as an interrupt may be accepted after the next one, and 
+// OUT (n), A, as devices may remap memory or request an interrupt
+static constexpr bool
+endsBlock(uint8_t op) {
+   return op == 0x18 || op == 0xC3 || op == 0xE9 || op == 0xC9 || op == 0x76 || op == 0xFB || op == 0xD3
+       || (op & 0xC7) == 0xC7 || isPrefix(op);
+}
+
+// Opcodes that may write to memory
+static constexpr bool
+writesMemory(uint8_t op) {
+   if ( isPrefix(op) ) return true;
+   switch( op ) {
+      case 0x02: case 0x12: case 0x22: case 0x32: case 0x36: 
+      case 0x34: case 0x35:
+      case 0xC5: case 0xD5: case 0xE5: case 0xF5: case 0xE3:
+      case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+         return true;
+      default:
+         return op >= 0x70 && op <= 0x77 && op != 0x76;
+   }
+}
+
+//
+// Threaded code of opcode OP: the same as execute(), with the opcode
+// already known and operands already read. PC is advanced at once, as
+// no instruction reads it before fetching all of its operands
+//
+template <uint8_t OP>
+void
+Z80::threaded(Z80& cpu, Memory& mem, const uint8_t* operands) {
+   cpu.m_reg.PC += 1 + operandBytes(OP);
+   cpu.inc7(cpu.m_reg.R);
+   cpu.instruction<IndexHL, OP>(mem, [&]() -> uint8_t { return *operands++; });
+}
+
+template <std::size_t... OPS>
+std::array<Z80::Decoded, 256>
+Z80::decodedTable(std::index_sequence<OPS...>) {
+   return {{ Decoded{ &Z80::threaded<OPS>, operandBytes(OPS), endsBlock(OPS), writesMemory(OPS), 0 }... }};
+}
+
+const Z80::Decoded&
+Z80::decoded(uint8_t op) {
+   static const std::array<Decoded, 256> s_decoded = [] {
+      auto table = decodedTable(std::make_index_sequence<256>());
+      // T-states of every opcode, measured by running it once (all of 
+      // them take a fixed time in this engine, prefixes followed by 00)
+      Memory        mem;
+      const uint8_t operands[2] = {};
+      for (auto& d : table) {
+         Z80 cpu;
+         d.run(cpu, mem, operands);
+         d.ticks = cpu.m_ticks;
+      }
+      return table;
+   }();
+   return s_decoded[op];
+}
+
+} // Namespace Z80CPP
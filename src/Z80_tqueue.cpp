@@ -5,134 +5,792 @@
 namespace Z80CPP {
 
 // Const signals conversions to uint16_t for clarity and brevity
-const uint16_t S_M1     = (uint16_t)Signal::M1;
-const uint16_t S_MREQ   = (uint16_t)Signal::MREQ;
-const uint16_t S_RD     = (uint16_t)Signal::RD;
-const uint16_t S_WR     = (uint16_t)Signal::WR;
-const uint16_t S_RFSH   = (uint16_t)Signal::RFSH;
-const uint16_t S_HALT   = (uint16_t)Signal::HALT;
-const uint16_t S_WSMP   = (uint16_t)Signal::WSAMP;
-
-void 
-TVecOps::addM1() {
-   Registers& r    = cpu.registers_r();
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();
-   
-   ops[last].set(S_M1                           , &r.PC, &data, TZ80Op(&Z80::inc, r.PC));
-   inc(last);
-   ops[last].set(S_M1 | S_MREQ | S_RD | S_WSMP  , &addr, &data, TZ80Op());
-   inc(last);
-   ops[last].set(S_RFSH                         , &r.IR, &data, TZ80Op(&Z80::decode));
-   inc(last);
-   ops[last].set(S_MREQ | S_RFSH                , &addr, &data, TZ80Op(&Z80::inc7, r.R));
-   inc(last);
-}
+constexpr uint16_t S_M1     = (uint16_t)Signal::M1;
+constexpr uint16_t S_MREQ   = (uint16_t)Signal::MREQ;
+constexpr uint16_t S_IORQ   = (uint16_t)Signal::IORQ;
+constexpr uint16_t S_RD     = (uint16_t)Signal::RD;
+constexpr uint16_t S_WR     = (uint16_t)Signal::WR;
+constexpr uint16_t S_RFSH   = (uint16_t)Signal::RFSH;
+constexpr uint16_t S_HALT   = (uint16_t)Signal::HALT;
+constexpr uint16_t S_WSMP   = (uint16_t)Signal::WSAMP;
 
-void 
-TVecOps::addHALTNOP() {
-   Registers& r    = cpu.registers_r();
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();
-
-   ops[last].set(S_HALT | S_M1                         , &r.PC, &data, TZ80Op());
-   inc(last);
-   ops[last].set(S_HALT | S_M1 | S_MREQ | S_RD | S_WSMP, &addr, &data, TZ80Op());
-   inc(last);
-   ops[last].set(S_HALT | S_RFSH                       , &r.IR, &data, TZ80Op());
-   inc(last);
-   ops[last].set(S_HALT | S_MREQ | S_RFSH              , &addr, &data, TZ80Op(&Z80::inc7, r.R));
-   inc(last);
-}
+//
+// TProgramBuilder: Generates the static T-state programs of all opcodes
+// at compile time. Machine cycle members (addM1, addM23Read...) append
+// T-states to the program being generated, and exe_* members describe
+// every instruction in terms of machine cycles.
+//
+class TProgramBuilder {
+   TProgramTable m_t {};       // Table being generated
+   uint16_t      m_prg = 0;    // Program being generated
 
+   // Start generating program p
+   constexpr void begin(uint16_t p) {
+      m_prg = p;
+      m_t.prg[p].first = m_t.used;
+   }
+   // Set decode-time operation of current program
+   constexpr void exec(TZ80Op&& t) {
+      m_t.prg[m_prg].exec = t;
+   }
+   // Append one T-state to current program
+   constexpr void add(uint16_t s, Reg16 a, Reg8 d, TZ80Op&& t = TZ80Op()) {
+      m_t.ts[m_t.used] = TState(s, a, d, t);
+      ++m_t.used;
+      ++m_t.prg[m_prg].length;
+   }
 
-void 
-TVecOps::addM23Read(uint16_t& read_addr, uint8_t& in_reg, TZ80Op&& t0) {
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();
-
-   // Default Machine Re7ad Cycle (By default, reads from PC)
-   //|      M2           |
-   //| MREQ | WAIT| DIN  | 
-   //|   RD |     |      | 
-   ops[last].set(0                     , &read_addr, &data, std::move(t0));
-   inc(last);
-   ops[last].set(S_MREQ | S_RD | S_WSMP, &addr     , &data, TZ80Op());
-   inc(last);
-   ops[last].set(S_MREQ | S_RD         , &addr     , &data, TZ80Op(&Z80::data_in, in_reg));
-   inc(last);
-}
+   //---------------------------------------------------------------------
+   // Machine cycles
+   //---------------------------------------------------------------------
+   constexpr void addM1() {
+      using namespace Reg;
+      add(S_M1                           , PC   , BUS8, TZ80Op(&Z80::inc, PC));
+      add(S_M1 | S_MREQ | S_RD | S_WSMP  , BUS16, BUS8);
+      add(S_RFSH                         , IR   , BUS8, TZ80Op(&Z80::decode));
+   }
 
-void 
-TVecOps::addM3ReadAssign(uint16_t& read_reg, uint8_t& in_reg, uint16_t& to_reg, uint16_t& from_reg) {
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();
-
-   // Default Machine Re7ad Cycle (By default, reads from PC)
-   //|      M3           |
-   //| MREQ | WAIT| DIN  | 
-   //|   RD |     |      | 
-   ops[last].set(0                     , &read_reg , &data, TZ80Op(&Z80::inc, read_reg));
-   inc(last);
-   ops[last].set(S_MREQ | S_RD | S_WSMP, &addr     , &data, TZ80Op());
-   inc(last);
-   ops[last].set(0                     , &addr     , &data, TZ80Op(&Z80::data_in_assign, in_reg, to_reg, from_reg));
-   inc(last);
-}
+   constexpr void addM1Refresh() {
+      using namespace Reg;
+      add(S_MREQ | S_RFSH                , BUS16, BUS8, TZ80Op(&Z80::inc7, R));
+   }
 
-void 
-TVecOps::addM3alu(uint8_t ts, TZ80Op&& tend) {
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();  
+   constexpr void addHALTNOP() {
+      using namespace Reg;
+      add(S_HALT | S_M1                         , PC   , BUS8);
+      add(S_HALT | S_M1 | S_MREQ | S_RD | S_WSMP, BUS16, BUS8);
+      add(S_HALT | S_RFSH                       , IR   , BUS8);
+      add(S_HALT | S_MREQ | S_RFSH              , BUS16, BUS8, TZ80Op(&Z80::inc7, R));
+   }
 
-   while(--ts) {
-      ops[last].set(0, &addr, &data, TZ80Op());
-      inc(last);
+   // Interrupt acknowledge M1s. NMI reads (PC) as M1 does, but ignores
+   // it and leaves PC as it is. INT takes two more T-states (automatic
+   // wait states) with IORQ instead of MREQ, while the device puts its
+   // data on the bus, which operation t takes at T3
+   constexpr void addM1NMI() {
+      using namespace Reg;
+      add(S_M1                           , PC   , BUS8);
+      add(S_M1 | S_MREQ | S_RD | S_WSMP  , BUS16, BUS8);
+      add(S_RFSH                         , IR   , BUS8);
    }
-   ops[last].set(0, &addr, &data, std::move(tend));
-   inc(last);
-}
 
-void 
-TVecOps::addM45Write(uint16_t& wr_addr, uint8_t& wr_data, TZ80Op&& t) {
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();  
-
-   // Default Machine Write Cycle (By default, writes to (PC))
-   //|      M3           |
-   //| MREQ | WR  | DIN  | 
-   //|     -DOUT-----    |
-   ops[last].set(0               , &wr_addr, &data    , TZ80Op());
-   inc(last);
-   ops[last].set(S_MREQ | S_WSMP , &addr   , &wr_data , std::move(t));
-   inc(last);
-   ops[last].set(S_MREQ | S_WR   , &addr   , &data    , TZ80Op());
-   inc(last);
-}
+   constexpr void addM1INT(TZ80Op&& t) {
+      using namespace Reg;
+      add(S_M1                           , PC   , BUS8);
+      add(S_M1                           , BUS16, BUS8);
+      add(S_M1 | S_IORQ                  , BUS16, BUS8);
+      add(S_M1 | S_IORQ | S_WSMP         , BUS16, BUS8);
+      add(S_RFSH                         , IR   , BUS8, std::move(t));
+   }
 
-void 
-TVecOps::addM45Read(uint16_t& read_addr, uint8_t& in_reg, TZ80Op&& t) {
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();  
-
-   ops[last].set(0                     , &read_addr, &data, TZ80Op());
-   inc(last);
-   ops[last].set(S_MREQ | S_RD | S_WSMP, &addr     , &data, std::move(t));
-   inc(last);
-   ops[last].set(S_MREQ | S_RD         , &addr     , &data, TZ80Op(&Z80::data_in, in_reg));
-   inc(last);
-}
+   constexpr void addM23Read(Reg16 read_addr, Reg8 in_reg, TZ80Op&& t0 = TZ80Op()) {
+      addM23ReadOp(read_addr, TZ80Op(&Z80::data_in, in_reg), std::move(t0));
+   }
+
+   // Machine Read Cycle whose data is taken by operation tin
+   constexpr void addM23ReadOp(Reg16 read_addr, TZ80Op&& tin, TZ80Op&& t0 = TZ80Op()) {
+      using namespace Reg;
+      // Default Machine Read Cycle (By default, reads from PC)
+      //|      M2           |
+      //| MREQ | WAIT| DIN  | 
+      //|   RD |     |      | 
+      add(0                     , read_addr, BUS8, std::move(t0));
+      add(S_MREQ | S_RD | S_WSMP, BUS16    , BUS8);
+      add(S_MREQ | S_RD         , BUS16    , BUS8, std::move(tin));
+   }
+
+   constexpr void addM3ReadAssign(Reg16 read_reg, Reg8 in_reg, Reg16 to_reg, Reg16 from_reg) {
+      using namespace Reg;
+      // Default Machine Read Cycle (By default, reads from PC)
+      //|      M3           |
+      //| MREQ | WAIT| DIN  | 
+      //|   RD |     |      | 
+      add(0                     , read_reg , BUS8, TZ80Op(&Z80::inc, read_reg));
+      add(S_MREQ | S_RD | S_WSMP, BUS16    , BUS8);
+      add(0                     , BUS16    , BUS8, TZ80Op(&Z80::data_in_assign, in_reg, to_reg, from_reg));
+   }
 
+   constexpr void addM3alu(uint8_t ts, TZ80Op&& tend) {
+      using namespace Reg;
+      while(--ts)
+         add(0, BUS16, BUS8);
+      add(0, BUS16, BUS8, std::move(tend));
+   }
+
+   constexpr void addM45Write(Reg16 wr_addr, Reg8 wr_data, TZ80Op&& t = TZ80Op()) {
+      using namespace Reg;
+      // Default Machine Write Cycle (By default, writes to (PC))
+      //|      M3           |
+      //| MREQ | WR  | DIN  | 
+      //|     -DOUT-----    |
+      add(0               , wr_addr, BUS8   );
+      add(S_MREQ | S_WSMP , BUS16  , wr_data, std::move(t));
+      add(S_MREQ | S_WR   , BUS16  , BUS8   );
+   }
+
+   constexpr void addM45Read(Reg16 read_addr, Reg8 in_reg, TZ80Op&& t) {
+      addM45ReadOp(read_addr, TZ80Op(&Z80::data_in, in_reg), std::move(t));
+   }
 
-void 
-TVecOps::extendM(TZ80Op&& t) {
-   uint16_t&  addr = cpu.address_r();
-   uint8_t&   data = cpu.data_r();  
+   // Machine Read Cycle whose data is taken by operation tin
+   constexpr void addM45ReadOp(Reg16 read_addr, TZ80Op&& tin, TZ80Op&& t) {
+      using namespace Reg;
+      add(0                     , read_addr, BUS8, TZ80Op());
+      add(S_MREQ | S_RD | S_WSMP, BUS16    , BUS8, std::move(t));
+      add(S_MREQ | S_RD         , BUS16    , BUS8, std::move(tin));
+   }
+
+   // IO Read/Write Cycles: IORQ from T2 on, with an automatic wait 
+   // state (TW) sampling WAIT. Operations t1 and t2 run at T1 and T2.
+   // Data read is taken by tin at T3
+   //|      IO                  |
+   //| IORQ | WAIT | WAIT| DIN  |
+   //|   RD |      |     |      |
+   constexpr void addIORead(Reg16 port, TZ80Op&& tin, TZ80Op&& t1 = TZ80Op(), TZ80Op&& t2 = TZ80Op()) {
+      using namespace Reg;
+      add(0                     , port , BUS8, std::move(t1));
+      add(S_IORQ | S_RD         , BUS16, BUS8, std::move(t2));
+      add(S_IORQ | S_RD | S_WSMP, BUS16, BUS8);
+      add(S_IORQ | S_RD         , BUS16, BUS8, std::move(tin));
+   }
+
+   constexpr void addIOWrite(Reg16 port, Reg8 wr_data, TZ80Op&& t1 = TZ80Op(), TZ80Op&& t2 = TZ80Op()
+                           , TZ80Op&& t3 = TZ80Op()) {
+      using namespace Reg;
+      add(0                     , port , BUS8   , std::move(t1));
+      add(S_IORQ | S_WR         , BUS16, wr_data, std::move(t2));
+      add(S_IORQ | S_WR | S_WSMP, BUS16, BUS8   );
+      add(S_IORQ | S_WR         , BUS16, BUS8   , std::move(t3));
+   }
 
    // Extends current machine cycle with an extra waiting tstate
-   ops[last].set(0 , &addr , &data , std::move(t));
-   inc(last);
-}
+   constexpr void extendM(TZ80Op&& t = TZ80Op()) {
+      add(0, Reg::BUS16, Reg::BUS8, std::move(t));
+   }
+
+   //---------------------------------------------------------------------
+   // Z80 Instructions
+   //---------------------------------------------------------------------
+
+   // Basic
+   constexpr void exe_NOP () {}
+
+   constexpr void exe_HALT() {
+      exec(TZ80Op(&Z80::exe_HALT));
+   }
+
+   constexpr void exe_EX_rp_rp(Reg16 r1, Reg16 r2) {
+      exec(TZ80Op(&Z80::exe_EX_rp_rp, r1, r2));
+   }
+
+   constexpr void exe_EX_AF_AF() {
+      exec(TZ80Op(&Z80::exe_EX_AF_AF));
+   }
+
+   constexpr void exe_EXX() {
+      exec(TZ80Op(&Z80::exe_EXX));
+   }
+
+   constexpr void exe_EX_ISPI_rp(Reg16 rd16, Reg8 rhi, Reg8 rlo) {
+      using namespace Reg;
+      exec            (TZ80Op(&Z80::assign, BUF, SP)); // Should be done with WZ
+      addM23Read      (SP , Z, TZ80Op(&Z80::inc, BUF));
+      addM23Read      (BUF, W);
+      extendM         ();
+      addM45Write     (BUF, rhi);
+      addM45Write     (SP,  rlo);
+      extendM         (TZ80Op(&Z80::assign, rd16, WZ));
+      extendM         ();
+   }
+
+   // Load
+   constexpr void exe_LD_r_r(Reg8 rd, Reg8 rs) {
+      exec(TZ80Op(&Z80::exe_LD_r_r, rd, rs));
+   }
+
+   constexpr void exe_LD_rp_rp(Reg16 rd, Reg16 rs) {
+      exec(TZ80Op(&Z80::exe_LD_rp_rp, rd, rs));
+      extendM();
+      extendM();
+   }
+
+   constexpr void exe_LD_r_n(Reg8 reg) {
+      addM23Read(Reg::PC, reg, TZ80Op(&Z80::inc, Reg::PC));
+   }
+
+   constexpr void exe_LD_r_IrpI(Reg8 rd8, Reg16 rs16) {
+      addM23Read(rs16, rd8);
+   }
+
+   constexpr void read2BytesFrom(Reg8 rdhi, Reg8 rdlo, Reg16 rs16) {
+      addM23Read(rs16, rdlo, TZ80Op(&Z80::inc, rs16));
+      addM23Read(rs16, rdhi, TZ80Op(&Z80::inc, rs16));
+   }
+
+   constexpr void exe_LD_rp_nn(Reg8 rhi, Reg8 rlo) {
+      read2BytesFrom(rhi, rlo, Reg::PC);
+   }
+
+   constexpr void exe_LD_IrpI_r(Reg16 rd16, Reg8 rs8) {
+      addM45Write(rd16, rs8);
+   }
+
+   constexpr void exe_LD_IrpI_n(Reg16 reg) {
+      exe_LD_r_n   (Reg::BFl);
+      exe_LD_IrpI_r(reg, Reg::BFl);
+   }
+
+   constexpr void exe_LD_InnI_r(Reg8 rs8) {
+      using namespace Reg;
+      read2BytesFrom(W, Z, PC);
+      addM45Write   (WZ, rs8, TZ80Op(&Z80::inc, WZ));
+   }
+
+   constexpr void exe_LD_InnI_rp(Reg8 rhi, Reg8 rlo) {
+      using namespace Reg;
+      read2BytesFrom(W, Z, PC);
+      addM45Write   (WZ, rlo, TZ80Op(&Z80::inc, WZ));
+      addM45Write   (WZ, rhi, TZ80Op(&Z80::inc, WZ));
+   }
+
+   constexpr void exe_LD_r_InnI(Reg8 rd8) {
+      using namespace Reg;
+      read2BytesFrom(W, Z, PC);
+      addM23Read    (WZ, rd8, TZ80Op(&Z80::inc, WZ));
+   }
+
+   constexpr void exe_LD_rp_InnI(Reg8 rhi, Reg8 rlo) {
+      using namespace Reg;
+      read2BytesFrom(W  , Z  , PC);
+      read2BytesFrom(rhi, rlo, WZ);
+   }
+
+   // INC/DEC
+   constexpr void exe_INC_rp(Reg16 reg) {
+      extendM(TZ80Op(&Z80::inc, reg));
+      extendM();
+   }
+
+   constexpr void exe_DEC_rp(Reg16 reg) {
+      extendM(TZ80Op(&Z80::dec, reg));
+      extendM();
+   }
+
+   // 8-bit ALU: Operation OP on A and an operand (register, (rp) or n, 
+   // read into BFl). Flags are left for Z80 to compute lazily
+   template <ALU OP>
+   constexpr void exe_ALU_r(Reg8 reg) {
+      exec(TZ80Op(&Z80::alu<OP>, reg));
+   }
+
+   template <ALU OP>
+   constexpr void exe_ALU_IrpI(Reg16 reg) {
+      addM23ReadOp(reg, TZ80Op(&Z80::data_in_alu<OP>, Reg::BFl));
+   }
+
+   template <ALU OP>
+   constexpr void exe_ALU_n() {
+      using namespace Reg;
+      addM23ReadOp(PC, TZ80Op(&Z80::data_in_alu<OP>, BFl), TZ80Op(&Z80::inc, PC));
+   }
+
+   constexpr void exe_INC_r(Reg8 reg) {
+      exec(TZ80Op(&Z80::inc_alu, reg));
+   }
+
+   constexpr void exe_DEC_r(Reg8 reg) {
+      exec(TZ80Op(&Z80::dec_alu, reg));
+   }
+
+   constexpr void exe_INC_IrpI(Reg16 reg) {
+      using namespace Reg;
+      addM23Read (reg, BFl);
+      extendM    (TZ80Op(&Z80::inc_alu, BFl));
+      addM45Write(reg, BFl);
+   }
+
+   constexpr void exe_DEC_IrpI(Reg16 reg) {
+      using namespace Reg;
+      addM23Read (reg, BFl);
+      extendM    (TZ80Op(&Z80::dec_alu, BFl));
+      addM45Write(reg, BFl);
+   }
+
+   // Accumulator and flags (they read F, so it is computed first)
+   constexpr void exe_RLCA() { exec(TZ80Op(&Z80::exe_RLCA)); }
+   constexpr void exe_RRCA() { exec(TZ80Op(&Z80::exe_RRCA)); }
+   constexpr void exe_RLA () { exec(TZ80Op(&Z80::exe_RLA )); }
+   constexpr void exe_RRA () { exec(TZ80Op(&Z80::exe_RRA )); }
+   constexpr void exe_DAA () { exec(TZ80Op(&Z80::exe_DAA )); }
+   constexpr void exe_CPL () { exec(TZ80Op(&Z80::exe_CPL )); }
+   constexpr void exe_SCF () { exec(TZ80Op(&Z80::exe_SCF )); }
+   constexpr void exe_CCF () { exec(TZ80Op(&Z80::exe_CCF )); }
+
+   // PUSH/POP (F is computed before being pushed or popped over)
+   constexpr void exe_PUSH_rp(Reg8 rhi, Reg8 rlo) {
+      using namespace Reg;
+      if ( rlo == F ) exec(TZ80Op(&Z80::exe_evalF));
+      extendM    (TZ80Op(&Z80::dec, SP));
+      addM45Write(SP, rhi, TZ80Op(&Z80::dec, SP));
+      addM45Write(SP, rlo);
+   }
+
+   constexpr void exe_POP_rp(Reg8 rhi, Reg8 rlo) {
+      using namespace Reg;
+      if ( rlo == F ) exec(TZ80Op(&Z80::exe_evalF));
+      addM45Read(SP, rlo, TZ80Op(&Z80::inc, SP));
+      addM45Read(SP, rhi, TZ80Op(&Z80::inc, SP));
+   }
+
+   // JUMP
+   constexpr void exe_JR_n() {
+      using namespace Reg;
+      addM23Read(PC, Z, TZ80Op(&Z80::inc, PC));
+      addM3alu  (2, TZ80Op(&Z80::assign, BUF, PC ));
+      addM3alu  (1, TZ80Op(&Z80::add,    BUF, Z  ));
+      addM3alu  (1, TZ80Op(&Z80::assign, WZ , BUF));
+      addM3alu  (1, TZ80Op(&Z80::assign, PC , WZ ));
+   }
+
+   constexpr void exe_JP_nn() {
+      using namespace Reg;
+      addM23Read     (PC, Z, TZ80Op(&Z80::inc, PC));
+      addM3ReadAssign(PC, W, PC, WZ);
+   }
+
+   constexpr void exe_JP_IrpI(Reg16 reg) {
+      exec(TZ80Op(&Z80::exe_JP_IrpI, reg));
+   }
+
+   // CALL/RETURN: PC is pushed and jumps to WZ (RST p and interrupts)
+   constexpr void exe_PUSH_PC() {
+      using namespace Reg;
+      extendM    (TZ80Op(&Z80::dec, SP));
+      addM45Write(SP, PCh, TZ80Op(&Z80::dec, SP));
+      addM45Write(SP, PCl, TZ80Op(&Z80::assign, PC, WZ));
+   }
+
+   constexpr void exe_RST(uint8_t addr) {
+      exec       (TZ80Op(&Z80::exe_RST, addr));
+      exe_PUSH_PC();
+   }
+
+   constexpr void exe_RET() {
+      using namespace Reg;
+      addM45Read  (SP, Z, TZ80Op(&Z80::inc, SP));
+      addM45ReadOp(SP, TZ80Op(&Z80::data_in_assign, W, PC, WZ), TZ80Op(&Z80::inc, SP));
+   }
+
+   // Interrupts
+   constexpr void exe_DI() { exec(TZ80Op(&Z80::exe_DI)); }
+   constexpr void exe_EI() { exec(TZ80Op(&Z80::exe_EI)); }
+
+   constexpr void exe_IM(uint8_t mode) {
+      exec(TZ80Op(&Z80::exe_IM, mode));
+   }
+
+   constexpr void exe_RETN() {
+      exec   (TZ80Op(&Z80::exe_RETN));
+      exe_RET();
+   }
+
+   // Acknowledge of NMI, or INT in IM 0, 1 or 2 (see Z80::interrupt).
+   // IM 0 decodes the data bus as an opcode, IM 2 takes it into BFl
+   // (next to I) and reads the address to jump to from there
+   constexpr void exe_NMI() {
+      addM1NMI    ();
+      addM1Refresh();
+      exe_PUSH_PC ();
+   }
+
+   constexpr void exe_INT(uint8_t mode) {
+      using namespace Reg;
+      if ( mode == 0 ) { addM1INT(TZ80Op(&Z80::decode)); return; }
+      addM1INT    (mode == 2 ? TZ80Op(&Z80::data_in, BFl) : TZ80Op());
+      addM1Refresh();
+      exe_PUSH_PC ();
+      if ( mode == 1 ) return;
+      addM23Read  (BUF, Z, TZ80Op(&Z80::inc, BUF));
+      addM23ReadOp(BUF, TZ80Op(&Z80::data_in_assign, W, PC, WZ));
+   }
+
+   // IN/OUT: Port A:n (built in BUF), or BC. WZ ends up as port + 1, 
+   // but OUT (n), A only increases Z
+   constexpr void exe_IN_A_n() {
+      using namespace Reg;
+      exec      (TZ80Op(&Z80::assign, BFh, A));
+      addM23Read(PC, BFl, TZ80Op(&Z80::inc, PC));
+      addIORead (BUF, TZ80Op(&Z80::data_in, A), TZ80Op(&Z80::assign, WZ, BUF), TZ80Op(&Z80::inc, WZ));
+   }
+
+   constexpr void exe_OUT_n_A() {
+      using namespace Reg;
+      exec      (TZ80Op(&Z80::assign, BFh, A));
+      addM23Read(PC, BFl, TZ80Op(&Z80::inc, PC));
+      addIOWrite(BUF, A, TZ80Op(&Z80::assign, WZ, BUF), TZ80Op(&Z80::inc, Z));
+   }
+
+   constexpr void exe_IN_r_C(Reg8 reg) {
+      using namespace Reg;
+      addIORead(BC, TZ80Op(&Z80::data_in_flags, reg), TZ80Op(&Z80::assign, WZ, BC), TZ80Op(&Z80::inc, WZ));
+   }
+
+   constexpr void exe_OUT_C_r(Reg8 reg) {
+      using namespace Reg;
+      addIOWrite(BC, reg, TZ80Op(&Z80::assign, WZ, BC), TZ80Op(&Z80::inc, WZ));
+   }
+
+   // Prefixes: next opcode comes from space sp
+   constexpr void exe_prefix(Space sp) {
+      exec(TZ80Op(&Z80::prefix, (uint8_t)sp));
+   }
+
+   // DD CB d op / FD CB d op: displacement and opcode are read as data
+   // (not fetched by M1), adding d to IX/IY into WZ meanwhile. op is 
+   // decoded from the DDCB/FDCB space
+   template <class IDX>
+   constexpr void exe_prefix_CB() {
+      using namespace Reg;
+      exe_prefix(IDX::CBSPACE);
+      addM23Read(PC, Z, TZ80Op(&Z80::inc, PC));
+      add(0                     , PC   , BUS8, TZ80Op(&Z80::displace, WZ, IDX::RP));
+      add(S_MREQ | S_RD | S_WSMP, BUS16, BUS8, TZ80Op(&Z80::inc, PC));
+      add(S_MREQ | S_RD         , BUS16, BUS8, TZ80Op(&Z80::decode));
+   }
+
+   // Address of memory operand (HL), or (IX+d)/(IY+d): d is read and 
+   // added to IX/IY into WZ in ts more T-states
+   template <class IDX>
+   constexpr Reg16 addIndexed(uint8_t ts) {
+      using namespace Reg;
+      if ( !IDX::DISP ) return HL;
+      addM23Read(PC, Z, TZ80Op(&Z80::inc, PC));
+      addM3alu  (ts, TZ80Op(&Z80::displace, WZ, IDX::RP));
+      return WZ;
+   }
+
+   // ED: Block instructions (op = ED A0-BB)
+   constexpr void exe_LDI(uint8_t op) {
+      using namespace Reg;
+      addM23Read (HL, BFl);
+      addM45Write(DE, BFl);
+      extendM    ();
+      extendM    (TZ80Op(&Z80::exe_block, op));
+   }
+
+   constexpr void exe_CPI(uint8_t op) {
+      using namespace Reg;
+      addM23Read (HL, BFl);
+      addM3alu   (5, TZ80Op(&Z80::exe_block, op));
+   }
+
+   // ED: Block IO (op = ED A2-BB). INs read port BC before decrementing
+   // B, OUTs decrement it first. WZ ends up as BC+1 (BC-1 stepping down)
+   constexpr void exe_INI(uint8_t op) {
+      using namespace Reg;
+      const TZ80Op step = ( op & 0x08 ) ? TZ80Op(&Z80::dec, WZ) : TZ80Op(&Z80::inc, WZ);
+      extendM  (TZ80Op(&Z80::assign, WZ, BC));
+      addIORead(BC, TZ80Op(&Z80::data_in, BFl), TZ80Op(step), TZ80Op(&Z80::dec, B));
+      add(0               , HL   , BUS8);
+      add(S_MREQ | S_WSMP , BUS16, BFl );
+      add(S_MREQ | S_WR   , BUS16, BUS8, TZ80Op(&Z80::exe_ioblock, op));
+   }
+
+   constexpr void exe_OUTI(uint8_t op) {
+      using namespace Reg;
+      const TZ80Op step = ( op & 0x08 ) ? TZ80Op(&Z80::dec, WZ) : TZ80Op(&Z80::inc, WZ);
+      extendM   (TZ80Op(&Z80::dec, B));
+      addM23Read(HL, BFl);
+      addIOWrite(BC, BFl, TZ80Op(&Z80::assign, WZ, BC), TZ80Op(step), TZ80Op(&Z80::exe_ioblock, op));
+   }
 
+   constexpr void exe_RxD(TZ80Op&& t) {
+      using namespace Reg;
+      addM23Read (HL, BFl);
+      addM3alu   (4, std::move(t));
+      addM45Write(HL, BFl);
+   }
+
+   //---------------------------------------------------------------------
+   // Opcode programs: M1/T4 (refresh) followed by instruction execution.
+   // They are decoded from the bitfields of the opcode:
+   //    x (bits 7-6), y (bits 5-3), z (bits 2-0), p (bits 5-4), q (bit 3)
+   // Opcodes not implemented yet are NOPs
+   //---------------------------------------------------------------------
+
+   // Main space, and DD/FD spaces (IDX = IndexIX/IndexIY)
+   template <class IDX>
+   constexpr void opcode(uint8_t op) {
+      using namespace Reg;
+      constexpr Reg8  r [8] = { B, C, D, E, IDX::HI, IDX::LO, BUS8, A };  // Registers
+      constexpr Reg8  rr[8] = { B, C, D, E, H, L, BUS8, A };              // Along with (IX+d)
+      constexpr Reg16 rp[4] = { BC, DE, IDX::RP, SP };                    // Register pairs
+      constexpr Reg8  hi[4] = { B, D, IDX::HI, A };                       // Pairs of PUSH/POP
+      constexpr Reg8  lo[4] = { C, E, IDX::LO, F };
+      const uint8_t x = op >> 6, y = (op >> 3) & 7, z = op & 7, p = y >> 1, q = y & 1;
+
+      addM1Refresh();
+      switch( x ) {
+         case 0:
+            switch( z ) {
+               case 0:
+                  if      ( y == 1 ) exe_EX_AF_AF();
+                  else if ( y == 3 ) exe_JR_n    ();
+                  else               exe_NOP     ();
+                  break;
+               case 1:
+                  if ( !q ) exe_LD_rp_nn(p == 3 ? S : hi[p], p == 3 ? P : lo[p]);
+                  break;
+               case 2:
+                  if      ( p <  2 && !q ) exe_LD_IrpI_r (rp[p], A);
+                  else if ( p <  2 )       exe_LD_r_IrpI (A, rp[p]);
+                  else if ( p == 2 && !q ) exe_LD_InnI_rp(IDX::HI, IDX::LO);
+                  else if ( p == 2 )       exe_LD_rp_InnI(IDX::HI, IDX::LO);
+                  else if ( !q )           exe_LD_InnI_r (A);
+                  else                     exe_LD_r_InnI (A);
+                  break;
+               case 3:
+                  if ( !q ) exe_INC_rp(rp[p]); else exe_DEC_rp(rp[p]);
+                  break;
+               case 4:
+                  if ( y == 6 ) exe_INC_IrpI(addIndexed<IDX>(5)); else exe_INC_r(r[y]);
+                  break;
+               case 5:
+                  if ( y == 6 ) exe_DEC_IrpI(addIndexed<IDX>(5)); else exe_DEC_r(r[y]);
+                  break;
+               case 6:
+                  if ( y != 6 )        exe_LD_r_n   (r[y]);
+                  else if ( IDX::DISP ) {
+                     // LD (IX+d), n: d is added while reading n
+                     addM23Read   (PC, Z, TZ80Op(&Z80::inc, PC));
+                     exe_LD_r_n   (BFl);
+                     addM3alu     (2, TZ80Op(&Z80::displace, WZ, IDX::RP));
+                     exe_LD_IrpI_r(WZ, BFl);
+                  }
+                  else                 exe_LD_IrpI_n(HL);
+                  break;
+               case 7:
+                  switch( y ) {
+                     case 0: exe_RLCA(); break;
+                     case 1: exe_RRCA(); break;
+                     case 2: exe_RLA (); break;
+                     case 3: exe_RRA (); break;
+                     case 4: exe_DAA (); break;
+                     case 5: exe_CPL (); break;
+                     case 6: exe_SCF (); break;
+                     case 7: exe_CCF (); break;
+                  }
+                  break;
+            }
+            break;
+         case 1:
+            // [[ LD r, r' ]] (H/L stay H/L along with (IX+d))
+            if      ( op == 0x76 ) exe_HALT();
+            else if ( z == 6 )     exe_LD_r_IrpI(rr[y], addIndexed<IDX>(5));
+            else if ( y == 6 )     exe_LD_IrpI_r(addIndexed<IDX>(5), rr[z]);
+            else                   exe_LD_r_r   (r[y], r[z]);
+            break;
+         case 2:
+            // [[ ALU A, r ]]
+            switch( y ) {
+               case 0: if ( z == 6 ) exe_ALU_IrpI<ALU::ADD>(addIndexed<IDX>(5)); else exe_ALU_r<ALU::ADD>(r[z]); break;
+               case 1: if ( z == 6 ) exe_ALU_IrpI<ALU::ADC>(addIndexed<IDX>(5)); else exe_ALU_r<ALU::ADC>(r[z]); break;
+               case 2: if ( z == 6 ) exe_ALU_IrpI<ALU::SUB>(addIndexed<IDX>(5)); else exe_ALU_r<ALU::SUB>(r[z]); break;
+               case 3: if ( z == 6 ) exe_ALU_IrpI<ALU::SBC>(addIndexed<IDX>(5)); else exe_ALU_r<ALU::SBC>(r[z]); break;
+               case 4: if ( z == 6 ) exe_ALU_IrpI<ALU::AND>(addIndexed<IDX>(5)); else exe_ALU_r<ALU::AND>(r[z]); break;
+               case 5: if ( z == 6 ) exe_ALU_IrpI<ALU::XOR>(addIndexed<IDX>(5)); else exe_ALU_r<ALU::XOR>(r[z]); break;
+               case 6: if ( z == 6 ) exe_ALU_IrpI<ALU::OR >(addIndexed<IDX>(5)); else exe_ALU_r<ALU::OR >(r[z]); break;
+               case 7: if ( z == 6 ) exe_ALU_IrpI<ALU::CP >(addIndexed<IDX>(5)); else exe_ALU_r<ALU::CP >(r[z]); break;
+            }
+            break;
+         case 3:
+            switch( z ) {
+               case 1:
+                  if      ( !q )     exe_POP_rp   (hi[p], lo[p]);
+                  else if ( p == 0 ) exe_RET      ();
+                  else if ( p == 1 ) exe_EXX      ();
+                  else if ( p == 2 ) exe_JP_IrpI  (IDX::RP);
+                  else if ( p == 3 ) exe_LD_rp_rp (SP, IDX::RP);
+                  break;
+               case 3:
+                  if      ( y == 0 ) exe_JP_nn     ();
+                  else if ( y == 1 ) { if ( IDX::DISP ) exe_prefix_CB<IDX>(); else exe_prefix(Space::CB); }
+                  else if ( y == 2 ) exe_OUT_n_A   ();
+                  else if ( y == 3 ) exe_IN_A_n    ();
+                  else if ( y == 4 ) exe_EX_ISPI_rp(IDX::RP, IDX::HI, IDX::LO);
+                  else if ( y == 5 ) exe_EX_rp_rp  (DE, HL);
+                  else if ( y == 6 ) exe_DI        ();
+                  else if ( y == 7 ) exe_EI        ();
+                  break;
+               case 5:
+                  if      ( !q )     exe_PUSH_rp(hi[p], lo[p]);
+                  else if ( p == 1 ) exe_prefix (Space::DD);
+                  else if ( p == 2 ) exe_prefix (Space::ED);
+                  else if ( p == 3 ) exe_prefix (Space::FD);
+                  break;
+               case 6:
+                  switch( y ) {
+                     case 0: exe_ALU_n<ALU::ADD>(); break;
+                     case 1: exe_ALU_n<ALU::ADC>(); break;
+                     case 2: exe_ALU_n<ALU::SUB>(); break;
+                     case 3: exe_ALU_n<ALU::SBC>(); break;
+                     case 4: exe_ALU_n<ALU::AND>(); break;
+                     case 5: exe_ALU_n<ALU::XOR>(); break;
+                     case 6: exe_ALU_n<ALU::OR >(); break;
+                     case 7: exe_ALU_n<ALU::CP >(); break;
+                  }
+                  break;
+               case 7:
+                  exe_RST(y * 8);
+                  break;
+            }
+            break;
+      }
+   }
+
+   // CB space, and DDCB/FDCB spaces (IDX = IndexIX/IndexIY), whose 
+   // programs go on after reading the opcode (see exe_prefix_CB), with
+   // (IX+d) in WZ. They always work on (IX+d), and their results are 
+   // also copied to register z (undocumented) but for z = 6 and BIT
+   template <class IDX>
+   constexpr void opcodeCB(uint8_t op) {
+      using namespace Reg;
+      constexpr Reg8 r[8] = { B, C, D, E, H, L, BUS8, A };
+      const uint8_t  x = op >> 6, z = op & 7;
+
+      if ( !IDX::DISP ) {
+         addM1Refresh();
+         if ( z != 6 ) { exec(TZ80Op(&Z80::cb, r[z], op)); return; }
+      } else {
+         extendM();
+         extendM();
+      }
+      const Reg16 addr = IDX::DISP ? WZ : HL;
+      addM23Read(addr, BFl);
+      extendM   (TZ80Op(&Z80::cb, BFl, uint8_t((op & 0xF8) | 6)));
+      if ( x == 1 ) return;
+      if ( IDX::DISP && z != 6 ) addM45Write(addr, BFl, TZ80Op(&Z80::assign, r[z], BFl));
+      else                       addM45Write(addr, BFl);
+   }
+
+   // ED space
+   constexpr void opcodeED(uint8_t op) {
+      using namespace Reg;
+      constexpr Reg16 rp[4] = { BC, DE, HL, SP };
+      constexpr Reg8  hi[4] = { B, D, H, S };
+      constexpr Reg8  lo[4] = { C, E, L, P };
+      constexpr Reg8  r [8] = { B, C, D, E, H, L, BFl, A };               // IN (C) / OUT (C), 0 use BFl
+      constexpr uint8_t im[8] = { 0, 0, 1, 2, 0, 0, 1, 2 };               // IM modes (y = 1, 4, 5 undocumented)
+      const uint8_t x = op >> 6, y = (op >> 3) & 7, z = op & 7, p = y >> 1, q = y & 1;
+
+      addM1Refresh();
+      if ( x == 1 ) {
+         switch( z ) {
+            case 0: exe_IN_r_C(r[y]);                                                           break;
+            case 1: if ( y == 6 ) exec(TZ80Op(&Z80::set, BFl, 0)); exe_OUT_C_r(r[y]);           break;
+            case 2: addM3alu(7, q ? TZ80Op(&Z80::adc16, rp[p]) : TZ80Op(&Z80::sbc16, rp[p])); break;
+            case 3: if ( !q ) exe_LD_InnI_rp(hi[p], lo[p]); else exe_LD_rp_InnI(hi[p], lo[p]);  break;
+            case 4: exec(TZ80Op(&Z80::exe_NEG));                                                break;
+            case 5: exe_RETN();                                                                 break;
+            case 6: exe_IM(im[y]);                                                              break;
+            case 7:
+               switch( y ) {
+                  case 0: extendM(TZ80Op(&Z80::assign, I, A));      break;
+                  case 1: extendM(TZ80Op(&Z80::assign, R, A));      break;
+                  case 2: extendM(TZ80Op(&Z80::exe_LD_A_IR, I));    break;
+                  case 3: extendM(TZ80Op(&Z80::exe_LD_A_IR, R));    break;
+                  case 4: exe_RxD(TZ80Op(&Z80::exe_RRD));           break;
+                  case 5: exe_RxD(TZ80Op(&Z80::exe_RLD));           break;
+               }
+               break;
+         }
+      } else if ( x == 2 && y >= 4 ) {
+         if      ( z == 0 ) exe_LDI (op);
+         else if ( z == 1 ) exe_CPI (op);
+         else if ( z == 2 ) exe_INI (op);
+         else if ( z == 3 ) exe_OUTI(op);
+      }
+   }
+
+   // Finish program p, sharing the T-states of program other when equal
+   constexpr void share(uint16_t other) {
+      const TProgram& o = m_t.prg[other];
+      const TProgram& c = m_t.prg[m_prg];
+      if ( o.length != c.length || !(o.exec == c.exec) ) return;
+      for (uint16_t i = 0; i < c.length; ++i)
+         if ( !(m_t.ts[o.first + i] == m_t.ts[c.first + i]) ) return;
+      m_t.used       = c.first;
+      m_t.prg[m_prg] = o;
+   }
+
+public:
+   // Programs of space s added to table t. Every space is built in a
+   // constant evaluation of its own, to stay within compiler limits
+   static constexpr TProgramTable build(const TProgramTable& t, Space s) {
+      TProgramBuilder b;
+      b.m_t = t;
+      if ( s == Space::Main ) {
+         b.begin(TProgramTable::PRG_M1);
+         b.addM1();
+         b.begin(TProgramTable::PRG_HALT);
+         b.addHALTNOP();
+         b.begin(TProgramTable::PRG_REPEAT);
+         b.addM3alu(5, TZ80Op(&Z80::exe_repeat));
+         b.begin(TProgramTable::PRG_REPEAT_IO);
+         b.addM3alu(4, TZ80Op(&Z80::dec, Reg::PC));
+         b.extendM (TZ80Op(&Z80::dec, Reg::PC));
+         b.begin(TProgramTable::PRG_NMI);
+         b.exe_NMI();
+         for (uint8_t mode = 0; mode < 3; ++mode) {
+            b.begin(TProgramTable::PRG_IM0 + mode);
+            b.exe_INT(mode);
+         }
+      }
+      for (uint16_t op = 0; op < 0x100; ++op) {
+         const uint16_t main = TProgramTable::program(Space::Main, op);
+         b.begin(TProgramTable::program(s, op));
+         switch( s ) {
+            case Space::Main: b.opcode<IndexHL>(op);                                   break;
+            case Space::DD:   b.opcode<IndexIX>(op);   b.share(main);                  break;
+            case Space::FD:   b.opcode<IndexIY>(op);   b.share(main);                  break;
+            case Space::ED:   b.opcodeED(op);          b.share(TProgramTable::program(Space::Main, 0x00)); break;
+            case Space::CB:   b.opcodeCB<IndexHL>(op);                                 break;
+            case Space::DDCB: b.opcodeCB<IndexIX>(op);                                 break;
+            case Space::FDCB: b.opcodeCB<IndexIY>(op); b.share(TProgramTable::program(Space::DDCB, op)); break;
+            case Space::count:                                                         break;
+         }
+      }
+      return b.m_t;
+   }
+};
+
+// All T-state programs, generated at compile time, space by space
+static constexpr TProgramTable s_tpMain = TProgramBuilder::build(TProgramTable{}, Space::Main);
+static constexpr TProgramTable s_tpCB   = TProgramBuilder::build(s_tpMain, Space::CB);
+static constexpr TProgramTable s_tpED   = TProgramBuilder::build(s_tpCB,   Space::ED);
+static constexpr TProgramTable s_tpDD   = TProgramBuilder::build(s_tpED,   Space::DD);
+static constexpr TProgramTable s_tpFD   = TProgramBuilder::build(s_tpDD,   Space::FD);
+static constexpr TProgramTable s_tpDDCB = TProgramBuilder::build(s_tpFD,   Space::DDCB);
+constexpr TProgramTable g_tprograms     = TProgramBuilder::build(s_tpDDCB, Space::FDCB);
+static_assert(g_tprograms.used <= TProgramTable::capacity);
+
+// Idle loop of opcode op, whose iterations run program prg (after M1,
+// but for the HALT NOP)
+static constexpr IdleLoop
+idleLoop(uint8_t op, uint16_t prg) {
+   IdleLoop l { g_tprograms.end(prg), op, 0, 0, {} };
+   for (uint16_t p : { TProgramTable::PRG_M1, prg }) {
+      if ( p == TProgramTable::PRG_M1 && prg == TProgramTable::PRG_HALT ) continue;
+      for (uint16_t i = g_tprograms.begin(p); i < g_tprograms.end(p); ++i, ++l.ticks)
+         if ( g_tprograms.ts[i].signals & S_WSMP ) l.wsamp[l.samples++] = l.ticks;
+   }
+   return l;
+}
+constexpr std::array<IdleLoop, 4> g_idleLoops = {{
+      idleLoop(0x76, TProgramTable::PRG_HALT)
+   ,  idleLoop(0x18, TProgramTable::program(Space::Main, 0x18))
+   ,  idleLoop(0xC3, TProgramTable::program(Space::Main, 0xC3))
+   ,  idleLoop(0xE9, TProgramTable::program(Space::Main, 0xE9))
+}};
 
-} // Namespace Z80CPP
\ No newline at end of file
+} // Namespace Z80CPP
@@ -1,5 +1,7 @@
 #pragma once
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 
 namespace Z80CPP {
@@ -36,7 +38,7 @@ struct Registers {
    REGPAIR(SP,   S,   P);
    REGPAIR(IR,   I,   R);
    REGPAIR(BUF, BFh, BFl); // Data Buffer (not really on Z80, but useful)
-   uint16_t PC;
+   REGPAIR(PC,  PCh, PCl);
    Registers() { 
       // Set all register memory to 0 at once
       std::memset(this, 0, sizeof(Registers));
@@ -45,16 +47,168 @@ struct Registers {
 
 
 //
-// TZ80Op: Encapsulates an operation (member function) to be performed 
-// (called) on a given TState. The operation is stored in a union to
-// save space, along with its parameters (if it has). m_type contains
-// the type of operation being contained, which lets us use the appropriate
-// bytes of the union and call a valid member function.
+// Reg8 / Reg16: Position-independent references to 8/16-bit registers.
+// They hold the byte offset of the register inside Registers, so T-state
+// programs can be built at compile time and shared by every Z80 instance.
+// BUS8/BUS16 are special references meaning "keep current bus value".
+//
+struct Reg8  { uint8_t off; };
+struct Reg16 { uint8_t off; };
+constexpr bool operator==(Reg8  a, Reg8  b) { return a.off == b.off; }
+constexpr bool operator!=(Reg8  a, Reg8  b) { return a.off != b.off; }
+constexpr bool operator==(Reg16 a, Reg16 b) { return a.off == b.off; }
+constexpr bool operator!=(Reg16 a, Reg16 b) { return a.off != b.off; }
+
+namespace Reg {
+   #define REG8(NAME, FIELD)  constexpr Reg8  NAME { offsetof(Registers, FIELD) };
+   #define REG16(NAME, FIELD) constexpr Reg16 NAME { offsetof(Registers, FIELD) };
+   REG8 (A  , main.A) REG8 (F  , main.F) REG16(AF , main.AF)
+   REG8 (B  , main.B) REG8 (C  , main.C) REG16(BC , main.BC)
+   REG8 (D  , main.D) REG8 (E  , main.E) REG16(DE , main.DE)
+   REG8 (H  , main.H) REG8 (L  , main.L) REG16(HL , main.HL)
+   REG8 (A_ ,  alt.A) REG8 (F_ ,  alt.F) REG16(AF_,  alt.AF)
+   REG8 (B_ ,  alt.B) REG8 (C_ ,  alt.C) REG16(BC_,  alt.BC)
+   REG8 (D_ ,  alt.D) REG8 (E_ ,  alt.E) REG16(DE_,  alt.DE)
+   REG8 (H_ ,  alt.H) REG8 (L_ ,  alt.L) REG16(HL_,  alt.HL)
+   REG8 (IXh,    IXh) REG8 (IXl,    IXl) REG16(IX ,     IX)
+   REG8 (IYh,    IYh) REG8 (IYl,    IYl) REG16(IY ,     IY)
+   REG8 (W  ,      W) REG8 (Z  ,      Z) REG16(WZ ,     WZ)
+   REG8 (S  ,      S) REG8 (P  ,      P) REG16(SP ,     SP)
+   REG8 (I  ,      I) REG8 (R  ,      R) REG16(IR ,     IR)
+   REG8 (BFh,    BFh) REG8 (BFl,    BFl) REG16(BUF,    BUF)
+   REG8 (PCh,    PCh) REG8 (PCl,    PCl) REG16(PC ,     PC)
+   #undef REG8
+   #undef REG16
+   constexpr Reg8  BUS8  { 0xFF };
+   constexpr Reg16 BUS16 { 0xFF };
+}
+
+//
+// Space: Opcode spaces. Prefixes CB, ED, DD and FD make the next opcode
+// be decoded from their space. DD CB and FD CB are followed by a 
+// displacement and an opcode from the DDCB/FDCB spaces
+//
+enum class Space : uint8_t { Main, CB, ED, DD, FD, DDCB, FDCB, count };
+
+constexpr bool isPrefix(uint8_t op) {
+   return op == 0xCB || op == 0xDD || op == 0xED || op == 0xFD;
+}
+
+//
+// Index registers of Main, DD and FD spaces. DD and FD opcodes are the
+// Main ones with IX/IY in place of HL (and their halves in place of H
+// and L), and (IX+d)/(IY+d) in place of (HL), with a displacement d
+// after the opcode. Both engines take them as a template parameter, so
+// the three variants of every opcode come from the same code.
+//
+struct IndexHL {
+   static constexpr Reg16 RP = Reg::HL;
+   static constexpr Reg8  HI = Reg::H,   LO = Reg::L;
+   static constexpr bool  DISP    = false;      // (HL) has a displacement
+   static constexpr Space CBSPACE = Space::CB;  // Space of CB-prefixed opcodes
+};
+struct IndexIX {
+   static constexpr Reg16 RP = Reg::IX;
+   static constexpr Reg8  HI = Reg::IXh, LO = Reg::IXl;
+   static constexpr bool  DISP    = true;
+   static constexpr Space CBSPACE = Space::DDCB;
+};
+struct IndexIY {
+   static constexpr Reg16 RP = Reg::IY;
+   static constexpr Reg8  HI = Reg::IYh, LO = Reg::IYl;
+   static constexpr bool  DISP    = true;
+   static constexpr Space CBSPACE = Space::FDCB;
+};
+
+//
+// UOp: Micro-operations that T-states can perform. Every one stands for
+// the Z80 member function it behaves like, which also identifies it when
+// programs are built (X-macro: expanded wherever the list is needed).
+//
+#define Z80CPP_UOPS(X)                                              \
+   X(NOP            , TZ80Op::Handler()                          )  \
+   X(decode         , &Z80::decode                               )  \
+   X(inc7           , &Z80::inc7                                 )  \
+   X(inc8           , TZ80Op::_1PU8RefFp (&Z80::inc)             )  \
+   X(inc16          , TZ80Op::_1PU16RefFp(&Z80::inc)             )  \
+   X(dec8           , TZ80Op::_1PU8RefFp (&Z80::dec)             )  \
+   X(dec16          , TZ80Op::_1PU16RefFp(&Z80::dec)             )  \
+   X(assign8        , TZ80Op::_2PU8RefFp (&Z80::assign)          )  \
+   X(assign16       , TZ80Op::_2PU16RefFp(&Z80::assign)          )  \
+   X(data_in        , &Z80::data_in                              )  \
+   X(data_in_assign , &Z80::data_in_assign                       )  \
+   X(data_in_flags  , &Z80::data_in_flags                        )  \
+   X(set8           , &Z80::set                                  )  \
+   X(add            , &Z80::add                                  )  \
+   X(exe_HALT       , &Z80::exe_HALT                             )  \
+   X(exe_EX_rp_rp   , &Z80::exe_EX_rp_rp                         )  \
+   X(exe_EXX        , &Z80::exe_EXX                              )  \
+   X(exe_LD_r_r     , &Z80::exe_LD_r_r                           )  \
+   X(exe_LD_rp_rp   , &Z80::exe_LD_rp_rp                         )  \
+   X(exe_JP_IrpI    , &Z80::exe_JP_IrpI                          )  \
+   X(exe_EX_AF_AF   , &Z80::exe_EX_AF_AF                         )  \
+   X(exe_evalF      , &Z80::exe_evalF                            )  \
+   X(exe_RLCA       , &Z80::exe_RLCA                             )  \
+   X(exe_RRCA       , &Z80::exe_RRCA                             )  \
+   X(exe_RLA        , &Z80::exe_RLA                              )  \
+   X(exe_RRA        , &Z80::exe_RRA                              )  \
+   X(exe_DAA        , &Z80::exe_DAA                              )  \
+   X(exe_CPL        , &Z80::exe_CPL                              )  \
+   X(exe_SCF        , &Z80::exe_SCF                              )  \
+   X(exe_CCF        , &Z80::exe_CCF                              )  \
+   X(inc_alu        , &Z80::inc_alu                              )  \
+   X(dec_alu        , &Z80::dec_alu                              )  \
+   X(alu_ADD        , &Z80::alu<ALU::ADD>                        )  \
+   X(alu_ADC        , &Z80::alu<ALU::ADC>                        )  \
+   X(alu_SUB        , &Z80::alu<ALU::SUB>                        )  \
+   X(alu_SBC        , &Z80::alu<ALU::SBC>                        )  \
+   X(alu_AND        , &Z80::alu<ALU::AND>                        )  \
+   X(alu_XOR        , &Z80::alu<ALU::XOR>                        )  \
+   X(alu_OR         , &Z80::alu<ALU::OR >                        )  \
+   X(alu_CP         , &Z80::alu<ALU::CP >                        )  \
+   X(data_in_ADD    , &Z80::data_in_alu<ALU::ADD>                )  \
+   X(data_in_ADC    , &Z80::data_in_alu<ALU::ADC>                )  \
+   X(data_in_SUB    , &Z80::data_in_alu<ALU::SUB>                )  \
+   X(data_in_SBC    , &Z80::data_in_alu<ALU::SBC>                )  \
+   X(data_in_AND    , &Z80::data_in_alu<ALU::AND>                )  \
+   X(data_in_XOR    , &Z80::data_in_alu<ALU::XOR>                )  \
+   X(data_in_OR     , &Z80::data_in_alu<ALU::OR >                )  \
+   X(data_in_CP     , &Z80::data_in_alu<ALU::CP >                )  \
+   X(prefix         , &Z80::prefix                               )  \
+   X(displace       , &Z80::displace                             )  \
+   X(cb             , &Z80::cb                                   )  \
+   X(adc16          , &Z80::adc16                                )  \
+   X(sbc16          , &Z80::sbc16                                )  \
+   X(exe_NEG        , &Z80::exe_NEG                              )  \
+   X(exe_LD_A_IR    , &Z80::exe_LD_A_IR                          )  \
+   X(exe_RLD        , &Z80::exe_RLD                              )  \
+   X(exe_RRD        , &Z80::exe_RRD                              )  \
+   X(exe_block      , &Z80::exe_block                            )  \
+   X(exe_repeat     , &Z80::exe_repeat                           )  \
+   X(exe_ioblock    , &Z80::exe_ioblock                          )  \
+   X(exe_DI         , &Z80::exe_DI                               )  \
+   X(exe_EI         , &Z80::exe_EI                               )  \
+   X(exe_IM         , &Z80::exe_IM                               )  \
+   X(exe_RETN       , &Z80::exe_RETN                             )  \
+   X(exe_RST        , &Z80::exe_RST                              )
+
+enum class UOp : uint8_t {
+   #define Z80CPP_UOP_ENUM(NAME, FP) NAME,
+   Z80CPP_UOPS(Z80CPP_UOP_ENUM)
+   #undef Z80CPP_UOP_ENUM
+   count
+};
+
+//
+// TZ80Op: Encapsulates an operation to be performed on a given TState.
+// To keep T-states compact, the operation is just its UOp, along with
+// the registers it takes as parameters (if it has), or an immediate 
+// value (Imm types). Z80::perform() is the interpreter that executes them.
 //
 class Z80;
 struct TZ80Op {
    // Classes of functions that this object manages
-   enum class Type {
+   enum class Type : uint8_t {
          NOP
       ,  VOID
       ,  _1PU8Ref
@@ -63,6 +217,8 @@ struct TZ80Op {
       ,  _2PU16Ref
       ,  _2PU16U8Ref
       ,  _3PU8U16U16Ref
+      ,  _1PImm
+      ,  _2PU8RefImm
    };
    // Type aliases for function pointers
    using VOIDFp       = void(Z80::*)(void);
@@ -72,125 +228,69 @@ struct TZ80Op {
    using _2PU16RefFp  = void(Z80::*)(uint16_t&,uint16_t&);
    using _2PU16U8RefFp = void(Z80::*)(uint16_t&,uint8_t&);
    using _3PU8U16U16RefFp = void(Z80::*)(uint8_t&,uint16_t&,uint16_t&);
+   using _1PImmFp     = void(Z80::*)(uint8_t);
+   using _2PU8RefImmFp = void(Z80::*)(uint8_t&,uint8_t);
 
-   // Explicit constructors for functions types
-   explicit TZ80Op()                : m_type(Type::NOP) {} 
-   explicit TZ80Op( VOIDFp f )      : m_type(Type::VOID), m_fv(f) {}
-   explicit TZ80Op( _1PU8RefFp f, uint8_t& p ) 
-      : m_type(Type::_1PU8Ref), m_f1u8r(f), m_f1u8r_p(&p) {}
-   explicit TZ80Op( _1PU16RefFp f, uint16_t& p ) 
-      : m_type(Type::_1PU16Ref), m_f1u16r(f), m_f1u16r_p(&p) {}
-   explicit TZ80Op( _2PU8RefFp f, uint8_t& p1, uint8_t& p2 ) 
-      : m_type(Type::_2PU8Ref), m_f2u8r(f), m_f2u8r_p1(&p1), m_f2u8r_p2(&p2) {}
-   explicit TZ80Op( _2PU16RefFp f, uint16_t& p1, uint16_t& p2 ) 
-      : m_type(Type::_2PU16Ref), m_f2u16r(f), m_f2u16r_p1(&p1), m_f2u16r_p2(&p2) {}
-   explicit TZ80Op( _2PU16U8RefFp f, uint16_t& p1, uint8_t& p2 ) 
-      : m_type(Type::_2PU16U8Ref), m_f2u16u8r(f), m_f2u16u8r_p1(&p1), m_f2u16u8r_p2(&p2) {}
-   explicit TZ80Op( _3PU8U16U16RefFp f, uint8_t& p1, uint16_t& p2, uint16_t& p3 ) 
-      : m_type(Type::_3PU8U16U16Ref), m_f3u8u16u16r(f), m_f3u8u16u16r_p1(&p1), m_f3u8u16u16r_p2(&p2), m_f3u8u16u16r_p3(&p3) {}
+   //
+   // Handler: Member function a micro-operation stands for, and its type.
+   // It lets TProgramBuilder name micro-operations by member function,
+   // which also checks the type of their register parameters.
+   //
+   struct Handler {
+      constexpr Handler()                          : m_type(Type::NOP), m_fv(nullptr) {}
+      constexpr Handler( VOIDFp f )                : m_type(Type::VOID), m_fv(f) {}
+      constexpr Handler( _1PU8RefFp f )            : m_type(Type::_1PU8Ref), m_f1u8r(f) {}
+      constexpr Handler( _1PU16RefFp f )           : m_type(Type::_1PU16Ref), m_f1u16r(f) {}
+      constexpr Handler( _2PU8RefFp f )            : m_type(Type::_2PU8Ref), m_f2u8r(f) {}
+      constexpr Handler( _2PU16RefFp f )           : m_type(Type::_2PU16Ref), m_f2u16r(f) {}
+      constexpr Handler( _2PU16U8RefFp f )         : m_type(Type::_2PU16U8Ref), m_f2u16u8r(f) {}
+      constexpr Handler( _3PU8U16U16RefFp f )      : m_type(Type::_3PU8U16U16Ref), m_f3u8u16u16r(f) {}
+      constexpr Handler( _1PImmFp f )              : m_type(Type::_1PImm), m_f1i(f) {}
+      constexpr Handler( _2PU8RefImmFp f )         : m_type(Type::_2PU8RefImm), m_f2u8ri(f) {}
+      constexpr bool operator==(const Handler& h) const;
 
-   // Set new function and type
-   void reset() {
-      m_type = Type::NOP;
-   }
-   void set( VOIDFp     f ) { 
-      m_type = Type::VOID;
-      m_fv = f; 
-   }
-   void set( _1PU8RefFp f, uint8_t& p ) { 
-      m_type = Type::_1PU8Ref;
-      m_f1u8r = f;
-      m_f1u8r_p = &p;
-   }
-   void set( _1PU16RefFp f, uint16_t& p ) { 
-      m_type = Type::_1PU16Ref;
-      m_f1u16r = f;
-      m_f1u16r_p = &p;
-   }
-   void set( _2PU8RefFp f, uint8_t& p1, uint8_t& p2 ) { 
-      m_type = Type::_2PU8Ref;
-      m_f2u8r = f;
-      m_f2u8r_p1 = &p1;
-      m_f2u8r_p2 = &p2;
-   }
-   void set( _2PU16RefFp f, uint16_t& p1, uint16_t& p2 ) { 
-      m_type = Type::_2PU16Ref;
-      m_f2u16r = f;
-      m_f2u16r_p1 = &p1;
-      m_f2u16r_p2 = &p2;
-   }
-   void set( _2PU16U8RefFp f, uint16_t& p1, uint8_t& p2 ) { 
-      m_type = Type::_2PU16U8Ref;
-      m_f2u16u8r = f;
-      m_f2u16u8r_p1 = &p1;
-      m_f2u16u8r_p2 = &p2;
-   }
-   void set(_3PU8U16U16RefFp f, uint8_t& p1, uint16_t& p2, uint16_t& p3 ) { 
-      m_type = Type::_3PU8U16U16Ref;
-      m_f3u8u16u16r = f;
-      m_f3u8u16u16r_p1 = &p1;
-      m_f3u8u16u16r_p2 = &p2;
-      m_f3u8u16u16r_p3 = &p3;
-   }
+      Type m_type;     //< Type of operation
+      union {
+         VOIDFp            m_fv;          // Type 0: void (Z80::*)()
+         _1PU8RefFp        m_f1u8r;       // Type 1: void (Z80::*)(uint8_t&)
+         _1PU16RefFp       m_f1u16r;      // Type 2: void (Z80::*)(uint16_t&)
+         _2PU8RefFp        m_f2u8r;       // Type 3: void (Z80::*)(uint8_t&, uint8_t&)
+         _2PU16RefFp       m_f2u16r;      // Type 4: void (Z80::*)(uint16_t&, uint16_t&)
+         _2PU16U8RefFp     m_f2u16u8r;    // Type 5: void (Z80::*)(uint16_t&, uint8_t&)
+         _3PU8U16U16RefFp  m_f3u8u16u16r; // Type 6: void (Z80::*)(uint8_t&, uint16_t&, uint16_t&)
+         _1PImmFp          m_f1i;         // Type 7: void (Z80::*)(uint8_t)
+         _2PU8RefImmFp     m_f2u8ri;      // Type 8: void (Z80::*)(uint8_t&, uint8_t)
+      };
+   };
 
-   // Call contained function
-   void operator()(Z80& cpu) const {
-      // Produce member function call depending on m_type
-      switch(m_type) {
-         case Type::VOID:      (cpu.*m_fv    )(); break;
-         case Type::_1PU8Ref:  (cpu.*m_f1u8r )(*m_f1u8r_p ); break;
-         case Type::_1PU16Ref: (cpu.*m_f1u16r)(*m_f1u16r_p); break;
-         case Type::_2PU8Ref:  (cpu.*m_f2u8r) (*m_f2u8r_p1, *m_f2u8r_p2); break;
-         case Type::_2PU16Ref: (cpu.*m_f2u16r)(*m_f2u16r_p1, *m_f2u16r_p2); break;
-         case Type::_2PU16U8Ref:(cpu.*m_f2u16u8r)(*m_f2u16u8r_p1, *m_f2u16u8r_p2); break;
-         case Type::_3PU8U16U16Ref:(cpu.*m_f3u8u16u16r)(*m_f3u8u16u16r_p1, *m_f3u8u16u16r_p2, *m_f3u8u16u16r_p3); break;
-         case Type::NOP: break;         
-      }
-   }
+   // Explicit constructors for functions types 
+   // (Defined in Z80.hpp, they look up the UOp of the function)
+   constexpr explicit TZ80Op() = default;
+   constexpr explicit TZ80Op( VOIDFp f );
+   constexpr explicit TZ80Op( _1PU8RefFp f, Reg8 p );
+   constexpr explicit TZ80Op( _1PU16RefFp f, Reg16 p );
+   constexpr explicit TZ80Op( _2PU8RefFp f, Reg8 p1, Reg8 p2 );
+   constexpr explicit TZ80Op( _2PU16RefFp f, Reg16 p1, Reg16 p2 );
+   constexpr explicit TZ80Op( _2PU16U8RefFp f, Reg16 p1, Reg8 p2 );
+   constexpr explicit TZ80Op( _3PU8U16U16RefFp f, Reg8 p1, Reg16 p2, Reg16 p3 );
+   constexpr explicit TZ80Op( _1PImmFp f, uint8_t imm );
+   constexpr explicit TZ80Op( _2PU8RefImmFp f, Reg8 p1, uint8_t imm );
 
-   bool empty() const { return m_type == Type::NOP; }
+   constexpr UOp     uop()   const { return m_uop; }
+   constexpr uint8_t p1()    const { return m_p1;  }
+   constexpr uint8_t p2()    const { return m_p2;  }
+   constexpr uint8_t p3()    const { return m_p3;  }
+   constexpr bool    empty() const { return m_uop == UOp::NOP; }
+   constexpr bool    operator==(const TZ80Op& o) const {
+      return m_uop == o.m_uop && m_p1 == o.m_p1 && m_p2 == o.m_p2 && m_p3 == o.m_p3;
+   }
 
 private:
-   Type m_type;     //< Type of operation
-   union {
-      // Type 0: void (Z80::*)()
-      struct { VOIDFp m_fv; };
-      // Type 1: void (Z80::*)(uint8_t&)
-      struct {
-         _1PU8RefFp  m_f1u8r;
-         uint8_t*    m_f1u8r_p;
-      };
-      // Type 2: void (Z80::*)(uint16_t&)
-      struct {
-         _1PU16RefFp  m_f1u16r;
-         uint16_t*    m_f1u16r_p;
-      };
-      // Type 3: void (Z80::*)(uint8_t&, uint8_t&)
-      struct {
-         _2PU8RefFp  m_f2u8r;
-         uint8_t*    m_f2u8r_p1;
-         uint8_t*    m_f2u8r_p2;
-      };
-      // Type 4: void (Z80::*)(uint16_t&, uint16_t&)
-      struct {
-         _2PU16RefFp  m_f2u16r;
-         uint16_t*    m_f2u16r_p1;
-         uint16_t*    m_f2u16r_p2;
-      };
-      // Type 5: void (Z80::*)(uint16_t&, int16_t)
-      struct {
-         _2PU16U8RefFp m_f2u16u8r;
-         uint16_t*    m_f2u16u8r_p1;
-         uint8_t*     m_f2u16u8r_p2;
-      };
-      // Type 6: void (Z80::*)(uint8_t&, uint16_t&, int16_t)
-      struct {
-         _3PU8U16U16RefFp m_f3u8u16u16r;
-         uint8_t*     m_f3u8u16u16r_p1;
-         uint16_t*    m_f3u8u16u16r_p2;
-         uint16_t*    m_f3u8u16u16r_p3;
-      };
-   };
+   static const Handler handlers[];              // Handlers of all UOps (Z80.hpp)
+   static constexpr UOp find(const Handler& h);
+
+   UOp     m_uop = UOp::NOP;              //< Micro-operation
+   uint8_t m_p1 = 0, m_p2 = 0, m_p3 = 0;  //< Parameters (Reg8/Reg16 offsets or immediate)
 };
 
 //
@@ -207,78 +307,89 @@ enum class Signal : uint16_t {
    ,  HALT  = 0x0100
    ,  WAIT  = 0x0080
    ,  WSAMP = 0x0040  //< WAIT SAMPLE DOES NOT EXIST IN THE Z80 (Just used to know when it has to sample WAIT INPUT SIGNAL)
+   ,  INT   = 0x0020  //< Maskable interrupt request (input)
+   ,  NMI   = 0x0010  //< Non-maskable interrupt request (input)
 };
 
 //
 // TState: Status of the Z80 after a given TState
-//   It defines how pinouts should be, and an operation
-//   to be performed
+//   It defines how pinouts should be (which registers drive the
+//   address and data buses), and an operation to be performed
 // WARNING: 
 //    Z80 uses negative logic for all in/out signals (0 = ON), except
 // data and address buses. However, this codifies signals as positive
 // logic (1 = ON) for clarity.
 //
 struct TState {
-         uint16_t  signals = 0;
-   const uint16_t* addr    = nullptr; 
-   const uint8_t*  data    = nullptr;
-          TZ80Op   op      = TZ80Op();
-   TState() = default;
-   TState(uint16_t s, const uint16_t* a, const uint8_t* d, TZ80Op&& o)
-      : signals(s), addr(a), data(d), op(std::move(o)) {}
-   void set(uint16_t s, const uint16_t* a, const uint8_t* d, TZ80Op&& o) {
-      signals = s; addr = a; data = d;
-      op = std::move(o);
+   uint16_t  signals = 0;     // 8 bytes in total
+   Reg16     addr    = Reg::BUS16;
+   Reg8      data    = Reg::BUS8;
+   TZ80Op    op      = TZ80Op();
+   constexpr TState() = default;
+   constexpr TState(uint16_t s, Reg16 a, Reg8 d, TZ80Op o = TZ80Op())
+      : signals(s), addr(a), data(d), op(o) {}
+   constexpr bool operator==(const TState& t) const {
+      return signals == t.signals && addr == t.addr && data == t.data && op == t.op;
    }
 };
 
 //
-// Compiletime Bitwise checking that a unit 
-// greater than 0 is a power of 2
-// It requires to have only one bit on
+// TProgram: Static sequence of T-states for a complete machine operation.
+// Fetch programs (M1, HALT NOP) do T1-T3 of M1, then the decoded opcode
+// program does T4 and the rest of the instruction. exec is an operation 
+// performed at decode time (M1/T3), before the opcode program starts.
 //
-constexpr bool isPowerOf2(uint8_t p) {
-   if (!p) return false;
-   while (p > 1) {
-      if (p & 1) return false;
-      p >>= 1;
-   }
-   return true;
-}
+struct TProgram {
+   TZ80Op   exec   = TZ80Op();  // Operation performed when decoded
+   uint16_t first  = 0;         // Index of its first T-state
+   uint16_t length = 0;         // Number of T-states
+};
 
 //
-// TVecOps: Class for encapsulating a fixed-length 
-// vector of pending operations (t-states) to perform
+// TProgramTable: Read-only T-state programs for all opcodes, generated
+// at compile time (Z80_tqueue.cpp). CPUs walk an index through them
+// instead of queueing T-states at runtime. Opcode programs make a flat
+// table indexed by space and opcode (program()). Opcodes of a space 
+// behaving just as in another one share its T-states.
 //
-class TVecOps {
-   static constexpr uint8_t length = 32;  // Must be a power of 2!
-   static_assert(isPowerOf2(length));
-   
-   std::array<TState, length> ops;        // Queue of T-state operations
-   uint8_t next = 0;                      // ID of next operation to be performed
-   uint8_t last = 0;                      // Last operation queued
-   Z80& cpu;                              // Access to the CPU status
-   
-   // Increment an ID accessing the array in a circular way 
-   // When ++ arrives at the length, it returns to 0. This
-   // Assumes length is a power of two to do modulus using AND
-   inline void inc(uint8_t& v) { v = (v+1) & (length-1); }
-public:
-   TVecOps(Z80& c) : cpu(c) {}
-   void addM1();
-   void addHALTNOP();
-   void addM23Read      (uint16_t& addr, uint8_t& in_reg, TZ80Op&& t0 = TZ80Op());
-   void addM3ReadAssign (uint16_t& read_reg, uint8_t& in_reg, uint16_t& to_reg, uint16_t& from_reg);
-   void addM45Read      (uint16_t& read_addr, uint8_t& in_reg, TZ80Op&& t);
-   void addM45Write     (uint16_t& addr, uint8_t& data, TZ80Op&& t = TZ80Op());
-   void addM3alu        (uint8_t ts, TZ80Op&& tend);
+struct TProgramTable {
+   static constexpr uint16_t PRG_M1     = (uint16_t)Space::count << 8; // Fetch and decode next opcode
+   static constexpr uint16_t PRG_HALT   = PRG_M1 + 1;    // HALT NOP cycle
+   static constexpr uint16_t PRG_REPEAT = PRG_M1 + 2;    // Repetition of LDIR, CPIR...
+   static constexpr uint16_t PRG_NMI    = PRG_M1 + 3;    // NMI acknowledge (RST 66h)
+   static constexpr uint16_t PRG_IM0    = PRG_M1 + 4;    // INT acknowledge in IM 0, 1 and 2
+   static constexpr uint16_t PRG_IM1    = PRG_M1 + 5;
+   static constexpr uint16_t PRG_IM2    = PRG_M1 + 6;
+   static constexpr uint16_t PRG_REPEAT_IO = PRG_M1 + 7; // Repetition of INIR, OTIR...
+   static constexpr uint16_t programs   = PRG_M1 + 8;    // Total programs
+   static constexpr uint16_t capacity   = 8192;          // Maximum T-states
+
+   std::array<TProgram, programs> prg {};
+   std::array<TState,   capacity> ts  {};
+   uint16_t                       used = 0;       // T-states in use
 
-   void extendM(TZ80Op&& t = TZ80Op());
+   // Program of opcode op in space s
+   static constexpr uint16_t program(Space s, uint8_t op) { return (uint16_t)s << 8 | op; }
+   constexpr uint16_t begin(uint16_t p) const { return prg[p].first; }          // Index of first T-state
+   constexpr uint16_t end  (uint16_t p) const { return begin(p) + prg[p].length; }  // Index past last T-state
+};
+extern const TProgramTable g_tprograms;
 
-   void add(TState& newop) { ops[last] = newop; inc(last);  }
-   const TState&  get()    { return ops[next];              }
-   void pop()              { inc(next);                     }
-   bool empty()            { return next == last;           }
+//
+// IdleLoop: Instruction that loops on itself changing nothing but R and 
+// the ticks: the HALT NOP, and JR $, JP $ and JP (HL) (with HL == PC) 
+// once they have jumped to themselves. Every iteration refreshes once
+// and takes ticks T-states plus the wait states of its WSAMP T-states,
+// the i-th one accessing PC+i at T-state wsamp[i] of the iteration
+// (counted without waits). end is m_tend after every iteration
+//
+struct IdleLoop {
+   uint16_t end;          // End of the program ending every iteration
+   uint8_t  opcode;       // 0x76 for the HALT NOP
+   uint8_t  ticks;        // T-states without waits
+   uint8_t  samples;      // WSAMP T-states
+   uint8_t  wsamp[3];     // Their T-state numbers
 };
+extern const std::array<IdleLoop, 4> g_idleLoops;
 
 } // Namespace Z80CPP
\ No newline at end of file
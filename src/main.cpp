@@ -1,44 +1,36 @@
 #include <cstdint>
-#include <fstream>
+#include <memory>
 #include <string>
 #include <Memory.hpp>
 #include <Z80.hpp>
+#include <Bus.hpp>
+#include <IOPorts.hpp>
+#include <Scheduler.hpp>
+#include <SaveState.hpp>
+#include <Loader.hpp>
+#include <BlockCache.hpp>
+#include <BusTrace.hpp>
+#include <TraceDiff.hpp>
 #include <Timer.hpp>
 #include <Printer.hpp>
 
 class Computer {
-   static const uint16_t MS_MAXMEM = 4096;
    Z80CPP::Z80      m_cpu;
-   Z80CPP::Memory   m_mem = Z80CPP::Memory(MS_MAXMEM);
+   Z80CPP::Memory   m_mem;
    Z80CPP::Printer  m_print = Z80CPP::Printer(std::cout);
+   Z80CPP::IOPorts  m_ports;     // IO devices (none attached: ports read FFh)
+   // Memory bus with Amstrad CPC's Gate-Array contention (WAIT Cycle 3-1)
+   Z80CPP::MemoryBus<Z80CPP::CPCContention> m_bus = Z80CPP::MemoryBus<Z80CPP::CPCContention>(m_mem, &m_ports);
+   Z80CPP::Scheduler m_sched;    // Timed events of devices
+   std::unique_ptr<Z80CPP::BlockCache> m_blocks;  // Translation cache (Instruction engine)
 
 public:
-   Computer() = default;
-
-   void step() {
-      {
-         // Simulate Amstrad CPC's Gate-Array WAIT Cycle (3-1)
-         static uint8_t wait = 2;
-
-         // Activate WAIT signal
-         wait = (wait+1) & 0x3;
-         if (wait) m_cpu.setSignal(Z80CPP::Signal::WAIT);
-         else      m_cpu.rstSignal(Z80CPP::Signal::WAIT);
-      }
-
-      // Tick the CPU
-      m_cpu.tick();
-
-      // Simulate a simple bus that connects to Memory through
-      // RD and WR signals
-      if ( m_cpu.signal(Z80CPP::Signal::MREQ)) {
-         uint16_t addr = m_cpu.address();
-         if        ( m_cpu.signal(Z80CPP::Signal::RD) ) {
-            m_cpu.setData( m_mem[ addr ] );
-         } else if ( m_cpu.signal(Z80CPP::Signal::WR) ) {
-            m_mem[ addr ] = m_cpu.data();
-         }
-      }
+   Computer() { m_cpu.setPorts(&m_ports); }
+   explicit Computer(Z80CPP::Engine e, bool blocks = false, bool jit = false) : m_cpu(e) {
+      m_cpu.setPorts(&m_ports);
+      if ( blocks ) m_blocks = std::make_unique<Z80CPP::BlockCache>();
+      if ( jit && !m_blocks->setJit(true) )
+         std::cerr << "JIT not available: running translated blocks only\n";
    }
 
    void printStatus() {
@@ -55,18 +47,48 @@ public:
    }
 
    void doNsteps(uint32_t steps) {
+      // Steps are measured in ticks. The instruction engine 
+      // may surpass them by up to one instruction
       uint64_t ticks = m_cpu.ticks();
       Z80CPP::Timer<uint64_t> t;
 
-      do { 
-         step(); 
-      } while(--steps);
+      if ( m_blocks ) {
+         // Instruction engine running translated basic blocks
+         m_blocks->run(m_cpu, m_mem, steps);
+      } else if ( m_cpu.engine() == Z80CPP::Engine::Instruction ) {
+         // Instruction engine accesses memory on its own
+         m_cpu.execute(m_mem, steps);
+      } else {
+         // T-state engine accesses memory through the bus,
+         // running uninterrupted between scheduled events
+         m_sched.run(m_cpu, m_bus, steps);
+      }
 
       uint64_t ns = t.ns();
       std::cout << std::dec << "Passed: " << ns << " ns\n";
       ticks = m_cpu.ticks() - ticks;
       std::cout << "Ticks:  " << ticks << ". TPS: ";
       std::cout << ticks*1000000000/ns << " MHZ: " << (float)ticks*1000/ns << "\n";
+      if ( m_blocks ) {
+         const auto& s = m_blocks->stats();
+         std::cout << "Blocks: " << m_blocks->blocks() << " Lookups: " << s.lookups
+                   << " Hit rate: " << s.hitRate() * 100 << "% Invalidated: " << s.invalidated
+                   << " Aborted: " << s.aborted << " Compiled: " << s.compiled
+                   << " JIT runs: " << s.jitRuns << "\n";
+      }
+   }
+
+   // Pins of every T-state (T-state engine only) into a trace file
+   void trace(const std::string& filename, uint32_t ticks) {
+      if ( m_cpu.engine() != Z80CPP::Engine::TState ) { std::cerr << "Tracing needs the T-state engine\n"; return; }
+      try {
+         Z80CPP::Timer<uint64_t> t;
+         Z80CPP::BusTrace trace(filename);
+         trace.run(m_cpu, m_bus, ticks);
+         trace.close();
+         std::cout << std::dec << "Traced: " << trace.records() << " T-states, " << trace.bytes()
+                   << " bytes in " << t.ns() << " ns\n";
+      } catch (const std::exception& e) { std::cerr << e.what() << "\n"; }
    }
 
    void autorun(uint32_t ticks) {
@@ -92,50 +114,102 @@ public:
             if ( !command.empty() ) 
                addr = std::stoul(command, nullptr, 0);
             m_print.printMemoryContents(m_mem, addr, 3);
+         } else if (token == "w" && !command.empty()) {
+            save(command);
+         } else if (token == "t" && !command.empty()) {
+            std::string file;
+            gettoken(file, command, ' ');
+            trace(file, command.empty() ? 1 : std::stoul(command));
+            printStatus();
+         } else if (token == "l" && !command.empty()) {
+            load(command);
+            printStatus();
          }
       } while (token != "q");
    }
 
-   void loadbin(const char *filename, uint16_t load, uint16_t run) {
-      std::ifstream f(filename, std::ifstream::binary);
-
-      if (!f.is_open()) { std::cerr << "Could not open " << filename << "\n"; return; }
-      if (load >= MS_MAXMEM || run >= MS_MAXMEM) {
-         std::cerr << "Load or run address too high\n";
-         std::cerr << "MAXMEM: " << MS_MAXMEM << " LOAD: " << load << "RUN: " << run << "\n";
-         return;
-      }
-
-      // get file size using buffer's members
-      std::filebuf* pbuf = f.rdbuf();
-      uint16_t size = pbuf->pubseekoff (0,f.end,f.in);
-      pbuf->pubseekpos (0,f.in);
+   // Save states are restored, programs and images loaded by their format
+   // (raw binaries at 0)
+   void load(const std::string& filename) {
+      using Z80CPP::Loader;
+      try {
+         Z80CPP::Timer<uint64_t> t;
+         const Loader::Format    format = Loader::format(filename);
+         switch ( format ) {
+            case Loader::Format::SaveState: Z80CPP::SaveState::restore(filename, m_cpu, m_mem); break;
+            case Loader::Format::IntelHex:  Loader::ihx(filename, m_mem); m_cpu.setPC(0); break;
+            case Loader::Format::Snapshot:  Loader::sna(filename, m_cpu, m_mem); break;
+            case Loader::Format::Disk:      Loader::dsk(filename, m_cpu, m_mem); break;
+            case Loader::Format::Binary:    Loader::bin(filename, m_mem); m_cpu.setPC(0); break;
+         }
+         if ( format != Loader::Format::Binary )
+            std::cout << std::dec << "Loaded " << filename << " in " << t.ns() << " ns\n";
+      } catch (const std::exception& e) { std::cerr << e.what() << "\n"; }
+   }
 
-      if (load >= MS_MAXMEM || load+size >= MS_MAXMEM) {
-         std::cerr << "Load address too high or program too big to fit into memory.\n";
-         std::cerr << "MAXMEM: " << MS_MAXMEM << " LOAD: " << load;
-         std::cerr << "SIZE: " << size << " LOAD+SIZE: " << load+size << "\n";
-      } else {
-         // Load program into memory
-         pbuf->sgetn ((char*)(&m_mem[load]), size);
-         m_cpu.setPC(run);
-      }
+   void save(const std::string& filename) {
+      try {
+         Z80CPP::SaveState::save(filename, m_cpu, m_mem);
+      } catch (const std::exception& e) { std::cerr << e.what() << "\n"; }
    }
 };
 
 
+// Compare two bus traces. Exits with 0 when they are equal
+int diffTraces(const std::string& a, const std::string& b, unsigned context) {
+   try {
+      Z80CPP::Timer<uint64_t> t;
+      const auto r = Z80CPP::TraceDiff::diff(a, b, context);
+      std::cout << "Compared in " << t.ns() << " ns\n";
+      if ( r.equal ) { std::cout << "Traces are equal\n"; return 0; }
+
+      Z80CPP::Printer print(std::cout);
+      std::cout << "First difference at T-state " << r.tick << " (byte " << r.offset << ")\n";
+      for (const auto* side : { &r.a, &r.b }) {
+         std::cout << (side == &r.a ? a : b) << ":\n";
+         for (const auto& rec : *side) {
+            std::cout << (rec.tick == r.tick ? ">" : " ");
+            print.printPins(rec.tick, rec.signals, rec.address, rec.data);
+         }
+      }
+   } catch (const std::exception& e) { std::cerr << e.what() << "\n"; }
+   return 1;
+}
+
 void usage() {
    std::cerr << "USAGE:\n";
-   std::cerr << "   z80emu <binfile> [ticks]\n\n";
+   std::cerr << "   z80emu [-i|-b|-j] <binfile|ihx|sna|dsk|savestate> [ticks]\n";
+   std::cerr << "   z80emu -d <trace> <trace> [context]\n\n";
+   std::cerr << "   -i   Use instruction-granular engine instead of T-state engine\n";
+   std::cerr << "   -b   Use instruction-granular engine with a basic-block translation cache\n";
+   std::cerr << "   -j   Like -b, also compiling hot blocks to host code (x86-64)\n";
+   std::cerr << "   -d   Find the first T-state where two bus traces differ\n\n";
+
+   std::cerr << "   Commands: s [ticks] (step), m [addr] (memory), w <file> (save state),\n";
+   std::cerr << "             t <file> [ticks] (trace pins), l <file> (load state, program\n";
+   std::cerr << "             or image), q (quit)\n\n";
    exit(1);
 }
 
 int main(int argc, char*argv[]) {
+   if (argc > 1 && std::string(argv[1]) == "-d") {
+      if (argc < 4 || argc > 5)
+         usage();
+      return diffTraces(argv[2], argv[3], argc == 5 ? std::atoi(argv[4]) : 8);
+   }
+   Z80CPP::Engine engine = Z80CPP::Engine::TState;
+   bool           blocks = false, jit = false;
+   if (argc > 1 && (std::string(argv[1]) == "-i" || std::string(argv[1]) == "-b" || std::string(argv[1]) == "-j")) {
+      engine = Z80CPP::Engine::Instruction;
+      jit    = std::string(argv[1]) == "-j";
+      blocks = std::string(argv[1]) == "-b" || jit;
+      --argc; ++argv;
+   }
    if (argc < 2 || argc > 3)
       usage();
 
-   Computer K;
-   K.loadbin(argv[1], 0, 0);
+   Computer K(engine, blocks, jit);
+   K.load(argv[1]);
    if (argc == 3)
       K.autorun(std::atoi(argv[2]));
    else
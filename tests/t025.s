@@ -0,0 +1,25 @@
+;;
+;; TEST: 8-bit ADD, ADC, SUB, SBC
+;;    Arithmetic on A with registers, (HL) and immediates. Flags
+;;    are read back with PUSH AF / POP rp
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0040    ;; 0000 31 40 00
+LD   A, #0x7F       ;; 0003 3E 7F
+LD   B, #0x01       ;; 0005 06 01
+ADD  A, B           ;; 0007 80        A=0x80 S H V
+ADC  A, #0x80       ;; 0008 CE 80     A=0x00 Z V C
+PUSH AF             ;; 000A F5
+POP  BC             ;; 000B C1        BC=0x0045
+SBC  A, #0x01       ;; 000C DE 01     A=0xFE S 5 H 3 N C
+PUSH AF             ;; 000E F5
+POP  DE             ;; 000F D1        DE=0xFEBB
+LD   HL, #0x0020    ;; 0010 21 20 00
+SUB  (HL)           ;; 0013 96        A=0xFE-0x7E=0x80 S N
+HALT                ;; 0014 76
+.ds 11
+.db #0x7E           ;; 0020
+
+;; OUTPUT
+;; AF=0x8082, BC=0x0045, DE=0xFEBB, HL=0x0020, SP=0x0040
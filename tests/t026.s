@@ -0,0 +1,22 @@
+;;
+;; TEST: 8-bit AND, XOR, OR, CP
+;;    Logic operations set parity and clear carry. CP leaves A
+;;    unchanged, taking flags 5 and 3 from the operand
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0040    ;; 0000 31 40 00
+LD   A, #0xF0       ;; 0003 3E F0
+AND  #0x3C          ;; 0005 E6 3C     A=0x30 5 H P
+PUSH AF             ;; 0007 F5
+POP  BC             ;; 0008 C1        BC=0x3034
+LD   D, #0x0F       ;; 0009 16 0F
+XOR  D              ;; 000B AA        A=0x3F 5 3 P
+OR   A              ;; 000C B7        A=0x3F 5 3 P
+PUSH AF             ;; 000D F5
+POP  DE             ;; 000E D1        DE=0x3F2C
+CP   #0x48          ;; 000F FE 48     0x3F-0x48: S N C, 3 from 0x48
+HALT                ;; 0011 76
+
+;; OUTPUT
+;; AF=0x3F8B, BC=0x3034, DE=0x3F2C, SP=0x0040
@@ -0,0 +1,23 @@
+;;
+;; TEST: INC r, DEC r, INC (HL), DEC (HL)
+;;    8-bit increments and decrements keep the carry flag
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0040    ;; 0000 31 40 00
+SCF                 ;; 0003 37        C
+LD   B, #0x7F       ;; 0004 06 7F
+INC  B              ;; 0006 04        B=0x80 S H V C
+LD   C, #0x01       ;; 0007 0E 01
+DEC  C              ;; 0009 0D        C=0x00 Z N C
+LD   HL, #0x0020    ;; 000A 21 20 00
+INC  (HL)           ;; 000D 34        (0x0020)=0x00 Z H C
+DEC  (HL)           ;; 000E 35        (0x0020)=0xFF S 5 H 3 N C
+LD   A, (HL)        ;; 000F 7E
+INC  A              ;; 0010 3C        A=0x00 Z H C
+HALT                ;; 0011 76
+.ds 14
+.db #0xFF           ;; 0020
+
+;; OUTPUT
+;; AF=0x0051, BC=0x8000, HL=0x0020, (0x0020)=0xFF
@@ -0,0 +1,28 @@
+;;
+;; TEST: RLCA, RRCA, RLA, RRA, DAA, CPL, SCF, CCF
+;;    Accumulator rotates and flag operations, reading the flags
+;;    left by previous ALU operations
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0040    ;; 0000 31 40 00
+LD   A, #0x81       ;; 0003 3E 81
+RLCA                ;; 0005 07        A=0x03 C
+RRA                 ;; 0006 1F        A=0x81 C
+RLA                 ;; 0007 17        A=0x03 C
+RRCA                ;; 0008 0F        A=0x81 C
+LD   B, A           ;; 0009 47        B=0x81
+LD   A, #0x19       ;; 000A 3E 19
+ADD  A, #0x28       ;; 000C C6 28     A=0x41 H
+DAA                 ;; 000E 27        A=0x47
+SUB  #0x09          ;; 000F D6 09     A=0x3E H N
+DAA                 ;; 0011 27        A=0x38 N
+PUSH AF             ;; 0012 F5
+POP  DE             ;; 0013 D1        DE=0x382A
+CPL                 ;; 0014 2F        A=0xC7 H N
+SCF                 ;; 0015 37        C
+CCF                 ;; 0016 3F        H
+HALT                ;; 0017 76
+
+;; OUTPUT
+;; AF=0xC710, BC=0x8100, DE=0x382A, SP=0x0040
@@ -0,0 +1,39 @@
+;;
+;; TEST: RLC, RRC, RL, RR, SLA, SRA, SLL, SRL, BIT, RES, SET
+;;    CB-prefixed rotations, shifts and bit operations on registers
+;;    and (HL)
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0060    ;; 0000 31 60 00
+LD   B, #0x81       ;; 0003 06 81
+RLC  B              ;; 0005 CB 00             B=0x03 PV C
+LD   C, #0x01       ;; 0007 0E 01
+RRC  C              ;; 0009 CB 09             C=0x80 S C
+RL   C              ;; 000B CB 11             C=0x01 C
+LD   D, #0x80       ;; 000D 16 80
+RR   D              ;; 000F CB 1A             D=0xC0 S PV
+LD   E, #0xC1       ;; 0011 1E C1
+SLA  E              ;; 0013 CB 23             E=0x82 S PV C
+SRA  E              ;; 0015 CB 2B             E=0xC1 S
+SLL  E              ;; 0017 CB 33             E=0x83 S C
+SRL  E              ;; 0019 CB 3B             E=0x41 PV C
+LD   HL, #0x0050    ;; 001B 21 50 00
+RLC  (HL)           ;; 001E CB 06             (0x0050)=0x0B 3 C
+SET  7, (HL)        ;; 0020 CB FE             (0x0050)=0x8B
+RES  0, (HL)        ;; 0022 CB 86             (0x0050)=0x8A
+LD   A, #0x10       ;; 0024 3E 10
+BIT  4, A           ;; 0026 CB 67             H C
+BIT  3, (HL)        ;; 0028 CB 5E             H C
+BIT  0, (HL)        ;; 002A CB 46             Z H PV C
+SET  0, H           ;; 002C CB C4             H=0x01
+RES  4, A           ;; 002E CB A7             A=0x00
+PUSH AF             ;; 0030 F5
+POP  DE             ;; 0031 D1                DE=0x0055
+HALT                ;; 0032 76
+.ds 29
+.db #0x85           ;; 0050
+
+;; OUTPUT
+;; AF=0x0055, BC=0x0301, DE=0x0055, HL=0x0150, SP=0x0060, (0x0050)=0x8A
+
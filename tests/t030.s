@@ -0,0 +1,39 @@
+;;
+;; TEST: LD IX/IY, LD r,(IX+d), LD (IY+d),n, ALU (IX+d), INC (IY+d),
+;;       IXH/IXL/IYH/IYL, PUSH/POP/EX (SP) with IX and IY
+;;    DD/FD prefixes turn HL into IX/IY and (HL) into (IX+d)/(IY+d),
+;;    while H and L stay themselves when (IX+d) is used
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0070    ;; 0000 31 70 00
+LD   IX, #0x0058    ;; 0003 DD 21 58 00       IX=0x0058
+LD   IY, #0x0068    ;; 0007 FD 21 68 00       IY=0x0068
+LD   A, (IX-8)      ;; 000B DD 7E F8          A=0x12
+LD   H, (IX+1)      ;; 000E DD 66 01          H=0x34
+LD   (IY-2), #0x56  ;; 0011 FD 36 FE 56       (0x0066)=0x56
+ADD  A, (IY-2)      ;; 0015 FD 86 FE          A=0x68 5 3
+LD   L, A           ;; 0018 6F                L=0x68
+LD   (IX+2), L      ;; 0019 DD 75 02          (0x005A)=0x68
+INC  (IY-2)         ;; 001C FD 34 FE          (0x0066)=0x57
+XOR  (IX+2)         ;; 001F DD AE 02          A=0x00 Z PV
+LD   B, IXH         ;; 0022 DD 44             B=0x00
+LD   IXL, #0x40     ;; 0024 DD 2E 40          IX=0x0040
+LD   IYH, L         ;; 0027 FD 65             IY=0x6868
+INC  IYL            ;; 0029 FD 2C             IY=0x6869 5 3
+LD   C, IYL         ;; 002B FD 4D             C=0x69
+PUSH IX             ;; 002D DD E5
+EX   (SP), IY       ;; 002F FD E3             IY=0x0040 (0x006E)=0x6869
+POP  DE             ;; 0031 D1                DE=0x6869
+LD   (#0x0060), IY  ;; 0032 FD 22 60 00
+LD   IX, (#0x0060)  ;; 0036 DD 2A 60 00       IX=0x0040
+HALT                ;; 003A 76
+.ds 21
+.db #0x12           ;; 0050
+.ds 8
+.db #0x34           ;; 0059
+
+;; OUTPUT
+;; AF=0x0028, BC=0x0069, DE=0x6869, HL=0x3468, IX=0x0040, IY=0x0040, SP=0x0070
+;; (0x005A)=0x68, (0x0066)=0x57
+
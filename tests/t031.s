@@ -0,0 +1,29 @@
+;;
+;; TEST: Rotations, shifts, BIT, RES and SET on (IX+d) and (IY+d)
+;;    DD CB d op / FD CB d op read d before op. Undocumented forms
+;;    with a register besides (IX+d) also copy the result into it
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0060    ;; 0000 31 60 00
+LD   IX, #0x0048    ;; 0003 DD 21 48 00
+LD   IY, #0x0050    ;; 0007 FD 21 50 00
+SCF                 ;; 000B 37
+RL   (IX+0)         ;; 000C DD CB 00 16       (0x0048)=0x03 PV C
+RR   (IY-7)         ;; 0010 FD CB F9 1E       (0x0049)=0xC0 S PV
+SRL  (IX+1)         ;; 0014 DD CB 01 3E       (0x0049)=0x60 5 PV
+SET  3, (IY-8)      ;; 0018 FD CB F8 DE       (0x0048)=0x0B
+RES  1, (IY-8)      ;; 001C FD CB F8 8E       (0x0048)=0x09
+BIT  7, (IX+1)      ;; 0020 DD CB 01 7E       Z H PV
+BIT  3, (IX+0)      ;; 0024 DD CB 00 5E       H
+.db #0xDD, #0xCB, #0x01, #0x20   ;; 0028 SLA (IX+1), B     B=0xC0 (0x0049)=0xC0 S PV
+.db #0xFD, #0xCB, #0xF9, #0xFF   ;; 002C SET 7, (IY-7), A  A=0xC0
+PUSH AF             ;; 0030 F5
+POP  DE             ;; 0031 D1                DE=0xC084
+HALT                ;; 0032 76
+.ds 21
+.db #0x81, #0x80    ;; 0048
+
+;; OUTPUT
+;; AF=0xC084, BC=0xC000, DE=0xC084, IX=0x0048, IY=0x0050, (0x0048)=09 C0
+
@@ -0,0 +1,33 @@
+;;
+;; TEST: ADC HL,rr, SBC HL,rr, NEG, LD (nn),rr, LD rr,(nn), LD I,A,
+;;       LD A,I, RLD, RRD
+;;    ED-prefixed arithmetic and loads. 16-bit ADC/SBC set flags from
+;;    the high byte of the result, and Z from all of it
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0060    ;; 0000 31 60 00
+LD   HL, #0x7FFF    ;; 0003 21 FF 7F
+LD   BC, #0x0000    ;; 0006 01 00 00
+SCF                 ;; 0009 37
+ADC  HL, BC         ;; 000A ED 4A             HL=0x8000 S H PV
+LD   DE, #0x8000    ;; 000C 11 00 80
+SBC  HL, DE         ;; 000F ED 52             HL=0x0000 Z N
+LD   A, #0x01       ;; 0011 3E 01
+NEG                 ;; 0013 ED 44             A=0xFF S 5 H 3 N C
+LD   I, A           ;; 0015 ED 47
+XOR  A              ;; 0017 AF
+LD   A, I           ;; 0018 ED 57             A=0xFF S 5 3
+LD   (#0x0050), DE  ;; 001A ED 53 50 00
+LD   BC, (#0x0050)  ;; 001E ED 4B 50 00       BC=0x8000
+LD   HL, #0x0052    ;; 0022 21 52 00
+LD   A, #0x12       ;; 0025 3E 12
+RLD                 ;; 0027 ED 6F             A=0x13 (0x0052)=0x42
+RRD                 ;; 0029 ED 67             A=0x12 (0x0052)=0x34 PV
+HALT                ;; 002B 76
+.ds 36
+.db #0x00, #0x00, #0x34 ;; 0050
+
+;; OUTPUT
+;; AF=0x1204, BC=0x8000, DE=0x8000, HL=0x0052, SP=0x0060, (0x0050)=00 80 34
+
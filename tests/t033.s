@@ -0,0 +1,30 @@
+;;
+;; TEST: LDI, LDIR, LDDR, CPI, CPIR
+;;    Block transfers and searches. Repeating forms run again from
+;;    their own address until BC becomes 0 (or CPIR finds A)
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0070    ;; 0000 31 70 00
+LD   HL, #0x0050    ;; 0003 21 50 00
+LD   DE, #0x0058    ;; 0006 11 58 00
+LD   BC, #0x0004    ;; 0009 01 04 00
+LDIR                ;; 000C ED B0             (0x0058)=11 22 33 44
+LD   HL, #0x0053    ;; 000E 21 53 00
+LD   DE, #0x0063    ;; 0011 11 63 00
+LD   BC, #0x0002    ;; 0014 01 02 00
+LDDR                ;; 0017 ED B8             (0x0062)=33 44 5
+LDI                 ;; 0019 ED A0             (0x0061)=0x22 5 PV
+LD   HL, #0x0050    ;; 001B 21 50 00
+LD   BC, #0x0008    ;; 001E 01 08 00
+LD   A, #0x33       ;; 0021 3E 33
+CPIR                ;; 0023 ED B1             HL=0x0053 BC=0x0005 Z N PV
+CPI                 ;; 0025 ED A1             HL=0x0054 BC=0x0004 S 5 H 3 N PV
+HALT                ;; 0027 76
+.ds 40
+.db #0x11, #0x22, #0x33, #0x44 ;; 0050
+
+;; OUTPUT
+;; AF=0x33BE, BC=0x0004, DE=0x0062, HL=0x0054, SP=0x0070
+;; (0x0058)=11 22 33 44, (0x0061)=22 33 44
+
@@ -0,0 +1,37 @@
+;;
+;; TEST: DI, EI, IM, RST, RET, RETN
+;;    Interrupt state, with no interrupt requests: EI and DI set and
+;;    reset IFF1 and IFF2, which LD A,I copies into PV. RST calls its
+;;    page 0 address and RET returns. RETN returns as RET does
+;;
+.area _DATA
+.area _CODE
+JP   start          ;; 0000 C3 10 00
+.ds 5
+INC  B              ;; 0008 04                RST 08h: B=B+1
+RET                 ;; 0009 C9
+.ds 6
+start:
+LD   SP, #0x0080    ;; 0010 31 80 00
+IM   2              ;; 0013 ED 5E
+LD   A, #0x12       ;; 0015 3E 12
+LD   I, A           ;; 0017 ED 47
+EI                  ;; 0019 FB                IFF1=IFF2=1
+LD   A, I           ;; 001A ED 57             A=0x12 PV
+PUSH AF             ;; 001C F5                (0x007E)=04 12
+DI                  ;; 001D F3                IFF1=IFF2=0
+LD   A, I           ;; 001E ED 57             A=0x12
+PUSH AF             ;; 0020 F5                (0x007C)=00 12
+RST  0x08           ;; 0021 CF                B=0x01
+RST  0x08           ;; 0022 CF                B=0x02
+LD   HL, #retn      ;; 0023 21 2A 00
+PUSH HL             ;; 0026 E5
+RETN                ;; 0027 ED 45             PC=0x002A
+HALT                ;; 0029 76
+retn:
+LD   C, B           ;; 002A 48                C=0x02
+HALT                ;; 002B 76
+
+;; OUTPUT
+;; AF=0x1200, BC=0x0202, HL=0x002A, SP=0x007C
+;; (0x007C)=00 12 04 12
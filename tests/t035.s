@@ -0,0 +1,34 @@
+;;
+;; TEST: IN, OUT and block IO
+;;    Nothing is connected to IO ports: INs read FFh and OUTs go 
+;;    nowhere. IN r,(C) takes flags from the value read (but carry).
+;;    INIR copies FFh from port C to (HL) B times, and OTIR and OUTI 
+;;    send bytes from (HL): flags come from B and the byte plus C+1 
+;;    (INs) or L (OUTs)
+;;
+.area _DATA
+.area _CODE
+LD   SP, #0x0080    ;; 0000 31 80 00
+LD   A, #0x12       ;; 0003 3E 12
+OUT  (#0x34), A     ;; 0005 D3 34             Port 0x1234
+IN   A, (#0x56)     ;; 0007 DB 56             A=0xFF
+LD   BC, #0x7F10    ;; 0009 01 10 7F
+IN   D, (C)         ;; 000C ED 50             D=0xFF F=0xAC
+PUSH AF             ;; 000E F5                (0x007E)=AC FF
+OUT  (C), D         ;; 000F ED 51
+LD   HL, #0x0070    ;; 0011 21 70 00
+LD   B, #0x03       ;; 0014 06 03
+INIR                ;; 0016 ED B2             (0x0070)=FF FF FF B=0 F=0x57
+PUSH AF             ;; 0018 F5                (0x007C)=57 FF
+LD   HL, #0x007C    ;; 0019 21 7C 00
+LD   B, #0x02       ;; 001C 06 02
+OTIR                ;; 001E ED B3             B=0 HL=0x007E F=0x57
+LD   HL, #0x0070    ;; 0020 21 70 00
+LD   B, #0x05       ;; 0023 06 05
+OUTI                ;; 0025 ED A3             B=4 HL=0x0071 F=0x13
+HALT                ;; 0027 76
+
+;; OUTPUT
+;; AF=0xFF13, BC=0x0410, DE=0xFF00, HL=0x0071, SP=0x007C
+;; (0x0070)=FF FF FF
+;; (0x007C)=57 FF AC FF